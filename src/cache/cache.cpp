@@ -84,6 +84,7 @@ bool Cache::generateCacheFile()
         type_array.append(static_cast<int32_t>(std::get<1>(item.second)));
         thumbnail_array.append(std::get<2>(item.second));
     }
+    cache.put("version", version_);
     cache.put("uri", uri_array);
     cache.put("hash", hash_array);
     cache.put("type", type_array);
@@ -96,7 +97,7 @@ bool Cache::generateCacheFile()
     return true;
 }
 
-bool Cache::readCache()
+bool Cache::readCache(bool consume)
 {
     std::string path = getPath();
     // get the JDOM tree from given path
@@ -126,6 +127,16 @@ bool Cache::readCache()
         return false;
     }
 
+    // the items of an outdated cache lack db fields added since then,
+    // a scan extracts them again and writes a current cache file while
+    // other writers keep the old version
+    int version = root.hasKey("version") ? root["version"].asNumber<int32_t>() : 1;
+    outdated_ = version < CACHE_VERSION;
+    version_ = consume ? CACHE_VERSION : version;
+    if (outdated_)
+        LOG_INFO(0, "Cache file '%s' has version %d, extract all items again",
+            path.c_str(), version);
+
     for (int idx = 0; idx < uri_count; idx++) {
         auto uri = uriList[idx].asString();
         auto hash = std::stoul(hashList[idx].asString());
@@ -134,6 +145,9 @@ bool Cache::readCache()
         cacheMap_.emplace(uri, std::make_tuple(hash, type, thumb));
     }
 
+    if (!consume)
+        return true;
+
     // remove cache file
     std::filesystem::remove(getPath());
     sync();
@@ -144,7 +158,7 @@ bool Cache::isExist(const std::string& uri, const unsigned long& hash)
 {
     bool ret = false;
     auto iter = cacheMap_.find(uri);
-    if (iter != cacheMap_.end() && std::get<0>(iter->second) == hash) {
+    if (!outdated_ && iter != cacheMap_.end() && std::get<0>(iter->second) == hash) {
         cacheItems_.emplace(uri, std::make_tuple(std::get<0>(iter->second), 
                     std::get<1>(iter->second), std::get<2>(iter->second)));
         ret = true;
@@ -172,6 +186,31 @@ const CacheMap& Cache::getRemainingCache() const
     return cacheMap_;
 }
 
+int Cache::removeItems(const std::unordered_set<std::string>& uris)
+{
+    int removed = 0;
+    for (const auto &uri : uris)
+        removed += cacheMap_.erase(uri);
+
+    // keep everything else for the cache file
+    for (const auto &item : cacheMap_)
+        cacheItems_.emplace(item.first, item.second);
+    return removed;
+}
+
+std::unordered_set<std::string> Cache::thumbnailIds() const
+{
+    // the thumbnail id is the file name without extension, attached
+    // images might be stored with a different extension
+    std::unordered_set<std::string> ids;
+    ids.reserve(cacheItems_.size());
+    for (const auto &item : cacheItems_) {
+        const auto &thumb = std::get<2>(item.second);
+        ids.insert(thumb.substr(0, thumb.find_last_of('.')));
+    }
+    return ids;
+}
+
 void Cache::printCache() const
 {
     LOG_DEBUG("--------------Cached Items--------------");
@@ -19,9 +19,14 @@
 #include "mediaitem.h"
 #include <pbnjson.hpp>
 #include <unordered_map>
+#include <unordered_set>
 #include <tuple>
 #include <utility>
 
+/// Version of the cache file format, older cache files are extracted
+/// again once. Version 2 added last_modified_date_raw to the db rows.
+#define CACHE_VERSION 2
+
 /// alias
 using CacheMap = std::unordered_map<std::string, 
                                     std::tuple<unsigned long, MediaItem::Type, std::string>>;
@@ -40,12 +45,14 @@ public:
     const std::string& getPath() const;
     bool setPath(const std::string& path);
     bool generateCacheFile();
-    bool readCache();
+    bool readCache(bool consume = true);
     bool isExist(const std::string& uri, const unsigned long& hash);
     void resetCache();
     void clear();
     void printCache() const;
     const CacheMap& getRemainingCache() const;
+    int removeItems(const std::unordered_set<std::string>& uris);
+    std::unordered_set<std::string> thumbnailIds() const;
 
  private:
     /// Get message id.
@@ -59,4 +66,10 @@ public:
 
     /// media item cache path
     std::string cachePath_;
+
+    /// Version of the cache file to write.
+    int version_ = CACHE_VERSION;
+
+    /// Set if the cache file predates CACHE_VERSION.
+    bool outdated_ = false;
 };
@@ -15,6 +15,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "cachemanager.h"
+#include <filesystem>
 
 std::unique_ptr<CacheManager> CacheManager::instance_;
 
@@ -90,6 +91,35 @@ std::shared_ptr<Cache> CacheManager::readCache(const std::string& devUri, const
     return cache;
 }
 
+std::shared_ptr<Cache> CacheManager::peekCache(const std::string& uuid)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string cachePath = CACHE_DIRECTORY + uuid + std::string("/") + std::string(CACHE_JSONFILE);
+    // a missing cache file means the device is being scanned
+    if (!std::filesystem::exists(cachePath))
+        return nullptr;
+    auto cache = std::make_shared<Cache>(cachePath);
+    if (!cache->readCache(false))
+        return nullptr;
+    return cache;
+}
+
+int CacheManager::pruneCache(const std::string& uuid,
+                             const std::unordered_set<std::string>& uris)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string cachePath = CACHE_DIRECTORY + uuid + std::string("/") + std::string(CACHE_JSONFILE);
+    if (!std::filesystem::exists(cachePath))
+        return 0;
+    auto cache = std::make_shared<Cache>(cachePath);
+    if (!cache->readCache(false))
+        return 0;
+    int removed = cache->removeItems(uris);
+    if (removed > 0 && !cache->generateCacheFile())
+        return 0;
+    return removed;
+}
+
 void CacheManager::resetCache(const std::string& path)
 {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -34,6 +34,8 @@ public:
     int totalSize();
     bool generateCacheFile(const std::string& devUri, const std::shared_ptr<Cache>& cache);
     std::shared_ptr<Cache> readCache(const std::string& devUri, const std::string& uuid);
+    std::shared_ptr<Cache> peekCache(const std::string& uuid);
+    int pruneCache(const std::string& uuid, const std::unordered_set<std::string>& uris);
     void resetCache(const std::string& path);
     void resetAllCache();
     void createCacheDirectory(const std::string& uuid);
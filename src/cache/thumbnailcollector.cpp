@@ -0,0 +1,132 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "thumbnailcollector.h"
+#include "thumbnailquota.h"
+#include <chrono>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+std::unique_ptr<ThumbnailCollector> ThumbnailCollector::instance_;
+
+ThumbnailCollector *ThumbnailCollector::instance()
+{
+    static std::once_flag once;
+    std::call_once(once, [] { instance_.reset(new ThumbnailCollector()); });
+    return instance_.get();
+}
+
+ThumbnailCollector::ThumbnailCollector()
+{
+    LOG_DEBUG("ThumbnailCollector ctor!");
+    task_ = std::thread(&ThumbnailCollector::loop, this);
+}
+
+ThumbnailCollector::~ThumbnailCollector()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exit_ = true;
+    }
+    cv_.notify_one();
+    if (task_.joinable())
+        task_.join();
+    LOG_DEBUG("ThumbnailCollector dtor!");
+}
+
+void ThumbnailCollector::collect(const std::string &uuid,
+                                 std::unordered_set<std::string> liveIds)
+{
+    if (uuid.empty()) {
+        LOG_WARNING(0, "Invalid device uuid for thumbnail collection");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = std::find_if(jobs_.begin(), jobs_.end(),
+            [&uuid] (const Job &job) { return job.uuid == uuid; });
+        if (iter != jobs_.end())
+            jobs_.erase(iter);
+        jobs_.push_back({uuid, std::move(liveIds), fs::file_time_type::clock::now()});
+    }
+    cv_.notify_one();
+}
+
+void ThumbnailCollector::loop()
+{
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return exit_ || !jobs_.empty(); });
+            if (exit_)
+                break;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        reconcile(job);
+    }
+}
+
+void ThumbnailCollector::reconcile(const Job &job)
+{
+    std::string dir = THUMBNAIL_DIRECTORY + job.uuid;
+    std::error_code err;
+    fs::directory_iterator iter(dir, err);
+    if (err) {
+        LOG_DEBUG("No thumbnail directory '%s' to collect", dir.c_str());
+        return;
+    }
+
+    int checked = 0;
+    int removed = 0;
+    for (; iter != fs::directory_iterator(); iter.increment(err)) {
+        if (err) {
+            LOG_WARNING(0, "Thumbnail collection stopped in '%s', error : %s",
+                dir.c_str(), err.message().c_str());
+            break;
+        }
+
+        std::error_code ec;
+        const auto &path = iter->path();
+        // thumbnail variants are named <id>.<variant>.<format>
+        auto name = path.filename().string();
+        if (iter->is_regular_file(ec) &&
+            job.liveIds.find(name.substr(0, name.find('.'))) == job.liveIds.end()) {
+            // files written after the request belong to a newer scan
+            auto lastWrite = fs::last_write_time(path, ec);
+            if (!ec && lastWrite < job.queued && fs::remove(path, ec)) {
+                ThumbnailQuota::instance()->remove(path);
+                removed++;
+            }
+        }
+
+        if (++checked % THUMBNAIL_GC_BATCH_SIZE == 0) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (exit_)
+                    break;
+            }
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds(THUMBNAIL_GC_BATCH_INTERVAL));
+        }
+    }
+
+    LOG_INFO(0, "Thumbnail collection for '%s' done, %d checked, %d removed",
+        job.uuid.c_str(), checked, removed);
+}
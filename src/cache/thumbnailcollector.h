@@ -0,0 +1,95 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+#include <string>
+#include <unordered_set>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <filesystem>
+
+/// Number of thumbnail files checked before the collector yields.
+#define THUMBNAIL_GC_BATCH_SIZE 100
+/// Pause between two batches in milliseconds.
+#define THUMBNAIL_GC_BATCH_INTERVAL 50
+
+/**
+ * \brief Background garbage collector for thumbnail files.
+ *
+ * Thumbnail file names are derived from the media item revision, so
+ * after a device scan every thumbnail which is not referenced by one
+ * of the scanned media items is an orphan and can be removed.
+ */
+class ThumbnailCollector
+{
+public:
+    /**
+     * \brief Get singleton object of ThumbnailCollector.
+     *
+     * \return The singleton.
+     */
+    static ThumbnailCollector *instance();
+
+    virtual ~ThumbnailCollector();
+
+    /**
+     * \brief Queue reconciliation of a device thumbnail directory.
+     *
+     * A pending request for the same device is replaced.
+     *
+     * \param[in] uuid The device uuid.
+     * \param[in] liveIds Thumbnail ids of all media items on the device.
+     */
+    void collect(const std::string &uuid, std::unordered_set<std::string> liveIds);
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// Singleton.
+    ThumbnailCollector();
+
+    /// One reconciliation request.
+    struct Job {
+        std::string uuid;
+        std::unordered_set<std::string> liveIds;
+        std::filesystem::file_time_type queued;
+    };
+
+    /// Collector thread main loop.
+    void loop();
+
+    /// Remove the orphaned thumbnails of one device in batches.
+    void reconcile(const Job &job);
+
+    /// Singleton instance object.
+    static std::unique_ptr<ThumbnailCollector> instance_;
+
+    /// Collector thread.
+    std::thread task_;
+    /// Protects the job queue.
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    /// Pending jobs.
+    std::deque<Job> jobs_;
+    /// Set on destruction.
+    bool exit_ = false;
+};
@@ -0,0 +1,280 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "thumbnailquota.h"
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+
+namespace fs = std::filesystem;
+
+std::unique_ptr<ThumbnailQuota> ThumbnailQuota::instance_;
+
+ThumbnailQuota *ThumbnailQuota::instance()
+{
+    static std::once_flag once;
+    std::call_once(once, [] { instance_.reset(new ThumbnailQuota()); });
+    return instance_.get();
+}
+
+ThumbnailQuota::ThumbnailQuota()
+{
+    LOG_DEBUG("ThumbnailQuota ctor!");
+    task_ = std::thread(&ThumbnailQuota::loop, this);
+}
+
+ThumbnailQuota::~ThumbnailQuota()
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        exit_ = true;
+    }
+    cv_.notify_one();
+    if (task_.joinable())
+        task_.join();
+    LOG_DEBUG("ThumbnailQuota dtor!");
+}
+
+void ThumbnailQuota::add(const std::string &path)
+{
+    std::error_code err;
+    auto size = fs::file_size(path, err);
+    if (err) {
+        LOG_WARNING(0, "Thumbnail '%s' not accounted, error : %s", path.c_str(),
+            err.message().c_str());
+        return;
+    }
+
+    bool over = false;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = entries_.find(path);
+        if (iter != entries_.end())
+            erase(iter->second);
+
+        std::string uuid = fs::path(path).parent_path().filename();
+        auto &device = devices_[uuid];
+        device.lru.push_back({path, uuid, size, ++used_});
+        entries_[path] = std::prev(device.lru.end());
+        device.bytes += size;
+        totalBytes_ += size;
+        count_++;
+        forgetEvicted(path);
+        over = overQuota();
+    }
+    if (over)
+        cv_.notify_one();
+}
+
+bool ThumbnailQuota::access(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    auto iter = entries_.find(path);
+    if (iter != entries_.end()) {
+        auto dev = devices_.find(iter->second->uuid);
+        if (dev != devices_.end())
+            dev->second.lru.splice(dev->second.lru.end(), dev->second.lru, iter->second);
+        iter->second->used = ++used_;
+        return false;
+    }
+
+    // report an evicted thumbnail only once, the regeneration adds it
+    // again or it stays missing like before the eviction
+    return forgetEvicted(path);
+}
+
+bool ThumbnailQuota::evicted(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return evicted_.find(path) != evicted_.end();
+}
+
+void ThumbnailQuota::remove(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    auto iter = entries_.find(path);
+    if (iter != entries_.end())
+        erase(iter->second);
+    forgetEvicted(path);
+}
+
+void ThumbnailQuota::markEvicted(const std::string &path)
+{
+    if (evicted_.find(path) != evicted_.end())
+        return;
+    evictedOrder_.push_back(path);
+    evicted_[path] = std::prev(evictedOrder_.end());
+
+    // the oldest evictions are forgotten, such thumbnails stay missing
+    // until the media item is scanned again
+    while (evictedOrder_.size() > THUMBNAIL_EVICTED_MAX) {
+        evicted_.erase(evictedOrder_.front());
+        evictedOrder_.pop_front();
+    }
+}
+
+bool ThumbnailQuota::forgetEvicted(const std::string &path)
+{
+    auto iter = evicted_.find(path);
+    if (iter == evicted_.end())
+        return false;
+    evictedOrder_.erase(iter->second);
+    evicted_.erase(iter);
+    return true;
+}
+
+void ThumbnailQuota::erase(std::list<Entry>::iterator iter)
+{
+    totalBytes_ -= std::min(totalBytes_, iter->size);
+    count_--;
+    entries_.erase(iter->path);
+    auto dev = devices_.find(iter->uuid);
+    if (dev == devices_.end())
+        return;
+    dev->second.bytes -= std::min(dev->second.bytes, iter->size);
+    dev->second.lru.erase(iter);
+    if (dev->second.lru.empty())
+        devices_.erase(dev);
+}
+
+bool ThumbnailQuota::overQuota() const
+{
+    if (totalBytes_ > THUMBNAIL_QUOTA_TOTAL_BYTES)
+        return true;
+    for (const auto &[uuid, device] : devices_) {
+        if (device.bytes > THUMBNAIL_QUOTA_DEVICE_BYTES)
+            return true;
+    }
+    return false;
+}
+
+void ThumbnailQuota::seed()
+{
+    std::vector<std::pair<fs::file_time_type, Entry>> found;
+    std::error_code err;
+    for (fs::recursive_directory_iterator iter(THUMBNAIL_DIRECTORY, err), end;
+         !err && iter != end; iter.increment(err)) {
+        std::error_code ec;
+        if (!iter->is_regular_file(ec))
+            continue;
+        auto size = iter->file_size(ec);
+        auto lastWrite = iter->last_write_time(ec);
+        if (ec)
+            continue;
+        const auto &path = iter->path();
+        found.push_back({lastWrite,
+            {path.string(), path.parent_path().filename().string(), size}});
+    }
+
+    // everything on disk is older than the thumbnails of this run,
+    // newest first so the oldest ends up in front
+    std::sort(found.begin(), found.end(),
+        [] (const auto &a, const auto &b) { return a.first > b.first; });
+
+    std::lock_guard<std::mutex> lock(lock_);
+    int64_t used = 0;
+    for (auto &[lastWrite, entry] : found) {
+        if (entries_.find(entry.path) != entries_.end())
+            continue;
+        auto &device = devices_[entry.uuid];
+        device.bytes += entry.size;
+        totalBytes_ += entry.size;
+        count_++;
+        entry.used = used--;
+        device.lru.push_front(std::move(entry));
+        entries_[device.lru.front().path] = device.lru.begin();
+    }
+
+    LOG_INFO(0, "Thumbnail quota seeded with %zu files, %ju bytes",
+        count_, totalBytes_);
+}
+
+void ThumbnailQuota::loop()
+{
+    seed();
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            cv_.wait(lock, [this] { return exit_ || overQuota(); });
+            if (exit_)
+                break;
+        }
+        evict();
+    }
+}
+
+void ThumbnailQuota::evict()
+{
+    const uintmax_t deviceLow =
+        uintmax_t(THUMBNAIL_QUOTA_DEVICE_BYTES) * THUMBNAIL_QUOTA_LOW_WATERMARK / 100;
+    const uintmax_t totalLow =
+        uintmax_t(THUMBNAIL_QUOTA_TOTAL_BYTES) * THUMBNAIL_QUOTA_LOW_WATERMARK / 100;
+
+    int removed = 0;
+    uintmax_t freed = 0;
+    std::string trimming;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (exit_)
+                break;
+
+            // the least recently used thumbnail of a device above its
+            // quota until it is down to the low watermark, else the least
+            // recently used one at all, the devices are few
+            auto device = devices_.find(trimming);
+            if (device == devices_.end() || device->second.bytes <= deviceLow) {
+                device = devices_.end();
+                for (auto iter = devices_.begin(); iter != devices_.end(); ++iter) {
+                    if (iter->second.bytes > THUMBNAIL_QUOTA_DEVICE_BYTES) {
+                        device = iter;
+                        trimming = iter->first;
+                        break;
+                    }
+                }
+            }
+            if (device == devices_.end() && totalBytes_ > totalLow) {
+                for (auto iter = devices_.begin(); iter != devices_.end(); ++iter) {
+                    if (device == devices_.end() ||
+                        iter->second.lru.front().used < device->second.lru.front().used)
+                        device = iter;
+                }
+            }
+            if (device == devices_.end())
+                break;
+            auto victim = device->second.lru.begin();
+
+            // removed under the lock, a concurrent add() of the same
+            // thumbnail must not be lost
+            std::error_code err;
+            std::string path = victim->path;
+            freed += victim->size;
+            erase(victim);
+            if (fs::remove(path, err)) {
+                markEvicted(path);
+                removed++;
+            }
+        }
+
+        if (removed > 0 && removed % THUMBNAIL_EVICT_BATCH_SIZE == 0)
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds(THUMBNAIL_EVICT_BATCH_INTERVAL));
+    }
+
+    LOG_INFO(0, "Thumbnail eviction done, %d removed, %ju bytes released",
+        removed, freed);
+}
@@ -0,0 +1,167 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+
+/// Upper limit of the thumbnail files of one device in bytes.
+#define THUMBNAIL_QUOTA_DEVICE_BYTES (64 * 1024 * 1024)
+/// Upper limit of all thumbnail files in bytes.
+#define THUMBNAIL_QUOTA_TOTAL_BYTES (256 * 1024 * 1024)
+/// Eviction stops at this percentage of a quota.
+#define THUMBNAIL_QUOTA_LOW_WATERMARK 90
+/// Number of thumbnail files evicted before the eviction yields.
+#define THUMBNAIL_EVICT_BATCH_SIZE 50
+/// Pause between two eviction batches in milliseconds.
+#define THUMBNAIL_EVICT_BATCH_INTERVAL 50
+/// Number of evicted thumbnails remembered for regeneration.
+#define THUMBNAIL_EVICTED_MAX 4096
+
+/**
+ * \brief Size limit of the thumbnail storage.
+ *
+ * Keeps the thumbnail files of each device in least recently used
+ * order, seeded from the file modification times on startup. Once a
+ * device or the whole thumbnail directory exceeds its quota the least
+ * recently used thumbnails are removed in the background.
+ *
+ * Removed thumbnails are remembered so they can be generated again
+ * when they are requested the next time, only the most recent
+ * evictions are kept.
+ */
+class ThumbnailQuota
+{
+public:
+    /**
+     * \brief Get singleton object of ThumbnailQuota.
+     *
+     * \return The singleton.
+     */
+    static ThumbnailQuota *instance();
+
+    virtual ~ThumbnailQuota();
+
+    /**
+     * \brief Account a thumbnail file that has just been written.
+     *
+     * \param[in] path The thumbnail file.
+     */
+    void add(const std::string &path);
+
+    /**
+     * \brief Mark a thumbnail as used.
+     *
+     * \param[in] path The thumbnail file.
+     * \return True if the thumbnail has been evicted and should be
+     *         generated again.
+     */
+    bool access(const std::string &path);
+
+    /**
+     * \brief Check if a thumbnail has been evicted and not requested
+     *        since.
+     *
+     * \param[in] path The thumbnail file.
+     * \return True if the thumbnail has been evicted.
+     */
+    bool evicted(const std::string &path);
+
+    /**
+     * \brief Forget a thumbnail file that has been removed.
+     *
+     * \param[in] path The thumbnail file.
+     */
+    void remove(const std::string &path);
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// Singleton.
+    ThumbnailQuota();
+
+    /// A tracked thumbnail file.
+    struct Entry {
+        std::string path;
+        std::string uuid;
+        uintmax_t size;
+        /// Order of the last use across all devices.
+        int64_t used;
+    };
+
+    /// The tracked thumbnails of one device.
+    struct DeviceUsage {
+        /// Bytes of the thumbnails.
+        uintmax_t bytes = 0;
+        /// Thumbnails, least recently used first.
+        std::list<Entry> lru;
+    };
+
+    /// Eviction thread main loop.
+    void loop();
+
+    /// Account the existing thumbnail files as least recently used.
+    void seed();
+
+    /// Check if a device or the total exceeds its quota, lock_ held.
+    bool overQuota() const;
+
+    /// Remove least recently used thumbnails until below the quotas.
+    void evict();
+
+    /// Drop an entry from the accounting, lock_ held.
+    void erase(std::list<Entry>::iterator iter);
+
+    /// Remember an evicted thumbnail, lock_ held.
+    void markEvicted(const std::string &path);
+
+    /// Forget an evicted thumbnail, lock_ held.
+    bool forgetEvicted(const std::string &path);
+
+    /// Singleton instance object.
+    static std::unique_ptr<ThumbnailQuota> instance_;
+
+    /// Eviction thread.
+    std::thread task_;
+    /// Protects all members below.
+    std::mutex lock_;
+    std::condition_variable cv_;
+    /// Thumbnails per device uuid.
+    std::unordered_map<std::string, DeviceUsage> devices_;
+    /// Lookup of the device lru entries by path.
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+    /// Last use order handed out.
+    int64_t used_ = 0;
+    /// Number of tracked thumbnails.
+    size_t count_ = 0;
+    /// Bytes of all thumbnails.
+    uintmax_t totalBytes_ = 0;
+    /// Evicted thumbnails not requested since, oldest first.
+    std::list<std::string> evictedOrder_;
+    /// Lookup of the evicted thumbnails by path.
+    std::unordered_map<std::string, std::list<std::string>::iterator> evicted_;
+    /// Set on destruction.
+    bool exit_ = false;
+};
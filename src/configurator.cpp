@@ -29,6 +29,7 @@ Configurator *Configurator::instance()
 Configurator::Configurator(std::string confPath)
     : confPath_(confPath)
     , force_sw_decoders_(false)
+    , thumbnailVariants_({{THUMBNAIL_VARIANT_DEFAULT, 160, "jpg", 75, true}})
 {
     init();
 }
@@ -53,6 +54,10 @@ void Configurator::init()
     else
         force_sw_decoders_ = root["force-sw-decoders"].asBool();
 
+    initThumbnailVariants(root);
+    initTrickplay(root);
+    initGStreamer(root);
+
     // check supportedMediaExtension field
     if (!root.hasKey("supportedMediaExtension")) {
         LOG_WARNING(0, "Can't find supportedMediaExtension field. need to check it!");
@@ -136,6 +141,154 @@ bool Configurator::getForceSWDecodersProperty() const
     return force_sw_decoders_;
 }
 
+const ThumbnailVariants &Configurator::getThumbnailVariants() const
+{
+    return thumbnailVariants_;
+}
+
+std::string Configurator::thumbnailVariantPath(const std::string &thumbnail,
+                                               const std::string &variant) const
+{
+    if (variant == THUMBNAIL_VARIANT_DEFAULT)
+        return thumbnail;
+
+    for (const auto &v : thumbnailVariants_) {
+        if (v.name != variant)
+            continue;
+        // <id>.<name>.<format> next to the default <id>.jpg
+        auto dot = thumbnail.find_last_of('.');
+        auto slash = thumbnail.find_last_of('/');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            dot = thumbnail.size();
+        return thumbnail.substr(0, dot) + "." + v.name + "." + v.format;
+    }
+    return std::string();
+}
+
+void Configurator::initThumbnailVariants(const pbnjson::JValue &root)
+{
+    if (!root.hasKey("thumbnailVariants"))
+        return;
+
+    auto variants = root["thumbnailVariants"];
+    for (int idx = 0; idx < variants.arraySize(); idx++) {
+        auto v = variants[idx];
+        if (!v.hasKey("name") || !v.hasKey("size")) {
+            LOG_WARNING(0, "Thumbnail variant %d needs name and size", idx);
+            continue;
+        }
+
+        ThumbnailVariant variant = { v["name"].asString(),
+            v["size"].asNumber<int32_t>(), "jpg", 75, true };
+        if (v.hasKey("format"))
+            variant.format = toLower(v["format"].asString());
+        if (v.hasKey("quality"))
+            variant.quality = v["quality"].asNumber<int32_t>();
+        if (v.hasKey("eager"))
+            variant.eager = v["eager"].asBool();
+
+#if !defined HAS_WEBP
+        if (variant.format == "webp") {
+            LOG_WARNING(0, "No WebP support, thumbnail variant '%s' uses jpg",
+                variant.name.c_str());
+            variant.format = "jpg";
+        }
+#endif
+        if (variant.name.empty() || variant.name.find_first_of("./") != std::string::npos ||
+            variant.size <= 0 || variant.quality <= 0 || variant.quality > 100 ||
+            (variant.format != "jpg" && variant.format != "webp")) {
+            LOG_WARNING(0, "Invalid thumbnail variant '%s'", variant.name.c_str());
+            continue;
+        }
+
+        // the default variant keeps its file name and format, the
+        // media database references it
+        if (variant.name == THUMBNAIL_VARIANT_DEFAULT) {
+            thumbnailVariants_[0].size = variant.size;
+            thumbnailVariants_[0].quality = variant.quality;
+            continue;
+        }
+
+        auto iter = std::find_if(thumbnailVariants_.begin(), thumbnailVariants_.end(),
+            [&variant] (const ThumbnailVariant &t) { return t.name == variant.name; });
+        if (iter != thumbnailVariants_.end()) {
+            LOG_WARNING(0, "Duplicated thumbnail variant '%s'", variant.name.c_str());
+            continue;
+        }
+        thumbnailVariants_.push_back(variant);
+    }
+
+    for (const auto &v : thumbnailVariants_)
+        LOG_INFO(0, "Thumbnail variant '%s' : %dpx %s quality %d%s", v.name.c_str(),
+            v.size, v.format.c_str(), v.quality, v.eager ? "" : " on request");
+}
+
+void Configurator::initTrickplay(const pbnjson::JValue &root)
+{
+    if (!root.hasKey("trickplay"))
+        return;
+
+    auto t = root["trickplay"];
+    TrickplayConfig config;
+    if (t.hasKey("enabled"))
+        config.enabled = t["enabled"].asBool();
+    if (t.hasKey("interval"))
+        config.interval = t["interval"].asNumber<int32_t>();
+    if (t.hasKey("tileWidth"))
+        config.tileWidth = t["tileWidth"].asNumber<int32_t>();
+    if (t.hasKey("columns"))
+        config.columns = t["columns"].asNumber<int32_t>();
+    if (t.hasKey("maxTiles"))
+        config.maxTiles = t["maxTiles"].asNumber<int32_t>();
+    if (t.hasKey("quality"))
+        config.quality = t["quality"].asNumber<int32_t>();
+    if (t.hasKey("cpuBudget"))
+        config.cpuBudget = t["cpuBudget"].asNumber<int32_t>();
+
+    if (config.interval <= 0 || config.tileWidth <= 0 || config.columns <= 0 ||
+        config.maxTiles <= 0 || config.quality <= 0 || config.quality > 100 ||
+        config.cpuBudget <= 0 || config.cpuBudget > 100) {
+        LOG_WARNING(0, "Invalid trickplay configuration, trickplay disabled");
+        return;
+    }
+
+    trickplay_ = config;
+    LOG_INFO(0, "Trickplay %s : every %ds, %dpx tiles, %d columns, %d%% cpu",
+        trickplay_.enabled ? "enabled" : "disabled", trickplay_.interval,
+        trickplay_.tileWidth, trickplay_.columns, trickplay_.cpuBudget);
+}
+
+const TrickplayConfig &Configurator::getTrickplay() const
+{
+    return trickplay_;
+}
+
+void Configurator::initGStreamer(const pbnjson::JValue &root)
+{
+    if (!root.hasKey("gstreamer"))
+        return;
+
+    auto g = root["gstreamer"];
+    if (g.hasKey("trimRegistry"))
+        gstreamer_.trimRegistry = g["trimRegistry"].asBool();
+    if (g.hasKey("preload"))
+        gstreamer_.preload = g["preload"].asBool();
+    if (g.hasKey("plugins")) {
+        auto plugins = g["plugins"];
+        for (int idx = 0; idx < plugins.arraySize(); idx++)
+            gstreamer_.plugins.push_back(plugins[idx].asString());
+    }
+
+    LOG_INFO(0, "GStreamer registry %s, preload %s",
+        gstreamer_.trimRegistry ? "trimmed" : "full",
+        gstreamer_.preload ? "enabled" : "disabled");
+}
+
+const GStreamerConfig &Configurator::getGStreamer() const
+{
+    return gstreamer_;
+}
+
 std::string Configurator::getConfigurationPath() const
 {
     return confPath_;
@@ -19,11 +19,60 @@
 #include "mediaitem.h"
 #include <pbnjson.hpp>
 #include <unordered_map>
+#include <vector>
 
 /// alias
 using MediaItemTypeInfo = std::pair<MediaItem::Type, MediaItem::ExtractorType>;
 using ExtensionMap = std::unordered_map<std::string, MediaItemTypeInfo>;
 
+/// Name of the thumbnail variant stored in the media database.
+#define THUMBNAIL_VARIANT_DEFAULT "default"
+
+/// A configured thumbnail size and format.
+struct ThumbnailVariant {
+    /// Name clients request the variant with.
+    std::string name;
+    /// Edge length of the square thumbnail in pixels.
+    int size;
+    /// Image format and file extension, jpg or webp.
+    std::string format;
+    /// Compression quality, 1 to 100.
+    int quality;
+    /// Generate together with the default thumbnail, else on request.
+    bool eager;
+};
+using ThumbnailVariants = std::vector<ThumbnailVariant>;
+
+/// Seek preview sprite sheet settings of videos.
+struct TrickplayConfig {
+    /// Generate sprite sheets at all.
+    bool enabled = false;
+    /// Seconds between two preview frames.
+    int interval = 10;
+    /// Width of a preview frame in pixels.
+    int tileWidth = 160;
+    /// Preview frames per sprite sheet row.
+    int columns = 10;
+    /// Maximum number of preview frames, the interval grows for long
+    /// videos.
+    int maxTiles = 360;
+    /// JPEG quality of the sprite sheet, 1 to 100.
+    int quality = 60;
+    /// Share of one CPU the generation may use in percent.
+    int cpuBudget = 25;
+};
+
+/// GStreamer start up settings.
+struct GStreamerConfig {
+    /// Use a private registry with only the plugins the supported
+    /// extensions need.
+    bool trimRegistry = false;
+    /// Load demuxers, parsers and decoders in the background at start.
+    bool preload = false;
+    /// Plugins kept in the registry in addition to the derived ones.
+    std::vector<std::string> plugins;
+};
+
 /// Configurator class for media indexer configuration from json conf file.
 class Configurator
 {
@@ -37,6 +86,40 @@ public:
     MediaItemTypeInfo getTypeInfo(const std::string& ext) const;
     ExtensionMap getSupportedExtensions() const;
     bool getForceSWDecodersProperty() const;
+
+    /**
+     * \brief Get the thumbnail variants.
+     *
+     * The first entry is always the default variant, the thumbnail
+     * file referenced from the media database.
+     *
+     * \return The configured variants.
+     */
+    const ThumbnailVariants &getThumbnailVariants() const;
+
+    /**
+     * \brief Get the file of a thumbnail variant.
+     *
+     * \param[in] thumbnail The default thumbnail file.
+     * \param[in] variant The variant name.
+     * \return The variant file, empty if no such variant is configured.
+     */
+    std::string thumbnailVariantPath(const std::string &thumbnail,
+                                     const std::string &variant) const;
+
+    /**
+     * \brief Get the seek preview sprite sheet settings.
+     *
+     * \return The settings, disabled if not configured.
+     */
+    const TrickplayConfig &getTrickplay() const;
+
+    /**
+     * \brief Get the GStreamer start up settings.
+     *
+     * \return The settings, nothing enabled if not configured.
+     */
+    const GStreamerConfig &getGStreamer() const;
     std::string getConfigurationPath() const;
     bool insertExtension(const std::string& ext,
                          const MediaItem::Type& type = MediaItem::Type::EOL,
@@ -61,6 +144,24 @@ public:
     /// GStreamer property for software decoding
     bool force_sw_decoders_;
 
+    /// Thumbnail variants, the default one first.
+    ThumbnailVariants thumbnailVariants_;
+
+    /// Read the thumbnailVariants field.
+    void initThumbnailVariants(const pbnjson::JValue &root);
+
+    /// Seek preview sprite sheet settings.
+    TrickplayConfig trickplay_;
+
+    /// Read the trickplay field.
+    void initTrickplay(const pbnjson::JValue &root);
+
+    /// GStreamer start up settings.
+    GStreamerConfig gstreamer_;
+
+    /// Read the gstreamer field.
+    void initGStreamer(const pbnjson::JValue &root);
+
     /// Singleton instance object.
     static std::unique_ptr<Configurator> instance_;
 };
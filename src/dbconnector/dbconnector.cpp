@@ -16,18 +16,118 @@
 
 #include "dbconnector.h"
 
+#include <glib.h>
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <algorithm>
+
 /// From main.cpp.
 extern const char *lunaServiceId;
 
 const char *DbConnector::dbUrl_ = "luna://com.webos.mediadb/";
 LSHandle *DbConnector::lsHandle_ = nullptr;
 std::string DbConnector::suffix_ = ":1";
+std::map<std::string, std::string> DbConnector::kindHashes_;
+std::mutex DbConnector::kindLock_;
+std::list<DbConnector *> DbConnector::connectors_;
+std::list<std::function<void()>> DbConnector::deferred_;
+std::list<std::function<void()>> DbConnector::deferredKinds_;
+int DbConnector::kindsInFlight_ = 0;
+bool DbConnector::connected_ = false;
+bool DbConnector::ready_ = false;
+std::mutex DbConnector::readyLock_;
+std::condition_variable DbConnector::readyCv_;
+int DbConnector::backgroundInFlight_ = 0;
+int DbConnector::foregroundInFlight_ = 0;
+std::vector<int> DbConnector::latencies_;
+size_t DbConnector::latencyCount_ = 0;
+std::mutex DbConnector::channelLock_;
+std::condition_variable DbConnector::channelCv_;
 
 void DbConnector::init(LSHandle * lsHandle)
 {
     lsHandle_ = lsHandle;
 }
 
+void DbConnector::connected()
+{
+    std::list<std::function<void()>> kinds;
+    {
+        std::lock_guard<std::mutex> lk(readyLock_);
+        if (connected_)
+            return;
+        connected_ = true;
+        kinds.swap(deferredKinds_);
+        // do not get ready before all kinds have been sent
+        ++kindsInFlight_;
+    }
+
+    LOG_INFO(0, "Db service connected, register %zu deferred kinds",
+        kinds.size());
+    for (auto &func : kinds)
+        func();
+
+    {
+        std::lock_guard<std::mutex> lk(readyLock_);
+        --kindsInFlight_;
+    }
+    checkReady();
+}
+
+bool DbConnector::isReady()
+{
+    std::lock_guard<std::mutex> lk(readyLock_);
+    return ready_;
+}
+
+void DbConnector::deferUntilReady(std::function<void()> func)
+{
+    {
+        std::lock_guard<std::mutex> lk(readyLock_);
+        if (!ready_) {
+            deferred_.push_back(std::move(func));
+            return;
+        }
+    }
+    func();
+}
+
+void DbConnector::checkReady()
+{
+    std::list<std::function<void()>> deferred;
+    std::list<std::pair<DbConnector *, ReplayData *>> failed;
+    {
+        std::lock_guard<std::mutex> lk(readyLock_);
+        if (ready_ || !connected_ || kindsInFlight_ > 0)
+            return;
+
+        // replay with the lock held, no new write request may overtake
+        // the queued ones
+        for (auto conn : connectors_) {
+            for (auto data : conn->replayWrites())
+                failed.emplace_back(conn, data);
+        }
+        ready_ = true;
+        deferred.swap(deferred_);
+    }
+    readyCv_.notify_all();
+
+    // account the writes anyway, the devices have to finish processing
+    for (auto &[conn, data] : failed) {
+        for (auto &[method, obj] : data->writes)
+            conn->completeWrite(method, obj);
+        delete data;
+    }
+
+    LOG_INFO(0, "Db service ready, issue %zu deferred requests",
+        deferred.size());
+    for (auto &func : deferred)
+        func();
+}
+
 DbConnector::DbConnector(const char *serviceName, bool async) :
     serviceName_(serviceName)
 {
@@ -41,9 +141,25 @@ DbConnector::DbConnector(const char *serviceName, bool async) :
 
     connector_->registerTokenCallback(
         [this](LSMessageToken & token, const std::string &dbServiceMethod,
-               const std::string &dbMethod, void *obj) -> void {
+               const std::string &dbMethod, void *obj, const std::string &uri,
+               const std::string &payload) -> void {
             auto query = pbnjson::Object();
             rememberSessionData(token, dbServiceMethod, dbMethod, query, obj, HDL_LUNA_CONN);
+
+            // keep background writes until answered, they are queued
+            // again if the kind got lost
+            auto method = uri.substr(uri.find_last_of('/') + 1);
+            if (dbMethod != std::string(BACKGROUND_CHANNEL) ||
+                dbServiceMethod == "replay" ||
+                (method != "mergePut" && method != "merge" &&
+                 method != "put" && method != "batch"))
+                return;
+            std::lock_guard<std::mutex> lock(lock_);
+            auto match = messageMap_[HDL_LUNA_CONN].find(token);
+            if (match != messageMap_[HDL_LUNA_CONN].end()) {
+                match->second.writeMethod = method;
+                match->second.writeRequest = payload;
+            }
         });
 
     connector_->registerTokenCancelCallback(
@@ -52,6 +168,11 @@ DbConnector::DbConnector(const char *serviceName, bool async) :
                 LOG_ERROR(0, "Failed in sessionDataFromToken for token %ld", (long)token);
             }
         });
+
+    writeQueue_ = std::make_unique<WriteBehindQueue>(
+        std::string(WRITE_BEHIND_DIRECTORY) + serviceName_ + ".pending");
+    std::lock_guard<std::mutex> lk(readyLock_);
+    connectors_.push_back(this);
 }
 
 DbConnector::DbConnector()
@@ -61,39 +182,68 @@ DbConnector::DbConnector()
 
 DbConnector::~DbConnector()
 {
-    // nothing to be done here
+    {
+        std::lock_guard<std::mutex> lk(readyLock_);
+        connectors_.remove(this);
+    }
     connector_.reset();
 }
 
 void DbConnector::ensureKind(const std::string &kind_name)
 {
-    LSError lsError;
-    LSErrorInit(&lsError);
     LSMessageToken sessionToken;
 
+    {
+        std::lock_guard<std::mutex> lk(readyLock_);
+        if (!connected_) {
+            deferredKinds_.push_back([this, kind_name] {
+                ensureKind(kind_name);
+            });
+            return;
+        }
+    }
+
     // ensure that kind exists
     std::string url = dbUrl_;
     url += "putKind";
 
     auto kind = pbnjson::Object();
-    if (kind_name.empty()) {
-        kind.put("id", kindId_);
-    } else {
-        kind.put("id", kind_name);
-    }
+    std::string id = kind_name.empty() ? kindId_ : kind_name;
+    kind.put("id", id);
     kind.put("indexes", kindIndexes_);
     kind.put("owner", serviceName_.c_str());
 
-    LOG_INFO(0, "Ensure kind '%s' or '%s'", kind_name.c_str(), kindId_.c_str());
-/*
-    if (!LSCall(lsHandle_, url.c_str(), kind.stringify().c_str(),
-                DbConnector::onLunaResponse2, this, &sessionToken, &lsError)) {
-        LOG_ERROR(0, "db service putKind error");
+    auto payload = kind.stringify();
+    auto hash = kindHash(payload);
+
+    loadKindHashes();
+    {
+        std::lock_guard<std::mutex> lk(kindLock_);
+        auto match = kindHashes_.find(id);
+        if (match != kindHashes_.end() && match->second == hash) {
+            LOG_INFO(0, "Kind '%s' is up to date, skip putKind", id.c_str());
+            skippedKinds_[id] = payload;
+            return;
+        }
     }
-*/
-    if (!connector_->sendMessage(url.c_str(), kind.stringify().c_str(),
-            DbConnector::onLunaResponse, this, true, &sessionToken)) {
+
+    LOG_INFO(0, "Ensure kind '%s'", id.c_str());
+
+    // the registration is released from the response handler
+    auto reg = new KindRegistration{id, hash};
+    {
+        std::lock_guard<std::mutex> lk(readyLock_);
+        ++kindsInFlight_;
+    }
+    if (!connector_->sendMessage(url.c_str(), payload.c_str(),
+            DbConnector::onLunaResponse, this, true, &sessionToken, reg)) {
         LOG_ERROR(0, "Db service putKind error");
+        delete reg;
+        {
+            std::lock_guard<std::mutex> lk(readyLock_);
+            --kindsInFlight_;
+        }
+        checkReady();
     }
 }
 
@@ -130,11 +280,19 @@ bool DbConnector::mergePut(const std::string &uri, bool precise,
     request.put("props", props);
     request.put("query", query);
 
+    if (deferWrite("mergePut", request, obj, "mergePut"))
+        return true;
+
     LOG_INFO(0, "Send mergePut for '%s', request : '%s'", uri.c_str(), request.stringify().c_str());
 
+    if (async)
+        acquireBackground();
     if (!connector_->sendMessage(url.c_str(), request.stringify().c_str(),
-            DbConnector::onLunaResponse, this, async, &sessionToken, obj)) {
+            DbConnector::onLunaResponse, this, async, &sessionToken, obj,
+            std::string(), async ? BACKGROUND_CHANNEL : "")) {
         LOG_ERROR(0, "Db service mergePut error");
+        if (async)
+            releaseBackgroundSlot();
         return false;
     }
 
@@ -168,11 +326,19 @@ bool DbConnector::merge(const std::string &kind_name, pbnjson::JValue &props,
     request.put("props", props);
     request.put("query", query);
 
+    if (deferWrite("merge", request, obj, method.empty() ? "merge" : method))
+        return true;
+
     LOG_INFO(0, "Send merges for '%s', request : '%s'", whereVal.c_str(), request.stringify().c_str());
 
+    if (async)
+        acquireBackground();
     if (!connector_->sendMessage(url.c_str(), request.stringify().c_str(),
-            DbConnector::onLunaResponse, this, async, &sessionToken, obj, method)) {
+            DbConnector::onLunaResponse, this, async, &sessionToken, obj, method,
+            async ? BACKGROUND_CHANNEL : "")) {
         LOG_ERROR(0, "Db service mergePut error");
+        if (async)
+            releaseBackgroundSlot();
         return false;
     }
 
@@ -189,11 +355,19 @@ bool DbConnector::put(pbnjson::JValue &props, void *obj, bool atomic, std::strin
     auto request = pbnjson::Object();//props;
     request.put("objects", props);
 
+    if (deferWrite("put", request, obj, method.empty() ? "put" : method))
+        return true;
+
     //LOG_DEBUG("Send put for '%s', request : '%s'", uri.c_str(), request.stringify().c_str());
 
+    if (async)
+        acquireBackground();
     if (!connector_->sendMessage(url.c_str(), request.stringify().c_str(),
-            DbConnector::onLunaResponse, this, async, &sessionToken, obj, method)) {
+            DbConnector::onLunaResponse, this, async, &sessionToken, obj, method,
+            async ? BACKGROUND_CHANNEL : "")) {
         LOG_ERROR(0, "Db service put error");
+        if (async)
+            releaseBackgroundSlot();
         return false;
     }
 
@@ -224,6 +398,14 @@ bool DbConnector::find(const std::string &uri, bool precise,
     where << cond;
     query.put("where", where);
 
+    // nobody waits for the result, look it up once the db is ready
+    if (!obj && !isReady()) {
+        deferUntilReady([this, uri, precise, kind_name, atomic] {
+            find(uri, precise, nullptr, kind_name, atomic);
+        });
+        return true;
+    }
+
     auto request = pbnjson::Object();
     request.put("query", query);
 
@@ -249,11 +431,19 @@ bool DbConnector::batch(pbnjson::JValue &operations, const std::string &dbMethod
     auto request = pbnjson::Object();
     request.put("operations", operations);
 
+    if (deferWrite("batch", request, obj, dbMethod.empty() ? "batch" : dbMethod))
+        return true;
+
     LOG_INFO(0, "Send batch for '%s'", dbMethod.c_str());
 
+    if (async)
+        acquireBackground();
     if (!connector_->sendMessage(url.c_str(), request.stringify().c_str(),
-            DbConnector::onLunaResponse, this, async, &sessionToken, obj, dbMethod)) {
+            DbConnector::onLunaResponse, this, async, &sessionToken, obj, dbMethod,
+            async ? BACKGROUND_CHANNEL : "")) {
         LOG_ERROR(0, "Db service batch error");
+        if (async)
+            releaseBackgroundSlot();
         return false;
     }
 
@@ -273,15 +463,24 @@ bool DbConnector::search(pbnjson::JValue &query, const std::string &dbMethod, vo
     auto request = pbnjson::Object();
     request.put("query", query);
 
+    bool foreground = isForeground(dbMethod);
+    if (foreground) {
+        std::lock_guard<std::mutex> lk(channelLock_);
+        ++foregroundInFlight_;
+    }
+
     if (!LSCall(lsHandle_, url.c_str(), request.stringify().c_str(),
                 DbConnector::onLunaResponseMetaData, this, &sessionToken, &lsError)) {
         LOG_ERROR(0, "Db service search error");
         LSErrorPrint(&lsError, stderr);
         LSErrorFree(&lsError);
+        if (foreground)
+            completeForeground(LSMESSAGE_TOKEN_INVALID);
         return false;
     }
 
-    rememberSessionData(sessionToken, dbServiceMethod, dbMethod, query, obj);
+    rememberSessionData(sessionToken, dbServiceMethod, dbMethod, query, obj,
+        HDL_DEFAULT, foreground);
 
     return true;
 }
@@ -297,15 +496,25 @@ bool DbConnector::del(pbnjson::JValue &query, const std::string &dbMethod, void
 
     auto request = pbnjson::Object();
     request.put("query", query);
+
+    bool foreground = isForeground(dbMethod);
+    if (foreground) {
+        std::lock_guard<std::mutex> lk(channelLock_);
+        ++foregroundInFlight_;
+    }
+
     if (!LSCall(lsHandle_, url.c_str(), request.stringify().c_str(),
                 DbConnector::onLunaResponseMetaData, this, &sessionToken, &lsError)) {
         LOG_ERROR(0, "Db service del error");
         LSErrorPrint(&lsError, stderr);
         LSErrorFree(&lsError);
+        if (foreground)
+            completeForeground(LSMESSAGE_TOKEN_INVALID);
         return false;
     }
 
-    rememberSessionData(sessionToken, dbServiceMethod, dbMethod, query, obj);
+    rememberSessionData(sessionToken, dbServiceMethod, dbMethod, query, obj,
+        HDL_DEFAULT, foreground);
 
     return true;
 }
@@ -409,6 +618,15 @@ void DbConnector::putRespObject(bool returnValue, pbnjson::JValue & obj,
     obj.put("errorText", errorText);
 }
 
+void DbConnector::putRespObject(bool returnValue, ReplyWriter &writer,
+                const int& errorCode,
+                const std::string& errorText)
+{
+    writer.key("returnValue").boolean(returnValue);
+    writer.key("errorCode").number(errorCode);
+    writer.key("errorText").string(errorText);
+}
+
 bool DbConnector::sendResponse(LSHandle *sender, LSMessage* message, const std::string &object)
 {
     if (!connector_)
@@ -439,27 +657,439 @@ bool DbConnector::onLunaResponse(LSHandle *lsHandle, LSMessage *msg, void *ctx)
 {
     DbConnector *connector = static_cast<DbConnector *>(ctx);
     LOG_DEBUG("onLunaResponse");
+
+    connector->releaseBackground(LSMessageGetResponseToken(msg));
+
+    // the kind may have been lost since we registered it, e.g. after a
+    // db reset, register skipped kinds again and forget what we know
+    if (strstr(LSMessageGetPayload(msg), DB_ERR_KIND_NOT_REGISTERED)) {
+        connector->reregisterKinds();
+        if (connector->requeueWrite(LSMessageGetResponseToken(msg)))
+            return true;
+    }
+
+    if (connector->handleKindResponse(msg) ||
+        connector->handleReplayResponse(msg))
+        return true;
     return connector->handleLunaResponse(msg);
 }
 
+bool DbConnector::deferWrite(const std::string &method,
+    const pbnjson::JValue &params, void *obj, const std::string &respMethod)
+{
+    std::unique_lock<std::mutex> lk(readyLock_);
+    if (ready_ || !writeQueue_)
+        return false;
+
+    // never stall the main loop, the db service status is reported
+    // from there
+    bool force = g_main_context_is_owner(g_main_context_default());
+    while (!ready_) {
+        if (writeQueue_->push(method, params, respMethod, obj, force))
+            return true;
+        if (force)
+            return false;
+        LOG_WARNING(0, "Write-behind queue of '%s' is full, wait for db service",
+            serviceName_.c_str());
+        readyCv_.wait(lk);
+    }
+    return false;
+}
+
+std::list<DbConnector::ReplayData *> DbConnector::replayWrites()
+{
+    std::list<ReplayData *> failed;
+    if (!writeQueue_ || writeQueue_->empty())
+        return failed;
+
+    auto entries = writeQueue_->drain();
+    LOG_INFO(0, "Replay %zu queued write requests of '%s'", entries.size(),
+        serviceName_.c_str());
+
+    auto operations = pbnjson::Array();
+    auto data = new ReplayData;
+    auto sendBatch = [this, &operations, &data, &failed] () {
+        if (operations.arraySize() == 0)
+            return;
+        auto request = pbnjson::Object();
+        request.put("operations", operations);
+        if (!sendReplay("batch", request, data))
+            failed.push_back(data);
+        operations = pbnjson::Array();
+        data = new ReplayData;
+    };
+
+    for (auto &entry : entries) {
+        // a mergePut is not available as batch operation and its props
+        // may hold only some fields, replay it as it is, in order
+        if (entry.method == std::string("mergePut")) {
+            sendBatch();
+            auto single = new ReplayData;
+            if (entry.object)
+                single->writes.emplace_back(entry.respMethod, entry.object);
+            if (!sendReplay("mergePut", entry.params, single))
+                failed.push_back(single);
+            continue;
+        }
+
+        std::list<std::pair<std::string, pbnjson::JValue>> ops;
+        if (entry.method == std::string("batch")) {
+            auto batchOps = entry.params["operations"];
+            for (ssize_t i = 0; i < batchOps.arraySize(); ++i)
+                ops.emplace_back(batchOps[i]["method"].asString(),
+                    batchOps[i]["params"]);
+        } else {
+            ops.emplace_back(entry.method, entry.params);
+        }
+
+        // keep the operations of one request within one batch
+        if (static_cast<size_t>(operations.arraySize()) + ops.size() >
+                WRITE_BEHIND_BATCH_SIZE)
+            sendBatch();
+
+        for (auto &[method, params] : ops) {
+            auto operation = pbnjson::Object();
+            operation.put("method", method);
+            operation.put("params", params);
+            operations << operation;
+        }
+        if (entry.object)
+            data->writes.emplace_back(entry.respMethod, entry.object);
+    }
+
+    sendBatch();
+    delete data;
+
+    return failed;
+}
+
+bool DbConnector::sendReplay(const char *method, const pbnjson::JValue &request,
+    ReplayData *data)
+{
+    LSMessageToken sessionToken;
+    std::string url = dbUrl_;
+    url += method;
+
+    // replayed with readyLock_ held, take the slot without waiting
+    {
+        std::lock_guard<std::mutex> lk(channelLock_);
+        ++backgroundInFlight_;
+    }
+    if (!connector_->sendMessage(url.c_str(), request.stringify().c_str(),
+            DbConnector::onLunaResponse, this, true, &sessionToken, data,
+            "replay", BACKGROUND_CHANNEL)) {
+        LOG_ERROR(0, "Db service %s error on replay", method);
+        releaseBackgroundSlot();
+        return false;
+    }
+
+    return true;
+}
+
+bool DbConnector::handleReplayResponse(LSMessage *msg)
+{
+    SessionData sd;
+    if (!takeSessionData(LSMessageGetResponseToken(msg), "replay", &sd))
+        return false;
+
+    auto data = static_cast<ReplayData *>(sd.object);
+    if (!data)
+        return true;
+
+    pbnjson::JDomParser parser(pbnjson::JSchema::AllSchema());
+    const char *payload = LSMessageGetPayload(msg);
+    if (!parser.parse(payload) || !parser.getDom()["returnValue"].asBool())
+        LOG_ERROR(0, "Replay of queued write requests failed : %s", payload);
+
+    for (auto &[method, obj] : data->writes)
+        completeWrite(method, obj);
+    delete data;
+    return true;
+}
+
+bool DbConnector::takeSessionData(LSMessageToken token,
+    const std::string &method, SessionData *sd)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    auto match = messageMap_[HDL_LUNA_CONN].find(token);
+    if (match == messageMap_[HDL_LUNA_CONN].end() ||
+        match->second.dbServiceMethod != method)
+        return false;
+    *sd = match->second;
+    messageMap_[HDL_LUNA_CONN].erase(match);
+    return true;
+}
+
+bool DbConnector::handleKindResponse(LSMessage *msg)
+{
+    SessionData sd;
+    if (!takeSessionData(LSMessageGetResponseToken(msg), "putKind", &sd))
+        return false;
+
+    auto reg = static_cast<KindRegistration *>(sd.object);
+    if (!reg)
+        return true;
+
+    pbnjson::JDomParser parser(pbnjson::JSchema::AllSchema());
+    const char *payload = LSMessageGetPayload(msg);
+    if (parser.parse(payload) && parser.getDom()["returnValue"].asBool()) {
+        LOG_INFO(0, "Kind '%s' registered", reg->kindId.c_str());
+        {
+            std::lock_guard<std::mutex> lk(kindLock_);
+            kindHashes_[reg->kindId] = reg->hash;
+        }
+        saveKindHashes();
+    } else {
+        LOG_ERROR(0, "Failed to register kind '%s' : %s", reg->kindId.c_str(),
+            payload);
+    }
+
+    delete reg;
+
+    {
+        std::lock_guard<std::mutex> lk(readyLock_);
+        --kindsInFlight_;
+    }
+    checkReady();
+    return true;
+}
+
+void DbConnector::reregisterKinds()
+{
+    std::map<std::string, std::string> kinds;
+    {
+        std::lock_guard<std::mutex> lk(kindLock_);
+        if (kindHashes_.empty() && skippedKinds_.empty())
+            return;
+        LOG_WARNING(0, "Db service lost registered kinds, register again");
+        kindHashes_.clear();
+        kinds.swap(skippedKinds_);
+    }
+    saveKindHashes();
+    if (kinds.empty())
+        return;
+
+    {
+        // queue the writes until the kinds are back, the replay makes
+        // us ready again
+        std::lock_guard<std::mutex> lk(readyLock_);
+        ready_ = false;
+        kindsInFlight_ += static_cast<int>(kinds.size());
+    }
+
+    std::string url = dbUrl_;
+    url += "putKind";
+    for (const auto &[id, payload] : kinds) {
+        LSMessageToken sessionToken;
+        auto reg = new KindRegistration{id, kindHash(payload)};
+        if (!connector_->sendMessage(url.c_str(), payload.c_str(),
+                DbConnector::onLunaResponse, this, true, &sessionToken, reg)) {
+            LOG_ERROR(0, "Db service putKind error for '%s'", id.c_str());
+            delete reg;
+            std::lock_guard<std::mutex> lk(readyLock_);
+            --kindsInFlight_;
+        }
+    }
+    kindsLost();
+    checkReady();
+}
+
+bool DbConnector::requeueWrite(LSMessageToken token)
+{
+    SessionData sd;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto match = messageMap_[HDL_LUNA_CONN].find(token);
+        if (match == messageMap_[HDL_LUNA_CONN].end() ||
+            match->second.writeMethod.empty())
+            return false;
+        sd = match->second;
+    }
+
+    pbnjson::JDomParser parser(pbnjson::JSchema::AllSchema());
+    if (!parser.parse(sd.writeRequest))
+        return false;
+
+    {
+        // only while the kinds are registered again, a write that keeps
+        // failing must not loop
+        std::lock_guard<std::mutex> lk(readyLock_);
+        if (ready_ || !writeQueue_ || !writeQueue_->push(sd.writeMethod,
+                parser.getDom(), sd.dbServiceMethod, sd.object, true))
+            return false;
+    }
+
+    LOG_INFO(0, "Queue '%s' of '%s' again until the kind is registered",
+        sd.writeMethod.c_str(), serviceName_.c_str());
+    sessionDataFromToken(token, &sd, HDL_LUNA_CONN);
+    return true;
+}
+
+std::string DbConnector::kindHash(const std::string &payload)
+{
+    gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1,
+        payload.c_str(), -1);
+    std::string hash(checksum ? checksum : "");
+    g_free(checksum);
+    return hash;
+}
+
+void DbConnector::loadKindHashes()
+{
+    static std::once_flag loaded;
+    std::call_once(loaded, [] {
+        auto root = pbnjson::JDomParser::fromFile(KIND_HASH_FILE);
+        if (!root.isObject()) {
+            LOG_DEBUG("No registered kinds stored in '%s'", KIND_HASH_FILE);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lk(kindLock_);
+        for (auto entry : root.children()) {
+            if (entry.second.isString())
+                kindHashes_[entry.first.asString()] = entry.second.asString();
+        }
+    });
+}
+
+void DbConnector::saveKindHashes()
+{
+    auto kinds = pbnjson::Object();
+    {
+        std::lock_guard<std::mutex> lk(kindLock_);
+        for (const auto &[id, hash] : kindHashes_)
+            kinds.put(id, hash);
+    }
+
+    // write to a temporary file first so a crash never leaves a
+    // truncated file behind
+    std::error_code err;
+    std::filesystem::create_directories(
+        std::filesystem::path(KIND_HASH_FILE).parent_path(), err);
+    std::string tmpFile = std::string(KIND_HASH_FILE) + ".tmp";
+    FILE *fp = fopen(tmpFile.c_str(), "w");
+    if (!fp) {
+        LOG_WARNING(0, "Failed to open '%s', caused by : %s", tmpFile.c_str(),
+            strerror(errno));
+        return;
+    }
+    auto payload = kinds.stringify();
+    bool ok = fwrite(payload.c_str(), 1, payload.size(), fp) == payload.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmpFile.c_str(), KIND_HASH_FILE) < 0) {
+        LOG_WARNING(0, "Failed to save registered kinds");
+        unlink(tmpFile.c_str());
+    }
+}
+
 bool DbConnector::onLunaResponseMetaData(LSHandle *lsHandle, LSMessage *msg, void *ctx)
 {
     DbConnector *connector = static_cast<DbConnector *>(ctx);
+    connector->completeForeground(LSMessageGetResponseToken(msg));
+    if (strstr(LSMessageGetPayload(msg), DB_ERR_KIND_NOT_REGISTERED))
+        connector->reregisterKinds();
     return connector->handleLunaResponseMetaData(msg);
 }
 
+void DbConnector::acquireBackground()
+{
+    // responses are dispatched from these threads, waiting for them
+    // would only run into the timeout
+    bool dispatcher = g_main_context_is_owner(g_main_context_default()) ||
+        connector_->isLoopThread();
+
+    std::unique_lock<std::mutex> lk(channelLock_);
+    if (!dispatcher) {
+        channelCv_.wait_for(lk, std::chrono::milliseconds(BACKGROUND_MAX_WAIT),
+            [] {
+                return foregroundInFlight_ == 0 &&
+                    backgroundInFlight_ < BACKGROUND_WINDOW;
+            });
+    }
+    ++backgroundInFlight_;
+}
+
+void DbConnector::releaseBackground(LSMessageToken token)
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto match = messageMap_[HDL_LUNA_CONN].find(token);
+        if (match == messageMap_[HDL_LUNA_CONN].end() ||
+            match->second.dbMethod != std::string(BACKGROUND_CHANNEL))
+            return;
+        // tag consumed, the response handler does not need it
+        match->second.dbMethod.clear();
+    }
+    releaseBackgroundSlot();
+}
+
+void DbConnector::releaseBackgroundSlot()
+{
+    {
+        std::lock_guard<std::mutex> lk(channelLock_);
+        if (backgroundInFlight_ > 0)
+            --backgroundInFlight_;
+    }
+    channelCv_.notify_all();
+}
+
+void DbConnector::completeForeground(LSMessageToken token)
+{
+    int latency = -1;
+    if (token != LSMESSAGE_TOKEN_INVALID) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto match = messageMap_[HDL_DEFAULT].find(token);
+        if (match == messageMap_[HDL_DEFAULT].end() || !match->second.foreground)
+            return;
+        match->second.foreground = false;
+        latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - match->second.sent).count();
+    }
+
+    int p99 = -1;
+    int background = 0;
+    size_t samples = 0;
+    {
+        std::lock_guard<std::mutex> lk(channelLock_);
+        if (foregroundInFlight_ > 0)
+            --foregroundInFlight_;
+
+        if (latency >= 0) {
+            if (latencies_.size() < LATENCY_SAMPLES)
+                latencies_.push_back(latency);
+            else
+                latencies_[latencyCount_ % LATENCY_SAMPLES] = latency;
+
+            if (++latencyCount_ % LATENCY_LOG_INTERVAL == 0) {
+                std::vector<int> sorted(latencies_);
+                auto nth = sorted.begin() + (sorted.size() * 99) / 100;
+                std::nth_element(sorted.begin(), nth, sorted.end());
+                p99 = *nth;
+                background = backgroundInFlight_;
+                samples = sorted.size();
+            }
+        }
+    }
+    channelCv_.notify_all();
+
+    if (p99 >= 0)
+        LOG_PERF("Foreground query latency p99 %d ms over %zu queries, "
+            "%d background writes in flight", p99, samples, background);
+}
+
 void DbConnector::rememberSessionData(LSMessageToken token,
                                       const std::string &dbServiceMethod,
                                       const std::string &dbMethod,
                                       pbnjson::JValue &query,
                                       void *object,
-                                      SessionHdlType hdlType)
+                                      SessionHdlType hdlType,
+                                      bool foreground)
 {
     // remember token for response - we could do that after the
     // request has been issued because the response will happen
     // from the mainloop in the same thread context
     LOG_DEBUG("Save dbServiceMethod %s, dbMethod %s, token %ld pair", dbServiceMethod.c_str(), dbMethod.c_str(), (long)token);
-    SessionData sd = {dbServiceMethod, dbMethod, query, object};
+    SessionData sd = {dbServiceMethod, dbMethod, query, object, foreground};
     auto p = std::make_pair(token, sd);
     std::lock_guard<std::mutex> lock(lock_);
     messageMap_[hdlType].emplace(p);
@@ -19,6 +19,8 @@
 #include "logging.h"
 #include "performancechecker.h"
 #include "lunaconnector.h"
+#include "writebehindqueue.h"
+#include "jsonparser/replywriter.h"
 #include <luna-service2/lunaservice.h>
 #include <pbnjson.hpp>
 
@@ -28,8 +30,28 @@
 #include <thread>
 #include <map>
 #include <list>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
 
 #define FLUSH_COUNT 100
+/// File to remember the kind definitions registered with the db service.
+#define KIND_HASH_FILE "/media/.cache/mediadb_kinds.json"
+/// Db service error code returned for operations on an unknown kind.
+#define DB_ERR_KIND_NOT_REGISTERED "\"errorCode\":-3970"
+/// Maximum number of operations per replayed batch request.
+#define WRITE_BEHIND_BATCH_SIZE 100
+/// Maximum number of background write requests in flight.
+#define BACKGROUND_WINDOW 2
+/// Maximum time in ms a background write waits for foreground queries.
+#define BACKGROUND_MAX_WAIT 500
+/// Tag of background write requests in the session data.
+#define BACKGROUND_CHANNEL "background"
+/// Number of foreground query latencies kept for statistics.
+#define LATENCY_SAMPLES 512
+/// Foreground query latency p99 is logged with every n-th response.
+#define LATENCY_LOG_INTERVAL 100
 
 enum SessionHdlType {
     HDL_DEFAULT = 0,
@@ -51,6 +73,22 @@ public:
      */
     static void init(LSHandle *lsHandle);
 
+    /**
+     * \brief Notify that the db service is connected.
+     *
+     * Registers the kinds requested so far. Once they are known to the
+     * db service, the queued write requests of all connectors are
+     * replayed and the deferred requests are issued.
+     */
+    static void connected();
+
+    /**
+     * \brief Check if requests are sent to the db service directly.
+     *
+     * \return True once the queued write requests have been replayed.
+     */
+    static bool isReady();
+
 
     virtual void putRespObject(bool returnValue,
                                    pbnjson::JValue & obj,
@@ -58,6 +96,18 @@ public:
                                    const std::string& errorText = "No Error"
                                    );
 
+    /**
+     * \brief Write the reply status members.
+     *
+     * \param[in] returnValue The return value.
+     * \param[in] writer Writer inside of the reply object.
+     * \param[in] errorCode The error code.
+     * \param[in] errorText The error text.
+     */
+    virtual void putRespObject(bool returnValue, ReplyWriter &writer,
+                               const int& errorCode = 0,
+                               const std::string& errorText = "No Error");
+
     virtual bool sendResponse(LSHandle *sender, LSMessage* message,
                            const std::string &object);
 
@@ -72,6 +122,15 @@ protected:
         pbnjson::JValue query;
         /// Some arbitrary object.
         void *object;
+        /// Foreground query, the background writes give way.
+        bool foreground = false;
+        /// Time the request has been sent.
+        std::chrono::steady_clock::time_point sent =
+            std::chrono::steady_clock::now();
+        /// Db service method of a background write request.
+        std::string writeMethod;
+        /// Payload of a background write request.
+        std::string writeRequest;
     };
 
     virtual ~DbConnector();
@@ -183,6 +242,43 @@ protected:
                           std::list<std::string> &kinds, void *obj = nullptr,
                           bool atomic = false, const std::string &forcemethod = "");
 
+    /**
+     * \brief Account for a write request that has been processed.
+     *
+     * Called for write requests which have been queued until the db
+     * service was ready, after the replayed request has been answered.
+     *
+     * \param[in] method Method name the response handler expects.
+     * \param[in] obj Object attached to the write request.
+     */
+    virtual void completeWrite(const std::string &method, void *obj) {}
+
+    /**
+     * \brief Called when the db service lost the kinds.
+     *
+     * The kinds are being registered again, requests deferred with
+     * deferUntilReady() are issued once they are back.
+     */
+    virtual void kindsLost() {}
+
+    /**
+     * \brief Check if a search or del request is a foreground query.
+     *
+     * Background writes give way to foreground queries, requests
+     * issued by the indexer itself should not be foreground.
+     *
+     * \param[in] dbMethod The caller method.
+     * \return True if a client is waiting for the result.
+     */
+    virtual bool isForeground(const std::string &dbMethod) const { return true; }
+
+    /**
+     * \brief Issue a request once the db service is ready.
+     *
+     * \param[in] func The request, called right away if ready.
+     */
+    static void deferUntilReady(std::function<void()> func);
+
     /// Get message id.
     LOG_MSGID;
 
@@ -190,7 +286,15 @@ protected:
     DbConnector(const char *kindId, bool async = false);
     DbConnector();
 
-    /// Ensure database kind.
+    /**
+     * \brief Ensure database kind.
+     *
+     * The putKind request is skipped if the very same kind and index
+     * definition has already been registered successfully, e.g. on a
+     * previous boot.
+     *
+     * \param[in] kind_name kind id, defaults to kindId_.
+     */
     virtual void ensureKind(const std::string &kind_name = "");
 
     /// Should be set from connector class constructor
@@ -232,6 +336,163 @@ private:
     /// Callback for luna responses.
     static bool onLunaResponse(LSHandle *lsHandle, LSMessage *msg, void *ctx);
 
+    /**
+     * \brief Queue a write request if the db service is not ready.
+     *
+     * Blocks the caller while the queue is full, unless called from
+     * the main loop which is needed to get the db service ready.
+     *
+     * \param[in] method Db service method.
+     * \param[in] params The request parameters.
+     * \param[in] obj Object attached to the request.
+     * \param[in] respMethod Method name the response handler expects.
+     * \return True if the request has been queued.
+     */
+    bool deferWrite(const std::string &method, const pbnjson::JValue &params,
+        void *obj, const std::string &respMethod);
+
+    /// Objects of the write requests replayed with one batch.
+    struct ReplayData {
+        /// Response method name and object of each write request.
+        std::list<std::pair<std::string, void *>> writes;
+    };
+
+    /**
+     * \brief Send the queued write requests in batches.
+     *
+     * Must be called with readyLock_ locked.
+     *
+     * \return Batches which could not be sent.
+     */
+    std::list<ReplayData *> replayWrites();
+
+    /**
+     * \brief Send a replayed write request.
+     *
+     * \param[in] method Db service method, batch or mergePut.
+     * \param[in] request The request parameters.
+     * \param[in] data Objects of the replayed write requests.
+     * \return True if sent.
+     */
+    bool sendReplay(const char *method, const pbnjson::JValue &request,
+        ReplayData *data);
+
+    /**
+     * \brief Handle responses of replayed write requests.
+     *
+     * \param[in] msg The luna response.
+     * \return True if msg was a replay response, false else.
+     */
+    bool handleReplayResponse(LSMessage *msg);
+
+    /// Take the session data of a response if it is for method.
+    bool takeSessionData(LSMessageToken token, const std::string &method,
+        SessionData *sd);
+
+    /// Replay the queued writes once connected and kinds are registered.
+    static void checkReady();
+
+    /**
+     * \brief Take a background write slot.
+     *
+     * Waits while foreground queries are pending or the background
+     * window is full, but never longer than BACKGROUND_MAX_WAIT. The
+     * threads dispatching responses never wait.
+     */
+    void acquireBackground();
+
+    /// Release the background write slot of the response, if any.
+    void releaseBackground(LSMessageToken token);
+
+    /// Release a background write slot.
+    static void releaseBackgroundSlot();
+
+    /// Account a foreground query response.
+    void completeForeground(LSMessageToken token);
+
+    /// Background write requests in flight.
+    static int backgroundInFlight_;
+    /// Foreground queries in flight.
+    static int foregroundInFlight_;
+    /// Latest foreground query latencies in ms.
+    static std::vector<int> latencies_;
+    /// Number of foreground query responses.
+    static size_t latencyCount_;
+    /// Protects the channel state above.
+    static std::mutex channelLock_;
+    /// Signaled if a foreground query or background write completes.
+    static std::condition_variable channelCv_;
+
+    /// Write requests queued until the db service is ready.
+    std::unique_ptr<WriteBehindQueue> writeQueue_;
+
+    /// All connectors with a write-behind queue.
+    static std::list<DbConnector *> connectors_;
+    /// Requests deferred until the db service is ready.
+    static std::list<std::function<void()>> deferred_;
+    /// Kind registrations deferred until the db service is connected.
+    static std::list<std::function<void()>> deferredKinds_;
+    /// Number of putKind requests not yet answered.
+    static int kindsInFlight_;
+    /// The db service is connected.
+    static bool connected_;
+    /// The queued write requests have been replayed.
+    static bool ready_;
+    /// Protects the ready state, queues and lists above.
+    static std::mutex readyLock_;
+    /// Signaled once ready.
+    static std::condition_variable readyCv_;
+
+    /// Kind registration bookkeeping attached to putKind requests.
+    struct KindRegistration {
+        /// The kind id.
+        std::string kindId;
+        /// Checksum of the kind definition.
+        std::string hash;
+    };
+
+    /**
+     * \brief Handle putKind responses.
+     *
+     * \param[in] msg The luna response.
+     * \return True if msg was a putKind response, false else.
+     */
+    bool handleKindResponse(LSMessage *msg);
+
+    /**
+     * \brief Send putKind again for kinds skipped on startup.
+     *
+     * Write requests are queued until the kinds have been registered.
+     */
+    void reregisterKinds();
+
+    /**
+     * \brief Queue a background write again that failed because the
+     * kind got lost.
+     *
+     * \param[in] token The response token of the write request.
+     * \return True if the write has been queued and its response
+     *         must not be handled.
+     */
+    bool requeueWrite(LSMessageToken token);
+
+    /// Checksum of a kind definition.
+    static std::string kindHash(const std::string &payload);
+
+    /// Load the registered kind hashes once.
+    static void loadKindHashes();
+
+    /// Persist the registered kind hashes.
+    static void saveKindHashes();
+
+    /// Kind definitions skipped because they were already registered.
+    std::map<std::string, std::string> skippedKinds_;
+
+    /// Registered kind hashes by kind id.
+    static std::map<std::string, std::string> kindHashes_;
+    /// Protects kindHashes_.
+    static std::mutex kindLock_;
+
     /// Callback for luna responses.
     // TODO this response will be merged above callback.
     static bool onLunaResponseMetaData(LSHandle *lsHandle, LSMessage *msg, void *ctx);
@@ -245,5 +506,6 @@ private:
                              const std::string &dbMethod,
                              pbnjson::JValue &query,
                              void *object,
-                             SessionHdlType hdlType = HDL_DEFAULT);
+                             SessionHdlType hdlType = HDL_DEFAULT,
+                             bool foreground = false);
 };
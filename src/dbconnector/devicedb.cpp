@@ -20,6 +20,7 @@
 #include "plugins/plugin.h"
 
 #include <cstdint>
+#include <chrono>
 
 std::unique_ptr<DeviceDb> DeviceDb::instance_;
 
@@ -34,7 +35,13 @@ DeviceDb *DeviceDb::instance()
 
 DeviceDb::~DeviceDb()
 {
-    // nothing to be done here
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exit_ = true;
+    }
+    cv_.notify_one();
+    if (task_.joinable())
+        task_.join();
 }
 
 void DeviceDb::injectKnownDevices(const std::string &uri)
@@ -54,6 +61,18 @@ bool DeviceDb::handleLunaResponse(LSMessage *msg)
     auto dbServiceMethod = sd.dbServiceMethod;
     LOG_INFO(0, "Received response com.webos.mediadb for: '%s'", dbServiceMethod.c_str());
 
+    if (dbServiceMethod == std::string("mergePut") ||
+        dbServiceMethod == std::string("updateDevices")) {
+        pbnjson::JDomParser parser(pbnjson::JSchema::AllSchema());
+        bool ok = parser.parse(LSMessageGetPayload(msg)) &&
+            parser.getDom()["returnValue"].asBool();
+        if (dbServiceMethod == std::string("mergePut") && sd.object)
+            confirmWrite(static_cast<Write *>(sd.object), ok);
+        else if (sd.object)
+            confirmRefreshes(static_cast<std::map<std::string, Snapshot> *>(sd.object), ok);
+        return true;
+    }
+
     if (dbServiceMethod != std::string("find"))
         return true;
 
@@ -126,6 +145,8 @@ DeviceDb::DeviceDb() :
 
         kindIndexes_ << index;
     }
+
+    task_ = std::thread(&DeviceDb::loop, this);
 }
 
 void DeviceDb::deviceStateChanged(std::shared_ptr<Device> device)
@@ -146,15 +167,185 @@ void DeviceDb::deviceModified(std::shared_ptr<Device> device)
 
 void DeviceDb::updateDevice(std::shared_ptr<Device> device)
 {
-    // update or create the device in the database
+    auto uri = device->uri();
+    auto write = new Write;
+    write->uri = uri;
+    auto &current = write->snapshot;
+    current.uuid = device->uuid();
+    current.name = device->meta(Device::Meta::Name);
+    current.description = device->meta(Device::Meta::Description);
+    current.alive = device->alive();
+    current.available = device->available();
+    current.lastSeen = device->lastSeen().time_since_epoch().count();
+
     auto props = pbnjson::Object();
-    props.put("uri", device->uri());
-    props.put("uuid", device->uuid());
-    props.put("name", device->meta(Device::Meta::Name));
-    props.put("description", device->meta(Device::Meta::Description));
-    props.put("alive", device->alive());
-    props.put("available", device->available()); //add device available status
-    props.put("lastSeen", device->lastSeen().time_since_epoch().count());
-
-    mergePut(device->uri(), true, props);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // queued writes might be replayed after others of the device,
+        // only write complete rows until the db confirmed one
+        auto iter = persisted_.find(uri);
+        write->full = iter == persisted_.end() || !isReady();
+        Snapshot last;
+        if (!write->full)
+            last = iter->second;
+
+        bool changed = false;
+        if (write->full || current.uuid != last.uuid) {
+            props.put("uuid", current.uuid);
+            changed = true;
+        }
+        if (write->full || current.name != last.name) {
+            props.put("name", current.name);
+            changed = true;
+        }
+        if (write->full || current.description != last.description) {
+            props.put("description", current.description);
+            changed = true;
+        }
+        if (write->full || current.available != last.available) {
+            props.put("available", current.available);
+            changed = true;
+        }
+
+        if (!changed) {
+            // refreshes only, leave them to the next flush
+            if (current.alive != last.alive || current.lastSeen != last.lastSeen)
+                pending_[uri] = current;
+            delete write;
+            return;
+        }
+
+        // the immediate write also carries the pending refresh
+        props.put("uri", uri);
+        props.put("alive", current.alive);
+        props.put("lastSeen", current.lastSeen);
+        pending_.erase(uri);
+    }
+
+    if (!mergePut(uri, true, props, write))
+        failWrite(write);
+}
+
+void DeviceDb::confirmWrite(Write *write, bool ok)
+{
+    if (!ok) {
+        failWrite(write);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // a partial write only completes a row the db already confirmed
+        if (write->full || persisted_.find(write->uri) != persisted_.end())
+            persisted_[write->uri] = write->snapshot;
+    }
+    delete write;
+}
+
+void DeviceDb::failWrite(Write *write)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        LOG_WARNING(0, "Failed to write device '%s', retry", write->uri.c_str());
+        persisted_.erase(write->uri);
+        retry_.insert(write->uri);
+    }
+    delete write;
+}
+
+void DeviceDb::completeWrite(const std::string &method, void *obj)
+{
+    // replayed writes are not confirmed, the next update of the device
+    // writes the complete row again
+    if (method == std::string("mergePut"))
+        delete static_cast<Write *>(obj);
+    else if (method == std::string("updateDevices"))
+        delete static_cast<std::map<std::string, Snapshot> *>(obj);
+}
+
+void DeviceDb::loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!exit_) {
+        cv_.wait_for(lock, std::chrono::seconds(DEVICEDB_FLUSH_INTERVAL),
+            [this] { return exit_; });
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+void DeviceDb::flush()
+{
+    auto pending = new std::map<std::string, Snapshot>;
+    std::set<std::string> retry;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending->swap(pending_);
+        retry.swap(retry_);
+    }
+
+    // failed writes are written again with the complete row
+    for (const auto &uri : retry) {
+        auto device = Device::device(uri);
+        if (device)
+            updateDevice(device);
+    }
+
+    if (pending->empty()) {
+        delete pending;
+        return;
+    }
+
+    auto operations = pbnjson::Array();
+    for (auto &[uri, snapshot] : *pending) {
+        auto cond = pbnjson::Object();
+        cond.put("prop", "uri");
+        cond.put("op", "=");
+        cond.put("val", uri);
+        auto where = pbnjson::Array();
+        where << cond;
+
+        auto query = pbnjson::Object();
+        query.put("from", kindId_);
+        query.put("where", where);
+
+        auto props = pbnjson::Object();
+        props.put("alive", snapshot.alive);
+        props.put("lastSeen", snapshot.lastSeen);
+
+        auto params = pbnjson::Object();
+        params.put("query", query);
+        params.put("props", props);
+
+        auto operation = pbnjson::Object();
+        operation.put("method", "merge");
+        operation.put("params", params);
+        operations << operation;
+    }
+
+    LOG_DEBUG("Write refreshes of %zu devices", pending->size());
+    if (!batch(operations, "updateDevices", pending))
+        confirmRefreshes(pending, false);
+}
+
+void DeviceDb::confirmRefreshes(std::map<std::string, Snapshot> *refreshes,
+    bool ok)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &[uri, snapshot] : *refreshes) {
+            auto iter = persisted_.find(uri);
+            if (iter == persisted_.end())
+                continue;
+            if (ok) {
+                iter->second.alive = snapshot.alive;
+                iter->second.lastSeen = snapshot.lastSeen;
+            } else {
+                persisted_.erase(iter);
+                retry_.insert(uri);
+            }
+        }
+    }
+    delete refreshes;
 }
@@ -20,6 +20,16 @@
 #include "ideviceobserver.h"
 
 #include <memory>
+#include <string>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/// Interval of the batched alive and lastSeen writes in seconds.
+#define DEVICEDB_FLUSH_INTERVAL 30
 
 /// Connector to com.webos.mediadb.
 class DeviceDb : public DbConnector, public IDeviceObserver
@@ -71,13 +81,69 @@ protected:
     /// DeviceObserver interface.
     void deviceModified(std::shared_ptr<Device> device);
 
+    /// DbConnector interface.
+    void completeWrite(const std::string &method, void *obj) override;
+
+    /// Write the collected alive and lastSeen changes and retry failed
+    /// writes.
+    void flush();
+
 private:
+    /// Device properties as last written to the database.
+    struct Snapshot {
+        std::string uuid;
+        std::string name;
+        std::string description;
+        int alive = 0;
+        bool available = false;
+        int64_t lastSeen = 0;
+    };
+
+    /// A device write waiting for the db response.
+    struct Write {
+        std::string uri;
+        Snapshot snapshot;
+        /// All properties have been written.
+        bool full = false;
+    };
+
     /// Singleton object.
     static std::unique_ptr<DeviceDb> instance_;
     /**
      * \brief Update or create the device in the database.
      *
+     * Only the properties changed since the last write the db
+     * confirmed are written, the complete row until then. Changes of
+     * alive and lastSeen alone are collected and written in one batch
+     * every DEVICEDB_FLUSH_INTERVAL seconds.
+     *
      * \param[in] device Shared pointer for device.
      */
     void updateDevice(std::shared_ptr<Device> device);
+
+    /// Take over the snapshot of a write on success, deletes write.
+    void confirmWrite(Write *write, bool ok);
+
+    /// Forget the snapshot of a failed write and retry, deletes write.
+    void failWrite(Write *write);
+
+    /// Take over the written refreshes on success, deletes refreshes.
+    void confirmRefreshes(std::map<std::string, Snapshot> *refreshes, bool ok);
+
+    /// Flush thread main loop.
+    void loop();
+
+    /// Properties the db confirmed by device uri.
+    std::map<std::string, Snapshot> persisted_;
+    /// Alive and lastSeen changes not yet written by device uri.
+    std::map<std::string, Snapshot> pending_;
+    /// Devices whose last write failed.
+    std::set<std::string> retry_;
+    /// Protects the snapshots and pending changes.
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    /// Flush thread.
+    std::thread task_;
+    /// Set on destruction.
+    bool exit_ = false;
 };
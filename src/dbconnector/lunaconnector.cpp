@@ -195,7 +195,7 @@ bool LunaConnector::sendMessage(const std::string &uri, const std::string &paylo
         }
 
         if (tokenCallback_)
-            tokenCallback_(*msgToken, method, indexerMethod, obj);
+            tokenCallback_(*msgToken, method, indexerMethod, obj, uri, payload);
         return true;
     } else {
         if (!isTaskStarted_) {
@@ -216,7 +216,7 @@ bool LunaConnector::sendMessage(const std::string &uri, const std::string &paylo
                 return false;
             }
             if (tokenCallback_)
-                tokenCallback_(*msgToken, method, indexerMethod, obj);
+                tokenCallback_(*msgToken, method, indexerMethod, obj, uri, payload);
         } else {
             {
                 std::lock_guard<std::mutex> syncLock_(syncCallbackLock_);
@@ -228,7 +228,7 @@ bool LunaConnector::sendMessage(const std::string &uri, const std::string &paylo
                     return false;
                 }
                 if (tokenCallback_)
-                    tokenCallback_(*msgToken, method, indexerMethod, obj);
+                    tokenCallback_(*msgToken, method, indexerMethod, obj, uri, payload);
             }
             if (callbackWrapper.wait(lock_)) {
                 LOG_ERROR(0, "Sync handler timeout!");
@@ -261,6 +261,11 @@ void* LunaConnector::messageThread(void * ctx)
     return NULL;
 }
 
+bool LunaConnector::isLoopThread() const
+{
+    return mainContext_ && g_main_context_is_owner(mainContext_);
+}
+
 void LunaConnector::loopAsync()
 {
     task_ = std::thread(&LunaConnector::messageThread, this);
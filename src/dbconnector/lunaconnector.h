@@ -32,7 +32,8 @@
 #define CONNECTOR_WAIT_TIMEOUT 5
 typedef bool (*LunaConnectorCallback) (LSHandle *hdl, LSMessage *msg, void *ctx);
 typedef std::function<void(LSMessageToken &token, const std::string &dbMethod,
-                           const std::string &indexerMethod, void *obj)> tokenCallback_t;
+                           const std::string &indexerMethod, void *obj,
+                           const std::string &uri, const std::string &payload)> tokenCallback_t;
 typedef std::function<void(LSMessageToken & token, void *obj)> tokenCancelCallback_t;
 
 typedef struct LunaConnectorLunaErr : LSError {
@@ -83,6 +84,9 @@ public:
     bool sendResponse(LSHandle *sender, LSMessage* message,
         const std::string &object);
 
+    /// Check if the caller runs the loop dispatching the responses.
+    bool isLoopThread() const;
+
     static void* messageThread(void *ctx);
 
     void loopAsync();
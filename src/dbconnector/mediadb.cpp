@@ -23,11 +23,17 @@
 #include "mediaindexer.h"
 #include "mediaparser.h"
 #include "performancechecker.h"
+#include "thumbnailquota.h"
+#include "configurator.h"
+#include "reconciler.h"
 
 #include <cstdio>
+#include <algorithm>
+#include <filesystem>
 #include <gio/gio.h>
 #include <cstdint>
 #include <cstring>
+#include <cerrno>
 #include <unistd.h>
 std::unique_ptr<MediaDb> MediaDb::instance_;
 
@@ -67,6 +73,11 @@ bool MediaDb::handleLunaResponse(LSMessage *msg)
     auto method = sd.dbServiceMethod;
     LOG_DEBUG("Received response com.webos.mediadb for: '%s'", method.c_str());
 
+    if (method == std::string("putPermissions-async")) {
+        confirmGrants(msg, static_cast<std::list<std::string> *>(sd.object));
+        return true;
+    }
+
     // handle the media data exists case
     if (method == std::string("find") ||
         method == std::string("putPermissions")) {
@@ -119,36 +130,14 @@ bool MediaDb::handleLunaResponse(LSMessage *msg)
         LOG_DEBUG("search response payload : %s",payload);
     } else if (method == std::string("mergePut")) {
         LOG_DEBUG("method : %s", method.c_str());
-        if (sd.object) {
-            MediaItemPtr mi(static_cast<MediaItem *>(sd.object));
-            DevicePtr device = mi->device();
-            if (device) {
-                device->incrementProcessedItemCount(mi->type());
-                if (device->processingDone()) {
-                    LOG_DEBUG("Activate cleanup task");
-                    device->activateCleanUpTask();
-                }
-            }
-        }
+        completeWrite(method, sd.object);
     } else if (method == std::string("put") || method == std::string("unflagDirty")) {
         LOG_DEBUG("method : %s", method.c_str());
         if (!sd.object) {
             LOG_ERROR(0, "Search should include SessionData");
             return false;
         }
-
-        RespData *resp = static_cast<RespData *>(sd.object);
-        if (resp) {
-            Device *device = resp->dev;
-            if (device) {
-                device->incrementTotalProcessedItemCount(resp->cnt);
-                if (device->processingDone()) {
-                    LOG_DEBUG("Activate cleanup task");
-                    device->activateCleanUpTask();
-                }
-            }
-            delete resp;
-        }
+        completeWrite(method, sd.object);
     } else if (method == std::string("del")) {
         if (!sd.object) {
             LOG_ERROR(0, "Search should include SessionData");
@@ -174,21 +163,53 @@ bool MediaDb::handleLunaResponse(LSMessage *msg)
             LOG_ERROR(0, "Search should include SessionData");
             return false;
         }
+        completeWrite(method, sd.object);
+    }
+    return true;
+}
+
+bool MediaDb::isForeground(const std::string &dbMethod) const
+{
+    // cleaning up dirty items and reconciling is indexer work, no
+    // client waits for it
+    const auto &it = dbMethodMap_.find(dbMethod);
+    return it == dbMethodMap_.end() ||
+        (it->second != MediaDbMethod::RemoveDirty &&
+         it->second != MediaDbMethod::Reconcile);
+}
 
-        RespData *resp = static_cast<RespData *>(sd.object);
-        if (resp) {
-            Device *device = resp->dev;
-            if (device) {
+void MediaDb::completeWrite(const std::string &method, void *obj)
+{
+    if (!obj)
+        return;
+
+    if (method == std::string("mergePut")) {
+        MediaItemPtr mi(static_cast<MediaItem *>(obj));
+        DevicePtr device = mi->device();
+        if (device) {
+            device->incrementProcessedItemCount(mi->type());
+            if (device->processingDone()) {
+                LOG_DEBUG("Activate cleanup task");
+                device->activateCleanUpTask();
+            }
+        }
+    } else if (method == std::string("put") ||
+               method == std::string("unflagDirty") ||
+               method == std::string("flushDeleteItems")) {
+        RespData *resp = static_cast<RespData *>(obj);
+        Device *device = resp->dev;
+        if (device) {
+            if (method == std::string("flushDeleteItems"))
                 device->incrementTotalRemovedItemCount(resp->cnt);
-                if (device->processingDone()) {
-                    LOG_DEBUG("Activate cleanup task");
-                    device->activateCleanUpTask();
-                }
+            else
+                device->incrementTotalProcessedItemCount(resp->cnt);
+            if (device->processingDone()) {
+                LOG_DEBUG("Activate cleanup task");
+                device->activateCleanUpTask();
             }
-            delete resp;
         }
+        delete resp;
     }
-    return true;
 }
 
 //TODO : should be merged including above handler.
@@ -202,20 +223,8 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
         return false;
     }
 
-    pbnjson::JDomParser parser(pbnjson::JSchema::AllSchema());
     const char *payload = LSMessageGetPayload(msg);
 
-    if (!parser.parse(payload)) {
-        LOG_ERROR(0, "Invalid JSON message: %s", payload);
-        return false;
-    }
-
-    pbnjson::JValue domTree(parser.getDom());
-    pbnjson::JValue results;
-    if (domTree.hasKey("results"))
-        results = domTree["results"];
-
-
     auto dbServiceMethod = sd.dbServiceMethod;
     auto dbMethod = sd.dbMethod;
     auto dbQuery = sd.query;
@@ -232,20 +241,51 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
 
     const auto method = it->second;
 
+    // results that are passed through unchanged are copied into the
+    // reply without a DOM
+    bool handled = false;
     bool ret = false;
+    if (method == MediaDbMethod::GetImageList) {
+        ret = sendListReply(dbMethod, "imageList", payload, strlen(payload),
+            dbQuery, object, handled);
+        if (handled)
+            return ret;
+    } else if (method == MediaDbMethod::RequestDelete) {
+        MediaIndexer *indexer = MediaIndexer::instance();
+        ret = indexer->sendMediaMetaDataNotification(dbMethod, payload,
+                static_cast<LSMessage*>(object));
+        if (!ret) {
+            LOG_ERROR(0, "Notification error in RequestDelete!");
+        }
+        return ret;
+    }
+
+    pbnjson::JDomParser parser(pbnjson::JSchema::AllSchema());
+
+    if (!parser.parse(payload)) {
+        LOG_ERROR(0, "Invalid JSON message: %s", payload);
+        return false;
+    }
+
+    pbnjson::JValue domTree(parser.getDom());
+    pbnjson::JValue results;
+    if (domTree.hasKey("results"))
+        results = domTree["results"];
 
     // getAudioList, getVideoList, getImageList are same in switch statement.
     // but it could be changed in the future. so remain it eventhough same thing.
     switch(method) {
     case MediaDbMethod::GetAudioList: {
-        auto response = pbnjson::Object();
-        auto result = pbnjson::Object();
-        result.put("results", results);
-        result.put("count", results.arraySize());
-        response.put("audioList", result);
+        accessThumbnails(results, MediaItem::Type::Audio);
+        ReplyWriter response(dbMethod);
+        response.beginObject().key("audioList").beginObject();
+        response.key("results").value(results);
+        response.key("count").number(results.arraySize());
+        response.endObject();
         putRespObject(true, response);
+        response.endObject();
         MediaIndexer *indexer = MediaIndexer::instance();
-        ret = indexer->sendMediaMetaDataNotification(dbMethod, response.stringify(),
+        ret = indexer->sendMediaMetaDataNotification(dbMethod, response.str(),
                 static_cast<LSMessage*>(object));
 
         if (!ret) {
@@ -267,15 +307,17 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
         break;
     }
     case MediaDbMethod::GetVideoList: {
-        auto response = pbnjson::Object();
-        auto result = pbnjson::Object();
-        result.put("results", results);
-        result.put("count", results.arraySize());
-        response.put("videoList", result);
+        accessThumbnails(results, MediaItem::Type::Video);
+        ReplyWriter response(dbMethod);
+        response.beginObject().key("videoList").beginObject();
+        response.key("results").value(results);
+        response.key("count").number(results.arraySize());
+        response.endObject();
         putRespObject(true, response);
+        response.endObject();
 
         MediaIndexer *indexer = MediaIndexer::instance();
-        ret = indexer->sendMediaMetaDataNotification(dbMethod, response.stringify(),
+        ret = indexer->sendMediaMetaDataNotification(dbMethod, response.str(),
                 static_cast<LSMessage*>(object));
 
         if (!ret) {
@@ -326,6 +368,25 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
         }
         break;
     }
+    case MediaDbMethod::GetMediaList: {
+        auto query = static_cast<MediaListQuery *>(object);
+        const auto &kinds = mediaListKinds();
+        std::string from = dbQuery["from"].asString();
+        size_t kind = 0;
+        while (kind < kinds.size() && kinds[kind].second != from)
+            ++kind;
+        if (kind == kinds.size()) {
+            LOG_ERROR(0, "Unknown media list kind '%s'", from.c_str());
+            break;
+        }
+
+        bool success = domTree["returnValue"].asBool();
+        completeMediaList(query, kind,
+            success ? (results.isArray() ? results : pbnjson::Array()) : pbnjson::JValue(),
+            domTree.hasKey("next"));
+        ret = success;
+        break;
+    }
     case MediaDbMethod::GetAudioMetaData:
     case MediaDbMethod::GetVideoMetaData:
     case MediaDbMethod::GetImageMetaData: {
@@ -343,6 +404,12 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
             break;
         }
 
+        MediaItem::Type type = MediaItem::Type::Video;
+        if (method == MediaDbMethod::GetAudioMetaData)
+            type = MediaItem::Type::Audio;
+        else if (method == MediaDbMethod::GetImageMetaData)
+            type = MediaItem::Type::Image;
+        accessThumbnails(results, type);
         auto uri = metadata["uri"].asString();
         auto mparser = MediaParser::instance();
         if (mparser) {
@@ -365,17 +432,10 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
         }
         break;
     }
-    case MediaDbMethod::RequestDelete: {
-        MediaIndexer *indexer = MediaIndexer::instance();
-        ret = indexer->sendMediaMetaDataNotification(dbMethod, domTree.stringify(),
-                static_cast<LSMessage*>(object));
-        if (!ret) {
-            LOG_ERROR(0, "Notification error in RequestDelete!");
-        }
-        break;
-    }
     case MediaDbMethod::RemoveDirty: {
         if (results.isArray() && results.isValid() && !results.isNull()) {
+            // the deletes are background writes, send them in batches
+            auto operations = pbnjson::Array();
             for (auto item : results.items()) {
                 auto uri = item["uri"].asString();
                 auto thumbnail = item["thumbnail"].asString();
@@ -387,12 +447,15 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
                     auto query = pbnjson::Object();
                     query.put("from", kind);
                     query.put("where", where);
-                    ret = del(query, dbMethod);
-
-                    if (!ret)
-                        LOG_ERROR(0, "ERROR deleting mediaDB uri : [%s]",
-                                uri.c_str());
-
+                    auto param = pbnjson::Object();
+                    param.put("query", query);
+                    prepareOperation("del", param, operations);
+
+                    if (operations.arraySize() >= FLUSH_COUNT) {
+                        if (!batch(operations, dbMethod))
+                            LOG_ERROR(0, "ERROR deleting dirty mediaDB items");
+                        operations = pbnjson::Array();
+                    }
                 }
 
                 if (!thumbnail.empty()) {
@@ -401,15 +464,25 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
                     if (remove_ret != 0)
                         LOG_ERROR(0, "Error deleting thumbnail file : [%s]",
                                 thumbnail.c_str());
-
-                    sync();
+                    ThumbnailQuota::instance()->remove(thumbnail);
                 }
 
             }
+            if (operations.arraySize() > 0 && !batch(operations, dbMethod))
+                LOG_ERROR(0, "ERROR deleting dirty mediaDB items");
         }
         ret = true;
         break;
     }
+    case MediaDbMethod::Reconcile: {
+        bool ok = domTree.hasKey("returnValue") && domTree["returnValue"].asBool();
+        std::string next;
+        if (domTree.hasKey("next"))
+            next = domTree["next"].asString();
+        Reconciler::instance()->onDbResponse(object, ok, results, next);
+        ret = true;
+        break;
+    }
     default: {
         LOG_ERROR(0, "Unknown db method[%s]", dbMethod.c_str());
         ret = false;
@@ -442,6 +515,13 @@ bool MediaDb::needUpdate(MediaItem *mediaItem)
         LOG_ERROR(0, "Invalid input");
         return false;
     }
+    // without the db we cannot tell, the written meta data is merged
+    // with what the db has once it is ready
+    if (!isReady()) {
+        LOG_DEBUG("Db not ready, '%s' needs meta data", mediaItem->uri().c_str());
+        return true;
+    }
+
     pbnjson::JValue resp = pbnjson::Object();
     std::string kind = "";
     if (mediaItem->type() != MediaItem::Type::EOL)
@@ -753,7 +833,16 @@ bool MediaDb::resetReScanTempBuf(const std::string &uri)
 void MediaDb::removeDirty(Device* device)
 {
     std::string uri = device->uri();
+    if (!isReady()) {
+        // the dirty flags are still queued for the db
+        deferUntilReady([this, uri] { removeDirty(uri); });
+        return;
+    }
+    removeDirty(uri);
+}
 
+void MediaDb::removeDirty(const std::string &uri)
+{
     auto selectArray = pbnjson::Array();
     selectArray.append(MediaItem::metaToString(MediaItem::CommonType::KIND));
     selectArray.append(MediaItem::metaToString(MediaItem::CommonType::URI));
@@ -779,23 +868,166 @@ void MediaDb::removeDirty(Device* device)
 
 void MediaDb::grantAccess(const std::string &serviceName)
 {
+    {
+        std::lock_guard<std::mutex> lk(clientsLock_);
+        if (dbClients_.find(serviceName) != dbClients_.end())
+            return;
+    }
     LOG_INFO(0, "Add read-only access to media db for '%s'",
         serviceName.c_str());
-    dbClients_.push_back(serviceName);
-    roAccess(dbClients_);
+    std::list<std::string> services = {serviceName};
+    roAccess(services);
 }
 
 void MediaDb::grantAccessAll(const std::string &serviceName, bool atomic,
                                 pbnjson::JValue &resp,  const std::string &methodName)
 {
+    std::list<std::string> kindList_ = {AUDIO_KIND, VIDEO_KIND, IMAGE_KIND};
+    {
+        std::lock_guard<std::mutex> lk(clientsLock_);
+        if (dbClients_.find(serviceName) != dbClients_.end()) {
+            LOG_DEBUG("Access to media db already granted for '%s'",
+                serviceName.c_str());
+            putRespObject(true, resp);
+            return;
+        }
+    }
+
+    // permissions refer to the kinds, nobody waits for the result so
+    // grant them once the kinds are registered
+    if (!atomic && !isReady()) {
+        deferUntilReady([this, serviceName, methodName] {
+            auto reply = pbnjson::Object();
+            grantAccessAll(serviceName, false, reply, methodName);
+        });
+        return;
+    }
+
     LOG_INFO(0, "Add read-only access to media db for '%s'",
         serviceName.c_str());
-    dbClients_.push_back(serviceName);
+    std::list<std::string> services = {serviceName};
+    if (!atomic) {
+        auto pending = new std::list<std::string>(services);
+        if (!roAccess(services, kindList_, pending, atomic, methodName)) {
+            LOG_ERROR(0, "Failed to grant media db access for '%s'",
+                serviceName.c_str());
+            delete pending;
+        }
+        return;
+    }
+
+    bool ret = roAccess(services, kindList_, &resp, atomic, methodName) &&
+        resp["returnValue"].asBool();
+    if (!ret) {
+        LOG_ERROR(0, "Failed to grant media db access for '%s'", serviceName.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lk(clientsLock_);
+    dbClients_.insert(serviceName);
+    restoredClients_.erase(serviceName);
+    saveGrantedClients();
+}
+
+void MediaDb::regrantClients()
+{
+    std::list<std::string> services;
+    {
+        std::lock_guard<std::mutex> lk(clientsLock_);
+        services.assign(restoredClients_.begin(), restoredClients_.end());
+    }
+    if (services.empty())
+        return;
+
+    LOG_INFO(0, "Grant media db access again for %zu services", services.size());
     std::list<std::string> kindList_ = {AUDIO_KIND, VIDEO_KIND, IMAGE_KIND};
-    if (atomic)
-        roAccess(dbClients_, kindList_, &resp, atomic, methodName);
-    else
-        roAccess(dbClients_, kindList_, nullptr, atomic, methodName);
+    auto pending = new std::list<std::string>(services);
+    if (!roAccess(services, kindList_, pending, false, "putPermissions-async")) {
+        LOG_ERROR(0, "Failed to grant media db access again");
+        delete pending;
+    }
+}
+
+void MediaDb::confirmGrants(LSMessage *msg, std::list<std::string> *services)
+{
+    if (!services)
+        return;
+
+    pbnjson::JDomParser parser(pbnjson::JSchema::AllSchema());
+    const char *payload = LSMessageGetPayload(msg);
+    if (!parser.parse(payload) || !parser.getDom()["returnValue"].asBool()) {
+        LOG_ERROR(0, "Failed to grant media db access : %s", payload);
+        delete services;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lk(clientsLock_);
+    for (const auto &service : *services) {
+        dbClients_.insert(service);
+        restoredClients_.erase(service);
+    }
+    saveGrantedClients();
+    delete services;
+}
+
+void MediaDb::kindsLost()
+{
+    // the grants are gone along with the kinds
+    {
+        std::lock_guard<std::mutex> lk(clientsLock_);
+        restoredClients_.insert(dbClients_.begin(), dbClients_.end());
+        dbClients_.clear();
+    }
+    deferUntilReady([this] { regrantClients(); });
+}
+
+void MediaDb::loadGrantedClients()
+{
+    auto root = pbnjson::JDomParser::fromFile(GRANTED_CLIENTS_FILE);
+    if (!root.isArray()) {
+        LOG_DEBUG("No granted clients stored in '%s'", GRANTED_CLIENTS_FILE);
+        return;
+    }
+
+    // answered from the cache only once the database confirmed them
+    std::lock_guard<std::mutex> lk(clientsLock_);
+    for (int idx = 0; idx < root.arraySize(); idx++) {
+        auto service = root[idx].asString();
+        if (!service.empty())
+            restoredClients_.insert(service);
+    }
+    LOG_INFO(0, "Restored %zu granted media db clients", restoredClients_.size());
+}
+
+void MediaDb::saveGrantedClients() const
+{
+    // unconfirmed grants have been confirmed in a previous run, keep
+    // them
+    auto clients = pbnjson::Array();
+    for (const auto &service : dbClients_)
+        clients.append(service);
+    for (const auto &service : restoredClients_)
+        clients.append(service);
+
+    // write to a temporary file first so a crash never leaves a
+    // truncated list behind
+    std::error_code err;
+    std::filesystem::create_directories(
+        std::filesystem::path(GRANTED_CLIENTS_FILE).parent_path(), err);
+    std::string tmpFile = std::string(GRANTED_CLIENTS_FILE) + ".tmp";
+    FILE *fp = fopen(tmpFile.c_str(), "w");
+    if (!fp) {
+        LOG_WARNING(0, "Failed to open '%s', caused by : %s", tmpFile.c_str(),
+            strerror(errno));
+        return;
+    }
+    auto payload = clients.stringify();
+    bool ok = fwrite(payload.c_str(), 1, payload.size(), fp) == payload.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmpFile.c_str(), GRANTED_CLIENTS_FILE) < 0) {
+        LOG_WARNING(0, "Failed to save granted media db clients");
+        unlink(tmpFile.c_str());
+    }
 }
 
 bool MediaDb::getAudioList(const std::string &uri, int count, LSMessage *msg, bool expand)
@@ -903,6 +1135,388 @@ bool MediaDb::getImageList(const std::string &uri, int count, LSMessage *msg, bo
     return search(query, dbMethod, msg);
 }
 
+void MediaDb::accessThumbnails(pbnjson::JValue &results, MediaItem::Type type,
+    const std::string &variant)
+{
+    if (!results.isArray())
+        return;
+
+    auto configurator = Configurator::instance();
+    auto quota = ThumbnailQuota::instance();
+    auto thumbnail = MediaItem::metaToString(MediaItem::Meta::Thumbnail);
+    for (ssize_t i = 0; i < results.arraySize(); ++i) {
+        auto item = results[i];
+        if (!item.hasKey(thumbnail) || !item.hasKey(URI))
+            continue;
+        auto path = item[thumbnail].asString();
+        if (path.empty())
+            continue;
+
+        // merged lists carry the media type of each item
+        auto itemType = type;
+        if (itemType == MediaItem::Type::EOL && item.hasKey("type")) {
+            auto typeString = item["type"].asString();
+            for (auto t = MediaItem::Type::Audio; t < MediaItem::Type::EOL; ++t) {
+                if (MediaItem::mediaTypeToString(t) == typeString)
+                    itemType = t;
+            }
+        }
+
+        auto uri = item[URI].asString();
+        auto ext = uri.substr(uri.find_last_of('.') + 1);
+        bool evicted = quota->access(path);
+        if (evicted) {
+            // art of remote devices was fetched once and can not be
+            // created again, forget it instead of keeping a dangling path
+            auto filepath = getFilePath(uri);
+            bool local = filepath && !filepath->empty() && filepath->front() == '/';
+            if (!local || !MediaParser::canExtractThumbnail(itemType, ext)) {
+                LOG_INFO(0, "Evicted thumbnail of '%s' can not be regenerated", uri.c_str());
+                auto props = pbnjson::Object();
+                props.put(thumbnail, std::string());
+                if (itemType != MediaItem::Type::EOL)
+                    merge(kindMap_[itemType], props, URI, uri);
+                item.put(thumbnail, std::string());
+                continue;
+            }
+        }
+
+        bool missingVariant = false;
+        if (!variant.empty()) {
+            auto variantPath = configurator->thumbnailVariantPath(path, variant);
+            if (variantPath.empty()) {
+                LOG_DEBUG("Unknown thumbnail variant '%s'", variant.c_str());
+            } else if (variantPath != path) {
+                std::error_code err;
+                if (std::filesystem::exists(variantPath, err)) {
+                    missingVariant = quota->access(variantPath);
+                    item.put(thumbnail, variantPath);
+                } else {
+                    missingVariant = true;
+                }
+            }
+        }
+
+        // other extractors can not create the variant, the default
+        // thumbnail stays in the reply
+        if (evicted || (missingVariant && MediaParser::hasThumbnailVariants(itemType, ext)))
+            MediaParser::regenerateThumbnail(uri);
+    }
+}
+
+const std::vector<std::pair<std::string, std::string>> &MediaDb::mediaListKinds()
+{
+    static const std::vector<std::pair<std::string, std::string>> kinds = {
+        { "audio", AUDIO_KIND },
+        { "video", VIDEO_KIND },
+        { "image", IMAGE_KIND }
+    };
+    return kinds;
+}
+
+// compare two sort keys, numbers numerically, everything else as string
+static int compareMediaListKey(const pbnjson::JValue &a, const pbnjson::JValue &b)
+{
+    if (a.isNumber() && b.isNumber()) {
+        double x = a.asNumber<double>();
+        double y = b.asNumber<double>();
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+    std::string x = a.isString() ? a.asString() : a.stringify();
+    std::string y = b.isString() ? b.asString() : b.stringify();
+    return x.compare(y);
+}
+
+bool MediaDb::decodeMediaListPage(const std::string &page,
+    MediaListQuery *query) const
+{
+    gsize len = 0;
+    guchar *data = g_base64_decode(page.c_str(), &len);
+    std::string cursor(reinterpret_cast<char *>(data), len);
+    g_free(data);
+
+    pbnjson::JDomParser parser(pbnjson::JSchema::AllSchema());
+    if (!parser.parse(cursor)) {
+        LOG_ERROR(0, "Invalid media list page '%s'", page.c_str());
+        return false;
+    }
+
+    auto dom = parser.getDom();
+    if (!dom.hasKey("key") || !dom.hasKey("uri") || !dom.hasKey("order")) {
+        LOG_ERROR(0, "Incomplete media list page '%s'", page.c_str());
+        return false;
+    }
+
+    // the cursor only continues the list it was created for
+    if (dom["order"].asString() != query->orderBy ||
+        dom["desc"].asBool() != query->desc) {
+        LOG_ERROR(0, "Media list page of different sort order");
+        return false;
+    }
+
+    query->lastKey = dom["key"];
+    query->lastUri = dom["uri"].asString();
+
+    return true;
+}
+
+std::string MediaDb::encodeMediaListPage(const MediaListQuery *query) const
+{
+    auto cursor = pbnjson::Object();
+    cursor.put("order", query->orderBy);
+    cursor.put("desc", query->desc);
+    cursor.put("key", query->lastKey);
+    cursor.put("uri", query->lastUri);
+
+    std::string str = cursor.stringify();
+    gchar *page = g_base64_encode(reinterpret_cast<const guchar *>(str.c_str()),
+        str.size());
+    std::string ret(page);
+    g_free(page);
+    return ret;
+}
+
+bool MediaDb::getMediaList(const std::string &uri, int count,
+    const std::string &orderBy, bool desc, const std::string &page,
+    const std::string &variant, LSMessage *msg)
+{
+    LOG_DEBUG("%s Start for uri : %s, count : %d, orderBy : %s", __func__,
+        uri.c_str(), count, orderBy.c_str());
+
+    if (orderBy != URI && orderBy != FILE_PATH &&
+        orderBy != MediaItem::metaToString(MediaItem::Meta::LastModifiedDate)) {
+        LOG_ERROR(0, "Invalid media list order '%s'", orderBy.c_str());
+        return false;
+    }
+    // the formatted date sorts by weekday name, use the raw one
+    std::string sortKey = orderBy;
+    if (orderBy == MediaItem::metaToString(MediaItem::Meta::LastModifiedDate))
+        sortKey = MediaItem::metaToString(MediaItem::Meta::LastModifiedDateRaw);
+
+    const auto &kinds = mediaListKinds();
+    auto query = new MediaListQuery;
+    query->msg = msg;
+    query->count = count ? count : MEDIA_LIST_MAX_COUNT;
+    query->variant = variant;
+    query->orderBy = sortKey;
+    query->desc = desc;
+    query->results.assign(kinds.size(), pbnjson::Array());
+    query->more.assign(kinds.size(), false);
+
+    if (!page.empty() && !decodeMediaListPage(page, query)) {
+        delete query;
+        return false;
+    }
+
+    auto selectArray = pbnjson::Array();
+    selectArray.append(MediaItem::metaToString(MediaItem::CommonType::URI));
+    selectArray.append(MediaItem::metaToString(MediaItem::CommonType::FILEPATH));
+    selectArray.append(MediaItem::metaToString(MediaItem::Meta::Title));
+    selectArray.append(MediaItem::metaToString(MediaItem::Meta::LastModifiedDate));
+    selectArray.append(MediaItem::metaToString(MediaItem::Meta::LastModifiedDateRaw));
+    selectArray.append(MediaItem::metaToString(MediaItem::Meta::FileSize));
+    selectArray.append(MediaItem::metaToString(MediaItem::Meta::Duration));
+    selectArray.append(MediaItem::metaToString(MediaItem::Meta::Thumbnail));
+
+    // the db service has no OR, a page behind the cursor consists of
+    // the items with the last sort key behind the last uri and the
+    // items behind the last sort key, the indexes order equal sort
+    // keys by uri
+    auto condition = [](const std::string &prop, const char *op,
+                        const pbnjson::JValue &val, pbnjson::JValue &wheres) {
+        auto cond = pbnjson::Object();
+        cond.put("prop", prop);
+        cond.put("op", op);
+        cond.put("val", val);
+        wheres << cond;
+    };
+    std::vector<std::pair<pbnjson::JValue, std::string>> searches;
+    auto wheres = pbnjson::Array();
+    prepareWhere(DIRTY, false, true, wheres);
+    if (query->lastKey.isNull()) {
+        searches.emplace_back(wheres, sortKey);
+    } else {
+        if (sortKey != URI) {
+            auto ties = wheres.duplicate();
+            condition(sortKey, "=", query->lastKey, ties);
+            condition(URI, desc ? "<" : ">", query->lastUri, ties);
+            searches.emplace_back(ties, URI);
+        }
+        condition(sortKey, desc ? "<" : ">", query->lastKey, wheres);
+        searches.emplace_back(wheres, sortKey);
+    }
+
+    // the sort key range is the indexed condition, so the uri prefix
+    // has to go to the filter
+    auto filter = pbnjson::Array();
+    if (!uri.empty())
+        prepareWhere(URI, uri, false, filter);
+
+    // each search has to deliver a full page, the merge picks the page
+    // from them
+    query->pending = kinds.size() * searches.size();
+    for (size_t i = 0; i < kinds.size(); ++i) {
+        for (const auto &part : searches) {
+            auto kindQuery = pbnjson::Object();
+            kindQuery.put("select", selectArray.duplicate());
+            kindQuery.put("from", kinds[i].second);
+            kindQuery.put("where", part.first.duplicate());
+            if (!uri.empty())
+                kindQuery.put("filter", filter.duplicate());
+            kindQuery.put("orderBy", part.second);
+            kindQuery.put("desc", desc);
+            kindQuery.put("limit", std::min(query->count, MEDIA_LIST_MAX_COUNT));
+
+            if (!search(kindQuery, "getMediaList", query)) {
+                LOG_ERROR(0, "Media list search error for '%s'",
+                    kinds[i].second.c_str());
+                // the last failed search may already release the query
+                completeMediaList(query, i, pbnjson::JValue(), false);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool MediaDb::sendListReply(const std::string &dbMethod, const char *listKey,
+    const char *payload, size_t payloadSize, pbnjson::JValue &dbQuery,
+    void *object, bool &handled)
+{
+    const char *results = nullptr;
+    size_t size = 0;
+    handled = false;
+    if (!ReplyWriter::findMember(payload, payloadSize, "results", &results, &size))
+        return false;
+    int64_t count = ReplyWriter::arraySize(results, size);
+    if (count < 0)
+        return false;
+
+    // the page is only needed for subscriptions, escaped pages are rare
+    // enough to leave them to the parser
+    std::string page;
+    const char *next = nullptr;
+    size_t nextSize = 0;
+    bool hasNext = ReplyWriter::findMember(payload, payloadSize, "next", &next,
+        &nextSize);
+    if (hasNext && object == nullptr) {
+        if (nextSize >= 2 && next[0] == '"' && !memchr(next, '\\', nextSize)) {
+            page.assign(next + 1, nextSize - 2);
+        } else {
+            pbnjson::JDomParser parser(pbnjson::JSchema::AllSchema());
+            if (!parser.parse(std::string(payload, payloadSize)))
+                return false;
+            page = parser.getDom()["next"].asString();
+        }
+    }
+    handled = true;
+
+    ReplyWriter response(dbMethod);
+    response.beginObject().key(listKey).beginObject();
+    response.key("results").raw(results, size);
+    response.key("count").number(count);
+    response.endObject();
+    putRespObject(true, response);
+    response.endObject();
+
+    MediaIndexer *indexer = MediaIndexer::instance();
+    if (!indexer->sendMediaMetaDataNotification(dbMethod, response.str(),
+            static_cast<LSMessage *>(object))) {
+        LOG_ERROR(0, "Notification error in %s!", dbMethod.c_str());
+        return false;
+    }
+
+    // again send search command if payload has "next" key.
+    // object null means subscription
+    if (hasNext && object == nullptr) {
+        dbQuery.put("page", page);
+        if (!search(dbQuery, dbMethod, object)) {
+            LOG_ERROR(0, "Search error!");
+            return false;
+        }
+    }
+    return true;
+}
+
+void MediaDb::completeMediaList(MediaListQuery *query, size_t kind,
+    const pbnjson::JValue &results, bool more)
+{
+    const auto &kinds = mediaListKinds();
+
+    // a kind is searched once per part of the page
+    if (!results.isArray()) {
+        query->results[kind] = pbnjson::JValue();
+    } else if (query->results[kind].isArray()) {
+        for (ssize_t i = 0; i < results.arraySize(); ++i) {
+            auto item = results[i];
+            item.put("type", kinds[kind].first);
+            query->results[kind] << item;
+        }
+        query->more[kind] = query->more[kind] || more;
+    }
+
+    // responses arrive on the service main loop, no locking needed
+    if (--query->pending > 0)
+        return;
+
+    // merge, equal sort keys are ordered by uri like in the indexes
+    std::vector<pbnjson::JValue> merged;
+    bool ok = true;
+    for (size_t k = 0; k < kinds.size(); ++k) {
+        if (!query->results[k].isArray()) {
+            ok = false;
+            continue;
+        }
+        for (ssize_t i = 0; i < query->results[k].arraySize(); ++i)
+            merged.push_back(query->results[k][i]);
+    }
+
+    const auto &orderBy = query->orderBy;
+    bool desc = query->desc;
+    std::sort(merged.begin(), merged.end(),
+        [&orderBy, desc](const pbnjson::JValue &a, const pbnjson::JValue &b) {
+            int cmp = compareMediaListKey(a[orderBy], b[orderBy]);
+            if (cmp == 0)
+                cmp = a[URI].asString().compare(b[URI].asString());
+            return desc ? cmp > 0 : cmp < 0;
+        });
+
+    size_t count = std::min(merged.size(), static_cast<size_t>(query->count));
+    bool hasMore = merged.size() > count;
+    for (auto m : query->more)
+        hasMore = hasMore || m;
+
+    auto list = pbnjson::Array();
+    for (size_t i = 0; i < count; ++i)
+        list << merged[i];
+    accessThumbnails(list, MediaItem::Type::EOL, query->variant);
+
+    auto result = pbnjson::Object();
+    result.put("results", list);
+    result.put("count", static_cast<int32_t>(count));
+
+    if (hasMore && count > 0) {
+        query->lastKey = merged[count - 1][orderBy];
+        query->lastUri = merged[count - 1][URI].asString();
+        result.put("next", encodeMediaListPage(query));
+    }
+
+    ReplyWriter response("getMediaList");
+    response.beginObject().key("mediaList").value(result);
+    if (ok)
+        putRespObject(true, response);
+    else
+        putRespObject(false, response, -1, "Media list search error");
+    response.endObject();
+
+    MediaIndexer *indexer = MediaIndexer::instance();
+    if (!indexer->sendMediaMetaDataNotification("getMediaList",
+            response.str(), query->msg))
+        LOG_ERROR(0, "Notification error in GetMediaList!");
+
+    delete query;
+}
+
 bool MediaDb::requestDelete(const std::string &uri, LSMessage *msg)
 {
     LOG_DEBUG("%s Start for uri : %s", __func__, uri.c_str());
@@ -916,6 +1530,63 @@ bool MediaDb::requestDelete(const std::string &uri, LSMessage *msg)
     return del(query, dbMethod, msg);
 }
 
+bool MediaDb::searchDeviceItems(MediaItem::Type type, const std::string &uri,
+    const std::string &page, void *obj)
+{
+    auto kind = kindMap_.find(type);
+    if (kind == kindMap_.end())
+        return false;
+
+    auto selectArray = pbnjson::Array();
+    selectArray.append(MediaItem::metaToString(MediaItem::CommonType::URI));
+    selectArray.append(MediaItem::metaToString(MediaItem::CommonType::FILEPATH));
+    selectArray.append(MediaItem::metaToString(MediaItem::CommonType::DIRTY));
+    selectArray.append(MediaItem::metaToString(MediaItem::Meta::Thumbnail));
+
+    auto where = pbnjson::Array();
+    prepareWhere(URI, uri, false, where);
+
+    auto query = pbnjson::Object();
+    query.put("from", kind->second);
+    query.put("select", selectArray);
+    query.put("where", where);
+    query.put("limit", RECONCILE_BATCH_SIZE);
+    if (!page.empty())
+        query.put("page", page);
+
+    std::string dbMethod = std::string("reconcile");
+    return search(query, dbMethod, obj);
+}
+
+bool MediaDb::deleteItems(MediaItem::Type type, const std::list<std::string> &uris)
+{
+    auto kind = kindMap_.find(type);
+    if (kind == kindMap_.end())
+        return false;
+
+    auto operations = pbnjson::Array();
+    for (const auto &uri : uris) {
+        auto where = pbnjson::Array();
+        prepareWhere(URI, uri, true, where);
+        auto query = pbnjson::Object();
+        query.put("from", kind->second);
+        query.put("where", where);
+        auto param = pbnjson::Object();
+        param.put("query", query);
+        prepareOperation("del", param, operations);
+    }
+
+    if (operations.arraySize() == 0)
+        return true;
+
+    std::string dbMethod = std::string("reconcileDelete");
+    if (!batch(operations, dbMethod)) {
+        LOG_ERROR(0, "ERROR deleting orphaned mediaDB items");
+        return false;
+    }
+    return true;
+}
+
 MediaItem::Type MediaDb::guessType(const std::string &uri)
 {
     LOG_DEBUG("%s Start for uri : %s", __FUNCTION__, uri.c_str());
@@ -995,7 +1666,8 @@ MediaDb::MediaDb() :
     DbConnector("com.webos.service.mediaindexer.media", true)
 {
     std::list<std::list<std::string>> indexList = {
-        {URI}, {DIRTY}, {DIRTY, URI}
+        {URI}, {DIRTY}, {DIRTY, URI}, {DIRTY, FILE_PATH, URI},
+        {DIRTY, MediaItem::metaToString(MediaItem::Meta::LastModifiedDateRaw), URI}
     };
 
     int i = 1;
@@ -1013,4 +1685,7 @@ MediaDb::MediaDb() :
         index.put("props", props);
         kindIndexes_ << index;
     }
+
+    loadGrantedClients();
+    deferUntilReady([this] { regrantClients(); });
 }
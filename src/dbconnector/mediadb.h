@@ -22,6 +22,13 @@
 #include <memory>
 #include <mutex>
 #include <list>
+#include <set>
+#include <vector>
+
+/// Services granted access to the media kinds, kept across restarts.
+#define GRANTED_CLIENTS_FILE "/media/.cache/mediadb_clients.json"
+/// Upper limit of records the db service returns for one search.
+#define MEDIA_LIST_MAX_COUNT 500
 
 class Device;
 
@@ -40,6 +47,8 @@ public:
         GetImageMetaData,
         RequestDelete,
         RemoveDirty,
+        GetMediaList,
+        Reconcile,
         EOL
     };
 
@@ -67,6 +76,22 @@ public:
      */
     virtual bool handleLunaResponseMetaData(LSMessage *msg);
 
+    /**
+     * \brief Update the device processing state for a finished write.
+     *
+     * \param[in] method Method name of the write request.
+     * \param[in] obj Object attached to the write request.
+     */
+    virtual void completeWrite(const std::string &method, void *obj);
+
+    /**
+     * \brief Check if a search or del request is a foreground query.
+     *
+     * \param[in] dbMethod The caller method.
+     * \return False for the dirty item cleanup, true else.
+     */
+    virtual bool isForeground(const std::string &dbMethod) const;
+
     /**
      * \brief Check media item hash fpr change.
      *
@@ -132,6 +157,19 @@ public:
      */
     void grantAccess(const std::string &serviceName);
 
+    /**
+     * \brief Grant access to all media kinds for the service.
+     *
+     * Services whose grant the database confirmed in this run are
+     * answered right away without a call to the database, else the
+     * grant is sent for the new service. A grant is persisted once the
+     * database confirmed it.
+     *
+     * \param[in] serviceName The service name.
+     * \param[in] atomic Wait for the database response.
+     * \param[out] resp The response object if atomic.
+     * \param[in] methodName Method name to be used for the response.
+     */
     void grantAccessAll(const std::string &serviceName, bool atomic, pbnjson::JValue &resp, const std::string &methodName = std::string());
 
     bool getAudioList(const std::string &uri, int count, LSMessage *msg = nullptr, bool expand = false);
@@ -140,6 +178,32 @@ public:
 
     bool getImageList(const std::string &uri, int count, LSMessage *msg = nullptr, bool expand = false);
 
+    /**
+     * \brief Get audio, video and image items in one sorted list.
+     *
+     * The three media kinds are searched concurrently and the results
+     * are merged by the sort key once all of them have arrived. Items
+     * with equal sort keys are ordered by uri, the returned cursor
+     * continues the merged list behind the sort key and uri of the last
+     * item of this page.
+     *
+     * \param[in] uri Uri prefix of the items, empty for all items.
+     * \param[in] count Maximum number of items in the reply.
+     * \param[in] orderBy Sort key, one of uri, file_path or
+     *            last_modified_date, which sorts by the modification
+     *            time.
+     * \param[in] desc Sort in descending order.
+     * \param[in] page Cursor from a previous reply, empty for the first
+     *            page.
+     * \param[in] variant Thumbnail variant of the items, empty for the
+     *            default thumbnail.
+     * \param[in] msg The Luna message to respond to.
+     * \return False if the request parameters are invalid.
+     */
+    bool getMediaList(const std::string &uri, int count,
+        const std::string &orderBy, bool desc, const std::string &page,
+        const std::string &variant, LSMessage *msg);
+
     void makeUriIndex();
 
     /**
@@ -150,6 +214,30 @@ public:
      */
     bool requestDelete(const std::string &uri, LSMessage *msg = nullptr);
 
+    /**
+     * \brief Search one page of the items of a device for the reconciler.
+     *
+     * The response is handed to Reconciler::onDbResponse().
+     *
+     * \param[in] type Media type of the items.
+     * \param[in] uri The device uri.
+     * \param[in] page Page key of a previous response, empty for the
+     *            first page.
+     * \param[in] obj Context handed back with the response.
+     * \return True if the search has been sent.
+     */
+    bool searchDeviceItems(MediaItem::Type type, const std::string &uri,
+        const std::string &page, void *obj);
+
+    /**
+     * \brief Delete items of the given uris in one batch.
+     *
+     * \param[in] type Media type of the items.
+     * \param[in] uris Uris of the items.
+     * \return True if the batch has been sent.
+     */
+    bool deleteItems(MediaItem::Type type, const std::list<std::string> &uris);
+
     /**
      * \brief guess media type with uri.
      *
@@ -223,6 +311,114 @@ private:
                       bool precise,
                       pbnjson::JValue &whereClause) const;
 
+    /// Remove all dirty flagged items with the given device uri.
+    void removeDirty(const std::string &uri);
+
+    /**
+     * \brief Prepare the thumbnails of query results for the reply.
+     *
+     * Marks the thumbnails as used and regenerates evicted ones. Evicted
+     * thumbnails that can not be generated from the media file again,
+     * like downloaded art, are cleared in the database and the reply.
+     * With a variant the thumbnail path is replaced by the variant file,
+     * the default thumbnail stays in the reply until the variant exists.
+     * Only media types with thumbnail variants create missing variants.
+     *
+     * \param[in,out] results The query results.
+     * \param[in] type Media type of the results, EOL to take it from
+     *            the type field of each item.
+     * \param[in] variant The requested thumbnail variant, empty for the
+     *            default thumbnail.
+     */
+    void accessThumbnails(pbnjson::JValue &results, MediaItem::Type type,
+        const std::string &variant = std::string());
+
+    /// Merged search of all media kinds for getMediaList.
+    struct MediaListQuery {
+        /// The Luna message to respond to.
+        LSMessage *msg;
+        /// Maximum number of items in the reply.
+        int count;
+        /// Requested thumbnail variant.
+        std::string variant;
+        /// Sort key.
+        std::string orderBy;
+        /// Sort in descending order.
+        bool desc;
+        /// Sort key of the last item of the previous page.
+        pbnjson::JValue lastKey;
+        /// Uri of the last item of the previous page.
+        std::string lastUri;
+        /// Search results per kind, null if a search failed.
+        std::vector<pbnjson::JValue> results;
+        /// Kinds with further items beyond the search limit.
+        std::vector<bool> more;
+        /// Searches not answered yet.
+        int pending;
+    };
+
+    /// Media kinds of getMediaList in the order of equal sort keys.
+    static const std::vector<std::pair<std::string, std::string>> &mediaListKinds();
+
+    /// Restore the cursor of a getMediaList page.
+    bool decodeMediaListPage(const std::string &page, MediaListQuery *query) const;
+
+    /// Encode the cursor after the last item of a getMediaList page.
+    std::string encodeMediaListPage(const MediaListQuery *query) const;
+
+    /**
+     * \brief Send a list reply with the results of the db service copied
+     * in unchanged.
+     *
+     * Requests the next page for subscriptions.
+     *
+     * \param[in] dbMethod The method of the reply.
+     * \param[in] listKey Key of the list in the reply.
+     * \param[in] payload The db service response.
+     * \param[in] payloadSize Size of the db service response.
+     * \param[in] dbQuery The query of the search.
+     * \param[in] object The request message, null for subscriptions.
+     * \param[out] handled False if the payload has to be parsed instead.
+     * \return True on success.
+     */
+    bool sendListReply(const std::string &dbMethod, const char *listKey,
+        const char *payload, size_t payloadSize, pbnjson::JValue &dbQuery,
+        void *object, bool &handled);
+
+    /**
+     * \brief Store the search result of one kind.
+     *
+     * Sends the merged reply and releases the query once all kinds
+     * have been answered.
+     *
+     * \param[in] query The merged search.
+     * \param[in] kind Index of the media kind.
+     * \param[in] results Search results, null on error.
+     * \param[in] more The db service has further results.
+     */
+    void completeMediaList(MediaListQuery *query, size_t kind,
+        const pbnjson::JValue &results, bool more);
+
+    /// Read the granted services of the previous run.
+    void loadGrantedClients();
+
+    /// Send the grants not confirmed in this run again.
+    void regrantClients();
+
+    /**
+     * \brief Handle the response of an asynchronous grant.
+     *
+     * \param[in] msg The db service response.
+     * \param[in] services The services of the grant, deleted here.
+     */
+    void confirmGrants(LSMessage *msg, std::list<std::string> *services);
+
+    /// DbConnector interface.
+    void kindsLost() override;
+
+    /// Save the granted services, must be called with clientsLock_ locked.
+    void saveGrantedClients() const;
+
     bool prepareWhere(const std::string &key,
                       bool value,
                       bool precise,
@@ -250,12 +446,17 @@ private:
         { std::string("getVideoMetaData"),   MediaDbMethod::GetVideoMetaData  },
         { std::string("getImageMetaData"),   MediaDbMethod::GetImageMetaData  },
         { std::string("requestDelete"),  MediaDbMethod::RequestDelete },
-        { std::string("removeDirty"),    MediaDbMethod::RemoveDirty   }
+        { std::string("removeDirty"),    MediaDbMethod::RemoveDirty   },
+        { std::string("getMediaList"),   MediaDbMethod::GetMediaList  },
+        { std::string("reconcile"),      MediaDbMethod::Reconcile     }
     };
 
-    /// List of services that should have read-only access to
-    /// database.
-    std::list<std::string> dbClients_;
+    /// Services whose grant the database confirmed in this run.
+    std::set<std::string> dbClients_;
+    /// Grants of a previous run or of lost kinds, not yet confirmed.
+    std::set<std::string> restoredClients_;
+    /// Protects dbClients_ and restoredClients_.
+    std::mutex clientsLock_;
     std::map<std::string, unsigned long> mediaItemMap_;
     std::mutex mutex_;
 
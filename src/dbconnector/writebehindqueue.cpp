@@ -0,0 +1,122 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "writebehindqueue.h"
+
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+WriteBehindQueue::WriteBehindQueue(const std::string &path, size_t maxBytes) :
+    path_(path),
+    maxBytes_(maxBytes)
+{
+    // requests left behind from a previous run count against the limit
+    std::error_code err;
+    auto size = std::filesystem::file_size(path_, err);
+    if (!err) {
+        size_ = static_cast<size_t>(size);
+        LOG_INFO(0, "Restored %zu bytes of pending db writes from '%s'",
+            size_, path_.c_str());
+    }
+}
+
+WriteBehindQueue::~WriteBehindQueue()
+{
+    if (file_)
+        fclose(file_);
+}
+
+bool WriteBehindQueue::push(const std::string &method,
+    const pbnjson::JValue &params, const std::string &respMethod, void *obj,
+    bool force)
+{
+    auto entry = pbnjson::Object();
+    entry.put("method", method);
+    entry.put("params", params);
+    auto line = entry.stringify() + "\n";
+
+    if (!force && size_ + line.size() > maxBytes_)
+        return false;
+
+    if (!file_) {
+        std::error_code err;
+        std::filesystem::create_directories(
+            std::filesystem::path(path_).parent_path(), err);
+        file_ = fopen(path_.c_str(), "a");
+        if (!file_) {
+            LOG_ERROR(0, "Failed to open '%s', caused by : %s", path_.c_str(),
+                strerror(errno));
+            return false;
+        }
+    }
+
+    // flush every line, the queue has to survive a crash of the service
+    if (fwrite(line.c_str(), 1, line.size(), file_) != line.size() ||
+        fflush(file_) != 0) {
+        LOG_ERROR(0, "Failed to write to '%s', caused by : %s", path_.c_str(),
+            strerror(errno));
+        return false;
+    }
+
+    size_ += line.size();
+    objects_.emplace_back(respMethod, obj);
+    return true;
+}
+
+std::list<WriteBehindQueue::Entry> WriteBehindQueue::drain()
+{
+    std::list<Entry> entries;
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+
+    std::ifstream in(path_);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        auto entry = pbnjson::JDomParser::fromString(line);
+        if (!entry.isObject() || !entry.hasKey("method")) {
+            LOG_WARNING(0, "Drop invalid pending db write: %s", line.c_str());
+            continue;
+        }
+        entries.push_back({entry["method"].asString(), entry["params"], "",
+            nullptr});
+    }
+    in.close();
+    unlink(path_.c_str());
+    size_ = 0;
+
+    // the requests of this run are the last ones in the file
+    auto it = entries.rbegin();
+    for (auto obj = objects_.rbegin();
+         obj != objects_.rend() && it != entries.rend(); ++obj, ++it) {
+        it->respMethod = obj->first;
+        it->object = obj->second;
+    }
+    objects_.clear();
+
+    return entries;
+}
+
+bool WriteBehindQueue::empty() const
+{
+    return size_ == 0;
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+#include <pbnjson.hpp>
+
+#include <cstdio>
+#include <string>
+#include <list>
+
+/// Directory of the write-behind queue files.
+#define WRITE_BEHIND_DIRECTORY "/media/.cache/"
+/// Upper limit of the write-behind queue file size in bytes.
+#define WRITE_BEHIND_MAX_BYTES (8 * 1024 * 1024)
+
+/**
+ * \brief On-disk queue of db write requests.
+ *
+ * Write requests issued before the db service is ready are appended
+ * to a file, one JSON request per line, and read back once the db
+ * service can take them. Entries left behind from a previous run are
+ * restored without the attached objects.
+ *
+ * The queue is not thread safe, the owner has to serialize access.
+ */
+class WriteBehindQueue
+{
+public:
+    /// A queued write request.
+    struct Entry {
+        /// Db service method, put, merge, mergePut or batch.
+        std::string method;
+        /// The request parameters.
+        pbnjson::JValue params;
+        /// Method name the response handler expects.
+        std::string respMethod;
+        /// Object attached to the request, nullptr if restored.
+        void *object;
+    };
+
+    /**
+     * \brief Open the queue file.
+     *
+     * \param[in] path The queue file.
+     * \param[in] maxBytes Upper limit of the queue file size.
+     */
+    WriteBehindQueue(const std::string &path,
+        size_t maxBytes = WRITE_BEHIND_MAX_BYTES);
+
+    virtual ~WriteBehindQueue();
+
+    /**
+     * \brief Append a write request.
+     *
+     * \param[in] method Db service method.
+     * \param[in] params The request parameters.
+     * \param[in] respMethod Method name the response handler expects.
+     * \param[in] obj Object attached to the request.
+     * \param[in] force Append even if the size limit is reached.
+     * \return True if queued, false if the queue is full or on error.
+     */
+    bool push(const std::string &method, const pbnjson::JValue &params,
+        const std::string &respMethod, void *obj, bool force = false);
+
+    /**
+     * \brief Take all queued requests, oldest first.
+     *
+     * The queue file is removed.
+     *
+     * \return The queued requests.
+     */
+    std::list<Entry> drain();
+
+    /// Check if there are no requests queued.
+    bool empty() const;
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// The queue file.
+    std::string path_;
+    /// Upper limit of the queue file size.
+    size_t maxBytes_;
+    /// Current queue file size.
+    size_t size_ = 0;
+    /// Queue file opened for appending.
+    FILE *file_ = nullptr;
+    /// Requests of this run, the attached objects stay in memory.
+    std::list<std::pair<std::string, void *>> objects_;
+};
@@ -268,6 +268,9 @@ void Device::scanLoop()
         }
 #if PERFCHECK_ENABLE
         PERF_END(perfuri.c_str());
+        // time from process start to the first finished device scan
+        static std::once_flag firstScan;
+        std::call_once(firstScan, [] { PERF_END("STARTUP"); });
 #endif
         if (processingDone())
             activateCleanUpTask();
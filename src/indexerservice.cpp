@@ -69,59 +69,61 @@ LSMethod IndexerService::serviceMethods_[] = {
     { "getVideoMetadata", IndexerService::onVideoMetadataGet, LUNA_METHOD_FLAGS_NONE },
     { "getImageList", IndexerService::onImageListGet, LUNA_METHOD_FLAGS_NONE },
     { "getImageMetadata", IndexerService::onImageMetadataGet, LUNA_METHOD_FLAGS_NONE },
+    { "getMediaList", IndexerService::onMediaListGet, LUNA_METHOD_FLAGS_NONE },
     { "requestDelete", IndexerService::onRequestDelete, LUNA_METHOD_FLAGS_NONE },
     { "requestMediaScan", IndexerService::onRequestMediaScan, LUNA_METHOD_FLAGS_NONE },
     { nullptr, nullptr}
 };
 
-pbnjson::JSchema IndexerService::pluginGetSchema_(pbnjson::JSchema::fromString(
+const RequestDecoder<IndexerService::UriRequest> IndexerService::pluginGetDecoder_(
         "{ \"type\": \"object\","
         "  \"properties\": {"
         "    \"uri\": {"
         "      \"type\": \"string\" }"
         "  }"
-        "}"));
+        "}",
+        { { "uri", &UriRequest::uri } });
 
-pbnjson::JSchema IndexerService::pluginPutSchema_(pbnjson::JSchema::fromString(
+const RequestDecoder<IndexerService::UriRequest> IndexerService::pluginPutDecoder_(
         "{ \"type\": \"object\","
         "  \"properties\": {"
         "    \"uri\": {"
         "      \"type\": \"string\" }"
         "  },"
         "  \"required\": [ \"uri\" ]"
-        "}"));
+        "}",
+        { { "uri", &UriRequest::uri } });
 
-pbnjson::JSchema IndexerService::deviceListGetSchema_(
-    pbnjson::JSchema::fromString(
+const RequestDecoder<IndexerService::DeviceListRequest> IndexerService::deviceListGetDecoder_(
         "{ \"type\": \"object\","
         "  \"properties\": {"
         "    \"subscribe\": {"
         "      \"type\": \"boolean\" }"
         "  },"
         "  \"required\": [ \"subscribe\" ]"
-        "}"));
+        "}",
+        { { "subscribe", &DeviceListRequest::subscribe } });
 
-pbnjson::JSchema IndexerService::detectRunStopSchema_(
-    pbnjson::JSchema::fromString(
+const RequestDecoder<IndexerService::UriRequest> IndexerService::detectRunStopDecoder_(
         "{ \"type\": \"object\","
         "  \"properties\": {"
         "    \"uri\": {"
         "      \"type\": \"string\" }"
         "  }"
-        "}"));
+        "}",
+        { { "uri", &UriRequest::uri } });
 
-pbnjson::JSchema IndexerService::metadataGetSchema_(
-    pbnjson::JSchema::fromString(
+const RequestDecoder<IndexerService::UriRequest> IndexerService::metadataGetDecoder_(
         "{ \"type\": \"object\","
         "  \"properties\": {"
         "    \"uri\": {"
         "      \"type\": \"string\" }"
         "  },"
         "  \"required\": [ \"uri\" ]"
-        "}"));
+        "}",
+        { { "uri", &UriRequest::uri } });
 
-pbnjson::JSchema IndexerService::listGetSchema_(
-    pbnjson::JSchema::fromString(
+const RequestDecoder<IndexerService::ListRequest> IndexerService::listGetDecoder_(
         "{ \"type\": \"object\","
         "  \"properties\": {"
         "    \"uri\": {"
@@ -131,7 +133,50 @@ pbnjson::JSchema IndexerService::listGetSchema_(
         "    \"subscribe\": {"
         "      \"type\": \"boolean\" }"
         "  }"
-        "}"));
+        "}",
+        { { "uri", &ListRequest::uri }, { "count", &ListRequest::count } });
+
+const RequestDecoder<IndexerService::MediaListRequest> IndexerService::mediaListGetDecoder_(
+        "{ \"type\": \"object\","
+        "  \"properties\": {"
+        "    \"uri\": {"
+        "      \"type\": \"string\" },"
+        "    \"count\": {"
+        "      \"type\": \"number\" },"
+        "    \"orderBy\": {"
+        "      \"type\": \"string\","
+        "      \"enum\": [ \"uri\", \"file_path\", \"last_modified_date\" ] },"
+        "    \"desc\": {"
+        "      \"type\": \"boolean\" },"
+        "    \"page\": {"
+        "      \"type\": \"string\" },"
+        "    \"thumbnailVariant\": {"
+        "      \"type\": \"string\" }"
+        "  }"
+        "}",
+        { { "uri", &MediaListRequest::uri }, { "count", &MediaListRequest::count },
+          { "orderBy", &MediaListRequest::orderBy }, { "desc", &MediaListRequest::desc },
+          { "page", &MediaListRequest::page },
+          { "thumbnailVariant", &MediaListRequest::thumbnailVariant } });
+
+const RequestDecoder<IndexerService::PermissionRequest> IndexerService::permissionGetDecoder_(
+        "{ \"type\": \"object\","
+        "  \"properties\": {"
+        "    \"serviceName\": {"
+        "      \"type\": \"string\" }"
+        "  }"
+        "}",
+        { { "serviceName", &PermissionRequest::serviceName } });
+
+const RequestDecoder<IndexerService::ScanRequest> IndexerService::mediaScanDecoder_(
+        "{ \"type\": \"object\","
+        "  \"properties\": {"
+        "    \"path\": {"
+        "      \"type\": \"string\" }"
+        "  },"
+        "  \"required\": [ \"path\" ]"
+        "}",
+        { { "path", &ScanRequest::path } });
 
 IndexerService::IndexerService(MediaIndexer *indexer) :
     dbObserver_(nullptr),
@@ -173,20 +218,27 @@ IndexerService::IndexerService(MediaIndexer *indexer) :
 
     PdmListener::init(lsHandle_);
     DbConnector::init(lsHandle_);
+    // do not wait for the db service, write requests are queued until
+    // it is ready
+    MediaDb::instance();
+    SettingsDb::instance();
+    DeviceDb::instance();
+    MediaParser::instance();
+    if (indexer_) {
+        indexer_->addPlugin("msc");
+        indexer_->addPlugin("storage");
+        indexer_->setDetect(true);
+    }
+
     auto dbInitialized = [&] () -> void {
+        // register the kinds and replay the queued write requests
+        DbConnector::connected();
         MediaDb *mdb = MediaDb::instance();
-        // get the permission for the com.webos.service.mediaindexer
+        // get the permission for the com.webos.service.mediaindexer,
+        // sent once the kinds are registered
         // TODO: reply doesn't used in grantAccessAll function.
         auto reply = pbnjson::Object();
         mdb->grantAccessAll(std::string(lunaServiceId), false, reply, "putPermissions-async");
-        SettingsDb::instance();
-        DeviceDb::instance();
-        MediaParser::instance();
-        if(indexer_) {
-            indexer_->addPlugin("msc");
-            indexer_->addPlugin("storage");
-            indexer_->setDetect(true);
-        }
     };
 
     dbObserver_ = new DbObserver(lsHandle_, dbInitialized);
@@ -221,15 +273,15 @@ bool IndexerService::pushDeviceList(LSMessage *msg)
     if (msg) {
         // parse incoming message
         const char *payload = LSMessageGetPayload(msg);
-        pbnjson::JDomParser parser;
+        DeviceListRequest request;
 
-        if (!parser.parse(payload, deviceListGetSchema_)) {
+        if (!deviceListGetDecoder_.decode(payload, request)) {
             LOG_ERROR(0, "Invalid getDeviceList request: %s", payload);
             return false;
         }
         LOG_DEBUG("Valid getDeviceList request");
 
-        checkForDeviceListSubscriber(msg, parser);
+        checkForDeviceListSubscriber(msg, request);
     }
 
     // generate response
@@ -366,27 +418,25 @@ bool IndexerService::onMediaDbPermissionGet(LSHandle *lsHandle, LSMessage *msg,
     // parse incoming message
     const char *payload = LSMessageGetPayload(msg);
     std::string method = LSMessageGetMethod(msg);
-    pbnjson::JDomParser parser;
+    PermissionRequest request;
 
-    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
+    if (!permissionGetDecoder_.decode(payload, request)) {
         LOG_ERROR(0, "Invalid %s request: %s", method.c_str(),
             payload);
         return false;
     }
 
-    auto domTree(parser.getDom());
-
     MediaDb *mdb = MediaDb::instance();
     auto reply = pbnjson::Object();
-    std::lock_guard<std::mutex> lk(mutex_);
+    // no service wide lock needed, MediaDb keeps track of the grants
     if (mdb) {
-        if (!domTree.hasKey("serviceName")) {
+        if (!request.serviceName) {
             LOG_ERROR(0, "serviceName field is mandatory input");
             mdb->putRespObject(false, reply, -1, "serviceName field is mandatory input");
             mdb->sendResponse(lsHandle, msg, reply.stringify());
             return false;
         }
-        std::string serviceName = domTree["serviceName"].asString();
+        const std::string &serviceName = *request.serviceName;
         if (serviceName.empty()) {
             LOG_ERROR(0, "empty string input");
             mdb->putRespObject(false, reply, -1, "empty string input");
@@ -473,23 +523,16 @@ bool IndexerService::onAudioListGet(LSHandle *lsHandle, LSMessage *msg, void *ct
     std::string senderName = LSMessageGetSenderServiceName(msg);
     const char *payload = LSMessageGetPayload(msg);
 
-    pbnjson::JDomParser parser;
-    // TODO: apply listSchema
-    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
+    ListRequest request;
+    if (!listGetDecoder_.decode(payload, request)) {
         LOG_ERROR(0, "Invalid request: payload[%s] sender[%s]",
                 payload, senderName.c_str());
         return false;
     }
 
-    // parse uri and count from application payload
-    std::string uri;
-    int count = 0;
-    auto domTree(parser.getDom());
-
-    if (domTree.hasKey("uri"))
-        uri = domTree["uri"].asString();
-    if (domTree.hasKey("count"))
-        count = domTree["count"].asNumber<int32_t>();
+    // uri and count from application payload
+    std::string uri = request.uri.value_or("");
+    int count = request.count.value_or(0);
 
     if (count < 0 || count > MAXIMUM_DB_COUNT) {
         auto reply = pbnjson::Object();
@@ -570,18 +613,13 @@ bool IndexerService::onAudioMetadataGet(LSHandle *lsHandle, LSMessage *msg, void
     // parse incoming message
     const char *payload = LSMessageGetPayload(msg);
     std::string method = LSMessageGetMethod(msg);
-    pbnjson::JDomParser parser;
-
-    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
-        LOG_ERROR(0, "Invalid %s request: %s", LSMessageGetMethod(msg),
-            payload);
-        return false;
-    }
+    UriRequest request;
 
-    auto domTree(parser.getDom());
-    RETURN_IF(!domTree.hasKey("uri"), false, "client must specify uri");
+    // the schema makes the uri mandatory
+    RETURN_IF(!metadataGetDecoder_.decode(payload, request), false,
+        "Invalid %s request: %s", LSMessageGetMethod(msg), payload);
     // get the playback uri for the given media item uri
-    auto uri = domTree["uri"].asString();
+    auto uri = *request.uri;
     LOG_DEBUG("Valid %s request for uri: %s", LSMessageGetMethod(msg),
         uri.c_str());
     LSMessageRef(msg);
@@ -597,23 +635,16 @@ bool IndexerService::onVideoListGet(LSHandle *lsHandle, LSMessage *msg, void *ct
     std::string senderName = LSMessageGetSenderServiceName(msg);
     const char *payload = LSMessageGetPayload(msg);
 
-    pbnjson::JDomParser parser;
-    // TODO: apply listSchema
-    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
+    ListRequest request;
+    if (!listGetDecoder_.decode(payload, request)) {
         LOG_ERROR(0, "Invalid request: payload[%s] sender[%s]",
                 payload, senderName.c_str());
         return false;
     }
 
-    // parse uri and count from application payload
-    std::string uri;
-    int count = 0;
-    auto domTree(parser.getDom());
-
-    if (domTree.hasKey("uri"))
-        uri = domTree["uri"].asString();
-    if (domTree.hasKey("count"))
-        count = domTree["count"].asNumber<int32_t>();
+    // uri and count from application payload
+    std::string uri = request.uri.value_or("");
+    int count = request.count.value_or(0);
 
     if (count < 0 || count > MAXIMUM_DB_COUNT) {
         auto reply = pbnjson::Object();
@@ -694,18 +725,13 @@ bool IndexerService::onVideoMetadataGet(LSHandle *lsHandle, LSMessage *msg, void
     // parse incoming message
     const char *payload = LSMessageGetPayload(msg);
     std::string method = LSMessageGetMethod(msg);
-    pbnjson::JDomParser parser;
+    UriRequest request;
 
-    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
-        LOG_ERROR(0, "Invalid %s request: %s", LSMessageGetMethod(msg),
-            payload);
-        return false;
-    }
-
-    auto domTree(parser.getDom());
-    RETURN_IF(!domTree.hasKey("uri"), false, "client must specify uri");
+    // the schema makes the uri mandatory
+    RETURN_IF(!metadataGetDecoder_.decode(payload, request), false,
+        "Invalid %s request: %s", LSMessageGetMethod(msg), payload);
     // get the playback uri for the given media item uri
-    auto uri = domTree["uri"].asString();
+    auto uri = *request.uri;
     LOG_DEBUG("Valid %s request for uri: %s", LSMessageGetMethod(msg),
         uri.c_str());
     LSMessageRef(msg);
@@ -721,23 +747,16 @@ bool IndexerService::onImageListGet(LSHandle *lsHandle, LSMessage *msg, void *ct
     std::string senderName = LSMessageGetSenderServiceName(msg);
     const char *payload = LSMessageGetPayload(msg);
 
-    pbnjson::JDomParser parser;
-    // TODO: apply listSchema
-    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
+    ListRequest request;
+    if (!listGetDecoder_.decode(payload, request)) {
         LOG_ERROR(0, "Invalid request: payload[%s] sender[%s]",
                 payload, senderName.c_str());
         return false;
     }
 
-    // parse uri and count from application payload
-    std::string uri;
-    int count = 0;
-    auto domTree(parser.getDom());
-
-    if (domTree.hasKey("uri"))
-        uri = domTree["uri"].asString();
-    if (domTree.hasKey("count"))
-        count = domTree["count"].asNumber<int32_t>();
+    // uri and count from application payload
+    std::string uri = request.uri.value_or("");
+    int count = request.count.value_or(0);
 
     if (count < 0 || count > MAXIMUM_DB_COUNT) {
         auto reply = pbnjson::Object();
@@ -811,25 +830,77 @@ bool IndexerService::getImageList(const std::string &uri, int count, LSMessage *
     return mdb->getImageList(uri, count, msg, expand);
 }
 
-bool IndexerService::onImageMetadataGet(LSHandle *lsHandle, LSMessage *msg, void *ctx)
+bool IndexerService::onMediaListGet(LSHandle *lsHandle, LSMessage *msg, void *ctx)
 {
-    LOG_DEBUG("call onGetImageMetadata");
     IndexerService *indexerService = static_cast<IndexerService *>(ctx);
+
     // parse incoming message
+    std::string senderName = LSMessageGetSenderServiceName(msg);
     const char *payload = LSMessageGetPayload(msg);
-    std::string method = LSMessageGetMethod(msg);
-    pbnjson::JDomParser parser;
 
-    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
-        LOG_ERROR(0, "Invalid %s request: %s", LSMessageGetMethod(msg),
-            payload);
+    MediaListRequest request;
+    if (!mediaListGetDecoder_.decode(payload, request)) {
+        LOG_ERROR(0, "Invalid request: payload[%s] sender[%s]",
+                payload, senderName.c_str());
         return false;
     }
 
-    auto domTree(parser.getDom());
-    RETURN_IF(!domTree.hasKey("uri"), false, "client must specify uri");
+    std::string uri = request.uri.value_or("");
+    int count = request.count.value_or(0);
+    std::string orderBy = request.orderBy.value_or(
+        MediaItem::metaToString(MediaItem::Meta::LastModifiedDate));
+    bool desc = request.desc.value_or(false);
+    std::string page = request.page.value_or("");
+    std::string variant = request.thumbnailVariant.value_or("");
+
+    // increase reference count for message.
+    // this reference count will be decrease in notification callback.
+    LSMessageRef(msg);
+    if (count >= 0 && count <= MAXIMUM_DB_COUNT &&
+        indexerService->getMediaList(uri, count, orderBy, desc, page, variant, msg))
+        return true;
+    LSMessageUnref(msg);
+
+    LOG_ERROR(0, "Invalid media list request: payload[%s]", payload);
+    auto reply = pbnjson::Object();
+    reply.put("returnValue", false);
+    reply.put("errorCode", -1);
+    reply.put("errorText", "Invalid request parameters");
+
+    LSError lsError;
+    LSErrorInit(&lsError);
+
+    if (!LSMessageReply(lsHandle, msg, reply.stringify().c_str(), &lsError)) {
+        LOG_ERROR(0, "Message reply error");
+        LSErrorPrint(&lsError, stderr);
+        LSErrorFree(&lsError);
+    }
+
+    return false;
+}
+
+bool IndexerService::getMediaList(const std::string &uri, int count,
+    const std::string &orderBy, bool desc, const std::string &page,
+    const std::string &variant, LSMessage *msg)
+{
+    MediaDb *mdb = MediaDb::instance();
+    return mdb->getMediaList(uri, count, orderBy, desc, page, variant, msg);
+}
+
+bool IndexerService::onImageMetadataGet(LSHandle *lsHandle, LSMessage *msg, void *ctx)
+{
+    LOG_DEBUG("call onGetImageMetadata");
+    IndexerService *indexerService = static_cast<IndexerService *>(ctx);
+    // parse incoming message
+    const char *payload = LSMessageGetPayload(msg);
+    std::string method = LSMessageGetMethod(msg);
+    UriRequest request;
+
+    // the schema makes the uri mandatory
+    RETURN_IF(!metadataGetDecoder_.decode(payload, request), false,
+        "Invalid %s request: %s", LSMessageGetMethod(msg), payload);
     // get the playback uri for the given media item uri
-    auto uri = domTree["uri"].asString();
+    auto uri = *request.uri;
     LOG_DEBUG("Valid %s request for uri: %s", LSMessageGetMethod(msg),
         uri.c_str());
     LSMessageRef(msg);
@@ -845,21 +916,16 @@ bool IndexerService::onRequestDelete(LSHandle *lsHandle, LSMessage *msg, void *c
     std::string senderName = LSMessageGetSenderServiceName(msg);
     const char *payload = LSMessageGetPayload(msg);
     std::string method = LSMessageGetMethod(msg);
-    pbnjson::JDomParser parser;
+    UriRequest request;
 
-    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
-        LOG_ERROR(0, "Invalid %s request: %s", LSMessageGetMethod(msg),
-            payload);
-        return false;
-    }
-
-    auto domTree(parser.getDom());
-    RETURN_IF(!domTree.hasKey("uri"), false, "client must specify uri");
+    // the schema makes the uri mandatory
+    RETURN_IF(!metadataGetDecoder_.decode(payload, request), false,
+        "Invalid %s request: %s", LSMessageGetMethod(msg), payload);
 
     bool subscribe = LSMessageIsSubscription(msg);
 
     // get the playback uri for the given media item uri
-    auto uri = domTree["uri"].asString();
+    auto uri = *request.uri;
     bool ret = false;
     if (subscribe) {
         LSError lsError;
@@ -923,19 +989,13 @@ bool IndexerService::requestMediaScan(LSMessage *msg)
     // parse incoming message
     const char *payload = LSMessageGetPayload(msg);
     std::string method = LSMessageGetMethod(msg);
-    pbnjson::JDomParser parser;
+    ScanRequest request;
 
-    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
-        LOG_ERROR(0, "Invalid %s request: %s", LSMessageGetMethod(msg),
-            payload);
-        return false;
-    }
-
-    auto domTree(parser.getDom());
-    RETURN_IF(!domTree.hasKey("path"), false, "client must specify path");
+    // the schema makes the path mandatory
+    RETURN_IF(!mediaScanDecoder_.decode(payload, request), false,
+        "Invalid %s request: %s", LSMessageGetMethod(msg), payload);
 
-    // get the playback uri for the given media item uri
-    auto path = domTree["path"].asString();
+    auto path = *request.path;
 
     LOG_INFO(0, "call IndexerService onRequestMediaScan");
     Device *device = nullptr;
@@ -990,24 +1050,23 @@ bool IndexerService::notifyScanDone()
 bool IndexerService::pluginPutGet(LSMessage *msg, bool get)
 {
     const char *payload = LSMessageGetPayload(msg);
-    pbnjson::JDomParser parser;
+    UriRequest request;
     LOG_DEBUG("LSMessageGetMethod : %s", LSMessageGetMethod(msg));
-    if (!parser.parse(payload, get ? pluginGetSchema_ : pluginPutSchema_)) {
+    const auto &decoder = get ? pluginGetDecoder_ : pluginPutDecoder_;
+    if (!decoder.decode(payload, request)) {
         LOG_ERROR(0, "Invalid %s request: %s", LSMessageGetMethod(msg),
             payload);
         return false;
     }
 
-    auto domTree(parser.getDom());
-
     // response message
     auto reply = pbnjson::Object();
 
     // if no uri is given for getPlugin we activate all plugins
-    if (get && !domTree.hasKey("uri")) {
+    if (get && !request.uri) {
         reply.put("returnValue", indexer_->get(""));
     } else {
-        auto uri = domTree["uri"].asString();
+        auto uri = *request.uri;
         LOG_DEBUG("Valid %s request for uri: %s", LSMessageGetMethod(msg),
             uri.c_str());
 
@@ -1031,16 +1090,15 @@ bool IndexerService::detectRunStop(LSMessage *msg, bool run)
 {
     // parse incoming message
     const char *payload = LSMessageGetPayload(msg);
-    pbnjson::JDomParser parser;
-    if (!parser.parse(payload, detectRunStopSchema_)) {
+    UriRequest request;
+    if (!detectRunStopDecoder_.decode(payload, request)) {
         LOG_ERROR(0, "Invalid %s request: %s", LSMessageGetMethod(msg),
             payload);
         return false;
     }
 
-    auto domTree(parser.getDom());
-    if (domTree.hasKey("uri")) {
-        auto uri = domTree["uri"].asString();
+    if (request.uri) {
+        auto uri = *request.uri;
         LOG_DEBUG("Valid %s request for uri: %s", LSMessageGetMethod(msg),
             uri.c_str());
         indexer_->setDetect(run, uri);
@@ -1065,12 +1123,9 @@ bool IndexerService::detectRunStop(LSMessage *msg, bool run)
 }
 
 void IndexerService::checkForDeviceListSubscriber(LSMessage *msg,
-    pbnjson::JDomParser &parser)
+    const DeviceListRequest &request)
 {
-    auto domTree(parser.getDom());
-    auto subscribe = domTree["subscribe"].asBool();
-
-    if (!subscribe)
+    if (!request.subscribe.value_or(false))
         return;
 
     LOG_INFO(0, "Adding getDeviceList subscriber '%s'",
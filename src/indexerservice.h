@@ -20,11 +20,13 @@
 #include "dbobserver.h"
 #include "localeobserver.h"
 #include "indexerserviceclientsmgr.h"
+#include "jsonparser/requestdecoder.h"
 #include <pbnjson.hpp>
 #include <string.h>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
+#include <optional>
 
 class MediaIndexer;
 
@@ -146,18 +148,55 @@ private:
     /// Needs indexer class.
     IndexerService();
 
-    /// Schema for getPlugin.
-    static pbnjson::JSchema pluginGetSchema_;
-    /// Schema for putPlugin.
-    static pbnjson::JSchema pluginPutSchema_;
-    /// Schema for getDeviceList.
-    static pbnjson::JSchema deviceListGetSchema_;
-    /// Schema for runDetect and stopDetect.
-    static pbnjson::JSchema detectRunStopSchema_;
-    /// Schema for getXXXXXMetadata.
-    static pbnjson::JSchema metadataGetSchema_;
-    /// Schema for getXXXXXList.
-    static pbnjson::JSchema listGetSchema_;
+    /// Request with an optional uri.
+    struct UriRequest {
+        std::optional<std::string> uri;
+    };
+    /// Request of getDeviceList.
+    struct DeviceListRequest {
+        std::optional<bool> subscribe;
+    };
+    /// Request of getXXXXXList.
+    struct ListRequest {
+        std::optional<std::string> uri;
+        std::optional<int32_t> count;
+    };
+    /// Request of getMediaList.
+    struct MediaListRequest {
+        std::optional<std::string> uri;
+        std::optional<int32_t> count;
+        std::optional<std::string> orderBy;
+        std::optional<bool> desc;
+        std::optional<std::string> page;
+        std::optional<std::string> thumbnailVariant;
+    };
+    /// Request of getMediaDbPermission.
+    struct PermissionRequest {
+        std::optional<std::string> serviceName;
+    };
+    /// Request of requestMediaScan.
+    struct ScanRequest {
+        std::optional<std::string> path;
+    };
+
+    /// Decoder for getPlugin.
+    static const RequestDecoder<UriRequest> pluginGetDecoder_;
+    /// Decoder for putPlugin.
+    static const RequestDecoder<UriRequest> pluginPutDecoder_;
+    /// Decoder for getDeviceList.
+    static const RequestDecoder<DeviceListRequest> deviceListGetDecoder_;
+    /// Decoder for runDetect and stopDetect.
+    static const RequestDecoder<UriRequest> detectRunStopDecoder_;
+    /// Decoder for getXXXXXMetadata and requestDelete.
+    static const RequestDecoder<UriRequest> metadataGetDecoder_;
+    /// Decoder for getXXXXXList.
+    static const RequestDecoder<ListRequest> listGetDecoder_;
+    /// Decoder for getMediaList.
+    static const RequestDecoder<MediaListRequest> mediaListGetDecoder_;
+    /// Decoder for getMediaDbPermission.
+    static const RequestDecoder<PermissionRequest> permissionGetDecoder_;
+    /// Decoder for requestMediaScan.
+    static const RequestDecoder<ScanRequest> mediaScanDecoder_;
 
     /**
      * \brief Callback for getPlugin() Luna method.
@@ -276,6 +315,15 @@ private:
      */
     static bool onImageMetadataGet(LSHandle *lsHandle, LSMessage *msg, void *ctx);
 
+    /**
+     * \brief Callback for getMediaList() Luna method.
+     *
+     * \param[in] lsHandle Luna service handle.
+     * \param[in] msg The Luna message.
+     * \param[in] ctx Pointer to IndexerService class instance.
+     */
+    static bool onMediaListGet(LSHandle *lsHandle, LSMessage *msg, void *ctx);
+
    /**
      * \brief Callback for onRequestDelete() Luna method.
      *
@@ -300,6 +348,8 @@ private:
     bool getAudioList(const std::string &uri, int count, LSMessage *msg = nullptr, bool expand = false);
     bool getVideoList(const std::string &uri, int count, LSMessage *msg = nullptr, bool expand = false);
     bool getImageList(const std::string &uri, int count, LSMessage *msg = nullptr, bool expand = false);
+    bool getMediaList(const std::string &uri, int count, const std::string &orderBy,
+        bool desc, const std::string &page, const std::string &variant, LSMessage *msg);
 
     bool requestDelete(const std::string &uri, LSMessage *msg = nullptr);
 
@@ -330,10 +380,10 @@ private:
      * also gets read-only access to the media database.
      *
      * \param[in] msg The received message.
-     * \param[in] parser The message parser.
+     * \param[in] request The decoded request.
      */
     void checkForDeviceListSubscriber(LSMessage *msg,
-        pbnjson::JDomParser &parser);
+        const DeviceListRequest &request);
 
     bool notifySubscriber(const std::string& method, pbnjson::JValue& response);
 
@@ -0,0 +1,280 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "replywriter.h"
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+/// Reused reply buffer of a thread.
+static thread_local std::string threadBuffer;
+/// If the thread buffer is used by a writer.
+static thread_local bool threadBufferTaken = false;
+
+/// Size of the last reply of each method.
+static std::mutex sizeHintMutex;
+static std::unordered_map<std::string, size_t> sizeHints;
+
+/// Skip white space.
+static size_t skipSpace(const char *json, size_t size, size_t pos)
+{
+    while (pos < size && strchr(" \t\r\n", json[pos]))
+        ++pos;
+    return pos;
+}
+
+/// Skip a string starting at its opening quote.
+static size_t skipString(const char *json, size_t size, size_t pos)
+{
+    for (++pos; pos < size; ++pos) {
+        if (json[pos] == '\\')
+            ++pos;
+        else if (json[pos] == '"')
+            return pos + 1;
+    }
+    return size;
+}
+
+/// Skip any value, returns the first position after it.
+static size_t skipValue(const char *json, size_t size, size_t pos)
+{
+    if (pos >= size)
+        return size;
+    if (json[pos] == '"')
+        return skipString(json, size, pos);
+    if (json[pos] == '{' || json[pos] == '[') {
+        int depth = 0;
+        while (pos < size) {
+            char c = json[pos];
+            if (c == '"') {
+                pos = skipString(json, size, pos);
+                continue;
+            }
+            if (c == '{' || c == '[')
+                ++depth;
+            else if ((c == '}' || c == ']') && --depth == 0)
+                return pos + 1;
+            ++pos;
+        }
+        return size;
+    }
+    while (pos < size && !strchr(",}] \t\r\n", json[pos]))
+        ++pos;
+    return pos;
+}
+
+ReplyWriter::ReplyWriter(const std::string &method) :
+    method_(method)
+{
+    if (!threadBufferTaken) {
+        threadBufferTaken = true;
+        threadBuffer_ = true;
+        buffer_ = &threadBuffer;
+    } else {
+        buffer_ = &own_;
+    }
+    buffer_->clear();
+
+    size_t hint = 0;
+    {
+        std::lock_guard<std::mutex> lock(sizeHintMutex);
+        auto it = sizeHints.find(method_);
+        if (it != sizeHints.end())
+            hint = it->second;
+    }
+    buffer_->reserve(hint + hint / 8);
+}
+
+ReplyWriter::~ReplyWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(sizeHintMutex);
+        sizeHints[method_] = buffer_->size();
+    }
+
+    if (threadBuffer_) {
+        if (threadBuffer.capacity() > REPLY_BUFFER_MAX)
+            std::string().swap(threadBuffer);
+        threadBufferTaken = false;
+    }
+}
+
+void ReplyWriter::separate()
+{
+    if (afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if (first_.empty())
+        return;
+    if (!first_.back())
+        buffer_->push_back(',');
+    first_.back() = false;
+}
+
+ReplyWriter &ReplyWriter::beginObject()
+{
+    separate();
+    buffer_->push_back('{');
+    first_.push_back(true);
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::endObject()
+{
+    buffer_->push_back('}');
+    first_.pop_back();
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::beginArray()
+{
+    separate();
+    buffer_->push_back('[');
+    first_.push_back(true);
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::endArray()
+{
+    buffer_->push_back(']');
+    first_.pop_back();
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::key(const char *name)
+{
+    string(name);
+    buffer_->push_back(':');
+    afterKey_ = true;
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::string(const std::string &value)
+{
+    static const char hex[] = "0123456789abcdef";
+    separate();
+    buffer_->push_back('"');
+    for (unsigned char c : value) {
+        switch (c) {
+        case '"': buffer_->append("\\\""); break;
+        case '\\': buffer_->append("\\\\"); break;
+        case '\b': buffer_->append("\\b"); break;
+        case '\f': buffer_->append("\\f"); break;
+        case '\n': buffer_->append("\\n"); break;
+        case '\r': buffer_->append("\\r"); break;
+        case '\t': buffer_->append("\\t"); break;
+        default:
+            if (c < 0x20) {
+                buffer_->append("\\u00");
+                buffer_->push_back(hex[c >> 4]);
+                buffer_->push_back(hex[c & 0x0f]);
+            } else {
+                buffer_->push_back(c);
+            }
+        }
+    }
+    buffer_->push_back('"');
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::number(int64_t value)
+{
+    separate();
+    buffer_->append(std::to_string(value));
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::boolean(bool value)
+{
+    separate();
+    buffer_->append(value ? "true" : "false");
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::null()
+{
+    separate();
+    buffer_->append("null");
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::raw(const char *json, size_t size)
+{
+    separate();
+    buffer_->append(json, size);
+    return *this;
+}
+
+ReplyWriter &ReplyWriter::value(const pbnjson::JValue &value)
+{
+    auto json = value.stringify();
+    return raw(json.data(), json.size());
+}
+
+const std::string &ReplyWriter::str() const
+{
+    return *buffer_;
+}
+
+bool ReplyWriter::findMember(const char *json, size_t jsonSize, const char *key,
+    const char **begin, size_t *size)
+{
+    size_t keyLength = strlen(key);
+    size_t pos = skipSpace(json, jsonSize, 0);
+    if (pos >= jsonSize || json[pos] != '{')
+        return false;
+    pos = skipSpace(json, jsonSize, pos + 1);
+
+    while (pos < jsonSize && json[pos] == '"') {
+        size_t keyEnd = skipString(json, jsonSize, pos);
+        bool match = (keyEnd - pos == keyLength + 2) &&
+            !memcmp(json + pos + 1, key, keyLength);
+        pos = skipSpace(json, jsonSize, keyEnd);
+        if (pos >= jsonSize || json[pos] != ':')
+            return false;
+        pos = skipSpace(json, jsonSize, pos + 1);
+        size_t valueEnd = skipValue(json, jsonSize, pos);
+        if (match) {
+            *begin = json + pos;
+            *size = valueEnd - pos;
+            return valueEnd > pos;
+        }
+        pos = skipSpace(json, jsonSize, valueEnd);
+        if (pos >= jsonSize || json[pos] != ',')
+            return false;
+        pos = skipSpace(json, jsonSize, pos + 1);
+    }
+    return false;
+}
+
+int64_t ReplyWriter::arraySize(const char *json, size_t size)
+{
+    if (!size || json[0] != '[')
+        return -1;
+    int64_t count = 0;
+    size_t pos = 1;
+    while (pos < size) {
+        while (pos < size && strchr(" \t\r\n,", json[pos]))
+            ++pos;
+        if (pos >= size || json[pos] == ']')
+            break;
+        pos = skipValue(json, size, pos);
+        ++count;
+    }
+    return count;
+}
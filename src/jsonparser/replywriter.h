@@ -0,0 +1,129 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <pbnjson.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Thread buffers grown beyond this size in bytes are released again.
+#define REPLY_BUFFER_MAX (4 * 1024 * 1024)
+
+/**
+ * \brief Streaming writer for Luna reply payloads.
+ *
+ * Writes JSON directly into a buffer of the calling thread that is
+ * reused for every reply, it is reserved with the size of the last
+ * reply of the same method. Already serialized values, like the results
+ * of a db service response, are copied in without building a DOM.
+ *
+ * The payload is valid until the next writer on the same thread is
+ * created, it has to be sent before that. A writer created while
+ * another one on the same thread is still alive uses a buffer of its
+ * own.
+ */
+class ReplyWriter
+{
+public:
+    /**
+     * \brief Create writer.
+     *
+     * \param[in] method The method name used for the size hint.
+     */
+    ReplyWriter(const std::string &method);
+
+    virtual ~ReplyWriter();
+
+    /// Start an object.
+    ReplyWriter &beginObject();
+    /// End an object.
+    ReplyWriter &endObject();
+    /// Start an array.
+    ReplyWriter &beginArray();
+    /// End an array.
+    ReplyWriter &endArray();
+    /// Write an object key, the value has to follow.
+    ReplyWriter &key(const char *name);
+    /// Write a string.
+    ReplyWriter &string(const std::string &value);
+    /// Write a number.
+    ReplyWriter &number(int64_t value);
+    /// Write a boolean.
+    ReplyWriter &boolean(bool value);
+    /// Write null.
+    ReplyWriter &null();
+    /// Write an already serialized value.
+    ReplyWriter &raw(const char *json, size_t size);
+    /// Write a value of a DOM.
+    ReplyWriter &value(const pbnjson::JValue &value);
+
+    /**
+     * \brief Get the payload.
+     *
+     * \return The written JSON.
+     */
+    const std::string &str() const;
+
+    /**
+     * \brief Find a member of a serialized object.
+     *
+     * Only the top level of the object is searched, the value is not
+     * validated.
+     *
+     * \param[in] json The serialized object.
+     * \param[in] jsonSize Size of the serialized object.
+     * \param[in] key The member name.
+     * \param[out] begin Start of the serialized value.
+     * \param[out] size Size of the serialized value.
+     * \return False if there is no such member.
+     */
+    static bool findMember(const char *json, size_t jsonSize, const char *key,
+        const char **begin, size_t *size);
+
+    /**
+     * \brief Count the elements of a serialized array.
+     *
+     * \param[in] json The serialized array.
+     * \param[in] size Size of the serialized array.
+     * \return The number of elements, -1 if this is no array.
+     */
+    static int64_t arraySize(const char *json, size_t size);
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// Write the separator in front of a key or value.
+    void separate();
+
+    /// The method name.
+    std::string method_;
+    /// The buffer written to.
+    std::string *buffer_ = nullptr;
+    /// Buffer used if the thread buffer is taken.
+    std::string own_;
+    /// If this writer uses the thread buffer.
+    bool threadBuffer_ = false;
+    /// If the next value of a nesting level is the first one.
+    std::vector<bool> first_;
+    /// If a key has been written and its value is next.
+    bool afterKey_ = false;
+};
@@ -0,0 +1,117 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "requestdecoder.h"
+
+#include <cmath>
+
+RequestParser::RequestParser()
+{
+    // nothing to be done here
+}
+
+RequestParser::~RequestParser()
+{
+    // nothing to be done here
+}
+
+bool RequestParser::parsePayload(const char *payload, const pbnjson::JSchema &schema)
+{
+    depth_ = 0;
+    key_.clear();
+    return payload && parse(payload, schema);
+}
+
+bool RequestParser::topLevel() const
+{
+    return depth_ == 1;
+}
+
+bool RequestParser::jsonObjectOpen()
+{
+    depth_++;
+    return true;
+}
+
+bool RequestParser::jsonObjectKey(const std::string &key)
+{
+    if (topLevel())
+        key_ = key;
+    return true;
+}
+
+bool RequestParser::jsonObjectClose()
+{
+    depth_--;
+    return true;
+}
+
+bool RequestParser::jsonArrayOpen()
+{
+    depth_++;
+    return true;
+}
+
+bool RequestParser::jsonArrayClose()
+{
+    depth_--;
+    return true;
+}
+
+bool RequestParser::jsonString(const std::string &s)
+{
+    return !topLevel() || onString(key_, s);
+}
+
+bool RequestParser::jsonNumber(const std::string &n)
+{
+    // only used with raw number conversion
+    return !topLevel() || onNumber(key_, std::strtoll(n.c_str(), nullptr, 10));
+}
+
+bool RequestParser::jsonNumber(int64_t number)
+{
+    return !topLevel() || onNumber(key_, number);
+}
+
+bool RequestParser::jsonNumber(double &number, ConversionResultFlags asFloat)
+{
+    if (!topLevel())
+        return true;
+    if (!std::isfinite(number))
+        return false;
+    // fractions are cut off like JValue::asNumber<int32_t>() does, out
+    // of range values stay out of range
+    if (std::fabs(number) > INT32_MAX + 1.0)
+        return onNumber(key_, number > 0 ? INT64_MAX : INT64_MIN);
+    return onNumber(key_, static_cast<int64_t>(number));
+}
+
+bool RequestParser::jsonBoolean(bool truth)
+{
+    return !topLevel() || onBoolean(key_, truth);
+}
+
+bool RequestParser::jsonNull()
+{
+    // same as an absent key
+    return true;
+}
+
+RequestParser::NumberType RequestParser::conversionToUse() const
+{
+    return JNUM_CONV_NATIVE;
+}
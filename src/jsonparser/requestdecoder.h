@@ -0,0 +1,202 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <pbnjson.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+/**
+ * \brief SAX parser for the top level fields of a request.
+ *
+ * Validates the payload against the schema while parsing and hands the
+ * scalar values of the top level object to the derived class, nested
+ * values are skipped. No DOM is built and errors are reported with the
+ * return value only.
+ */
+class RequestParser : public pbnjson::JParser
+{
+public:
+    RequestParser();
+    virtual ~RequestParser();
+
+    /**
+     * \brief Parse and validate a payload.
+     *
+     * \param[in] payload The request payload.
+     * \param[in] schema The compiled schema.
+     * \return False if the payload is invalid or a value has not been
+     *         accepted.
+     */
+    bool parsePayload(const char *payload, const pbnjson::JSchema &schema);
+
+protected:
+    /// Top level string value.
+    virtual bool onString(const std::string &key, const std::string &value) = 0;
+    /// Top level number value.
+    virtual bool onNumber(const std::string &key, int64_t value) = 0;
+    /// Top level boolean value.
+    virtual bool onBoolean(const std::string &key, bool value) = 0;
+
+    /// From JParser.
+    bool jsonObjectOpen() override;
+    bool jsonObjectKey(const std::string &key) override;
+    bool jsonObjectClose() override;
+    bool jsonArrayOpen() override;
+    bool jsonArrayClose() override;
+    bool jsonString(const std::string &s) override;
+    bool jsonNumber(const std::string &n) override;
+    bool jsonNumber(int64_t number) override;
+    bool jsonNumber(double &number, ConversionResultFlags asFloat) override;
+    bool jsonBoolean(bool truth) override;
+    bool jsonNull() override;
+    NumberType conversionToUse() const override;
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// Check if a value belongs to the top level object.
+    bool topLevel() const;
+
+    /// Nesting level of the current value.
+    int depth_ = 0;
+    /// Key of the current top level value.
+    std::string key_;
+};
+
+/**
+ * \brief Decoder of a request into a typed struct.
+ *
+ * The schema is compiled once when the decoder is created, decoding
+ * only sets the struct members of the known top level keys. Absent keys
+ * leave the members empty. A decoder may be shared between threads,
+ * every decode() uses a parser of its own.
+ */
+template<typename T>
+class RequestDecoder
+{
+public:
+    /// A request struct member.
+    using Member = std::variant<std::optional<std::string> T::*,
+        std::optional<int32_t> T::*, std::optional<bool> T::*>;
+
+    /// Binding of a top level key to a member.
+    struct Field {
+        const char *key;
+        Member member;
+    };
+
+    /**
+     * \brief Create decoder.
+     *
+     * \param[in] schema The JSON schema of the request.
+     * \param[in] fields The decoded fields.
+     */
+    RequestDecoder(const char *schema, std::vector<Field> fields) :
+        schema_(pbnjson::JSchema::fromString(schema)),
+        fields_(std::move(fields))
+    {
+        // nothing to be done here
+    }
+
+    /**
+     * \brief Decode a payload.
+     *
+     * \param[in] payload The request payload.
+     * \param[out] request The decoded request.
+     * \return False if the payload does not match the schema.
+     */
+    bool decode(const char *payload, T &request) const
+    {
+        request = T();
+        Parser parser(fields_, request);
+        return parser.parsePayload(payload, schema_);
+    }
+
+private:
+    /// Parser writing into one request.
+    class Parser : public RequestParser
+    {
+    public:
+        Parser(const std::vector<Field> &fields, T &request) :
+            fields_(fields),
+            request_(request)
+        {
+            // nothing to be done here
+        }
+
+    protected:
+        bool onString(const std::string &key, const std::string &value) override
+        {
+            return set<std::string>(key, value);
+        }
+
+        bool onNumber(const std::string &key, int64_t value) override
+        {
+            if (value < INT32_MIN || value > INT32_MAX)
+                return !find(key);
+            return set<int32_t>(key, static_cast<int32_t>(value));
+        }
+
+        bool onBoolean(const std::string &key, bool value) override
+        {
+            return set<bool>(key, value);
+        }
+
+    private:
+        /// Find the field of a key.
+        const Field *find(const std::string &key) const
+        {
+            for (const auto &field : fields_) {
+                if (!strcmp(field.key, key.c_str()))
+                    return &field;
+            }
+            return nullptr;
+        }
+
+        /// Set a member, unknown keys are ignored, a type mismatch
+        /// fails.
+        template<typename V>
+        bool set(const std::string &key, const V &value)
+        {
+            auto field = find(key);
+            if (!field)
+                return true;
+            auto member = std::get_if<std::optional<V> T::*>(&field->member);
+            if (!member)
+                return false;
+            request_.**member = value;
+            return true;
+        }
+
+        const std::vector<Field> &fields_;
+        T &request_;
+    };
+
+    /// Compiled schema.
+    pbnjson::JSchema schema_;
+    /// Decoded fields.
+    std::vector<Field> fields_;
+};
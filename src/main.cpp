@@ -47,6 +47,7 @@
 
 #include "mediaindexer.h"
 #include "logging.h"
+#include "performancechecker.h"
 
 #include <glib.h>
 #include <signal.h>
@@ -56,7 +57,7 @@
 #endif
 
 #if defined HAS_GSTREAMER
-#include <gst/gst.h>
+#include "metadataextractors/gstreamerpreloader.h"
 #endif
 
 #include <chrono>
@@ -89,7 +90,7 @@ static void signalHandler(int sigNum)
 #endif
 
 #if defined HAS_GSTREAMER
-    gst_deinit();
+    GStreamerPreloader::instance()->deinit();
 #endif
 
     exit(sigNum);
@@ -99,6 +100,11 @@ int main(int argc, char *argv[])
 {
     using namespace std::chrono_literals;
 
+#if PERFCHECK_ENABLE
+    // finished with the first device scan, see Device::scanLoop()
+    PERF_START("STARTUP");
+#endif
+
     // install signal handler
     //signal(SIGABRT, signalHandler);
     //signal(SIGINT, signalHandler);
@@ -110,7 +116,7 @@ int main(int argc, char *argv[])
     LOG_INFO(0, "//*****************************************//");
 
 #if defined HAS_GSTREAMER
-    gst_init(nullptr, nullptr);
+    GStreamerPreloader::instance()->init();
 #endif
 
     // we need the mainloop for the luna service and client as well as
@@ -131,7 +137,7 @@ int main(int argc, char *argv[])
 #endif
 
 #if defined HAS_GSTREAMER
-    gst_deinit();
+    GStreamerPreloader::instance()->deinit();
 #endif
 
     return 0;
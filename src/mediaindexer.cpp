@@ -22,6 +22,7 @@
 #include "dbconnector/devicedb.h"
 #include "dbconnector/mediadb.h"
 #include "dbconnector/settingsdb.h"
+#include "reconciler.h"
 #endif
 
 #include <iostream>
@@ -213,6 +214,12 @@ void MediaIndexer::deviceStateChanged(std::shared_ptr<Device> device)
     // start device media scan
     if (device->available()) {
         auto mdb = MediaDb::instance();
+#if defined HAS_LUNA
+        // known devices are injected from the db, until it is ready
+        // rely on the device cache and merge every write request
+        if (!DbConnector::isReady())
+            device->setNewMountedDevice(false);
+#endif
         mdb->unmarkAllDirty(device);
         device->scan(this);
 #if defined HAS_LUNA
@@ -298,6 +305,8 @@ void MediaIndexer::cleanupDevice(Device* device)
 {
     auto mdb = MediaDb::instance();
     mdb->removeDirty(device);
+    // check the result once the dirty items are gone
+    Reconciler::instance()->schedule(device->uri());
 }
 
 void MediaIndexer::flushUnflagDirty(Device* device)
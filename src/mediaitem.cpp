@@ -23,6 +23,9 @@
 #include <exception>
 #include <stdexcept>
 #include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
 
 std::vector<std::string> MediaItem::notSupportedExt_ = {
     "rv",
@@ -231,6 +234,8 @@ std::string MediaItem::metaToString(MediaItem::Meta meta)
         return std::string("geo_location_city");
     case MediaItem::Meta::LastModifiedDate:
         return std::string("last_modified_date");
+    case MediaItem::Meta::LastModifiedDateRaw:
+        return std::string("last_modified_date_raw");
     case MediaItem::Meta::FileSize:
         return std::string("file_size");
     case MediaItem::Meta::SampleRate:
@@ -253,6 +258,8 @@ std::string MediaItem::metaToString(MediaItem::Meta meta)
         return std::string("height");
     case MediaItem::Meta::FrameRate:
         return std::string("frame_rate");
+    case MediaItem::Meta::Trickplay:
+        return std::string("trickplay");
     case MediaItem::Meta::EOL:
         return "";
     default:
@@ -351,8 +358,9 @@ MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
         break;
     }
 
-    // generate random file name
-    thumbnailFileName_ = generateRandFilename() + THUMBNAIL_EXTENSION;
+    // thumbnail file name is stable for this media item revision
+    thumbnailId_ = generateThumbnailId();
+    thumbnailFileName_ = thumbnailId_ + THUMBNAIL_EXTENSION;
     
     if (type_ != Type::EOL)
         device_->incrementMediaItemCount(type_);
@@ -361,11 +369,12 @@ MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
 MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
                      const std::string &mime, unsigned long hash, unsigned long filesize,
                      const std::string &ext, const MediaItem::Type &type,
-                     const MediaItem::ExtractorType &extType)
+                     const MediaItem::ExtractorType &extType, std::time_t modifiedTime)
     : device_(device)
     , type_(type)
     , hash_(hash)
     , filesize_(filesize)
+    , modifiedTime_(modifiedTime)
     , parsed_(false)
     , uri_("")
     , mime_(mime)
@@ -381,8 +390,9 @@ MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
         uri_.append("/");
     uri_.append(path);
 
-    // generate random file name
-    thumbnailFileName_ = generateRandFilename() + THUMBNAIL_EXTENSION;
+    // thumbnail file name is stable for this media item revision
+    thumbnailId_ = generateThumbnailId();
+    thumbnailFileName_ = thumbnailId_ + THUMBNAIL_EXTENSION;
 
     if (type_ != Type::EOL)
         device_->incrementMediaItemCount(type_);
@@ -409,8 +419,9 @@ MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
 
     ext_ = path_.substr(path_.find_last_of('.') + 1);
 
-    // generate random file name
-    thumbnailFileName_ = generateRandFilename() + THUMBNAIL_EXTENSION;
+    // thumbnail file name is stable for this media item revision
+    thumbnailId_ = generateThumbnailId();
+    thumbnailFileName_ = thumbnailId_ + THUMBNAIL_EXTENSION;
 }
 
 MediaItem::MediaItem(const std::string &uri)
@@ -430,12 +441,16 @@ MediaItem::MediaItem(const std::string &uri)
         path_ = uri_.substr(sz);
         LOG_DEBUG("path_ : %s",path_.c_str());
         ext_ = path_.substr(path_.find_last_of('.') + 1);
-        auto fpath = std::filesystem::path(path_);
-        filesize_ = std::filesystem::file_size(fpath);
-        hash_ = std::filesystem::last_write_time(fpath).time_since_epoch().count();
+        struct stat st;
+        if (stat(path_.c_str(), &st) < 0)
+            throw std::runtime_error(std::string("stat failed: ") + strerror(errno));
+        filesize_ = static_cast<unsigned long>(st.st_size);
+        modifiedTime_ = st.st_mtime;
+        hash_ = hashFromModifiedTime(st.st_mtim);
 
-        // generate random file name
-        thumbnailFileName_ = generateRandFilename() + THUMBNAIL_EXTENSION;
+        // thumbnail file name is stable for this media item revision
+        thumbnailId_ = generateThumbnailId();
+        thumbnailFileName_ = thumbnailId_ + THUMBNAIL_EXTENSION;
 
         if (!MediaItem::mediaItemSupported(path_, mime_)) {
             LOG_ERROR(0, "Media Item %s is not supported by this system", path_.c_str());
@@ -459,6 +474,24 @@ MediaItem::MediaItem(const std::string &uri)
     }
 }
 
+MediaItem::~MediaItem()
+{
+    closeFile();
+}
+
+unsigned long MediaItem::hashFromModifiedTime(const struct timespec &mtime)
+{
+    using namespace std::chrono;
+    using FileDuration = std::filesystem::file_time_type::duration;
+    // the file clock epoch is not necessarily the unix epoch, the
+    // difference is a whole number of seconds so rounding is exact
+    static const auto epochDiff = round<seconds>(
+        std::filesystem::file_time_type::clock::now().time_since_epoch() -
+        system_clock::now().time_since_epoch());
+    auto sinceEpoch = seconds(mtime.tv_sec) + nanoseconds(mtime.tv_nsec) + epochDiff;
+    return static_cast<unsigned long>(duration_cast<FileDuration>(sinceEpoch).count());
+}
+
 bool MediaItem::putExtraMetaToJson(pbnjson::JValue &meta)
 {
     for (auto _meta = MediaItem::Meta::Track; _meta < MediaItem::Meta::EOL; ++_meta) {
@@ -488,6 +521,34 @@ unsigned long MediaItem::fileSize() const
     return filesize_;
 }
 
+std::time_t MediaItem::modifiedTime() const
+{
+    return modifiedTime_;
+}
+
+FILE *MediaItem::file()
+{
+    if (!file_) {
+        file_ = fopen(path_.c_str(), "rb");
+        if (!file_) {
+            LOG_ERROR(0, "Failed to open file %s, caused by : %s", path_.c_str(),
+                strerror(errno));
+            return nullptr;
+        }
+    } else {
+        rewind(file_);
+    }
+    return file_;
+}
+
+void MediaItem::closeFile()
+{
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
 const std::string &MediaItem::path() const
 {
     return path_;
@@ -595,6 +656,7 @@ bool MediaItem::isMediaMeta(Meta meta){
         case MediaItem::Meta::FileSize:
         case MediaItem::Meta::DateOfCreation:
         case MediaItem::Meta::LastModifiedDate:
+        case MediaItem::Meta::LastModifiedDateRaw:
             return true;
         default:
             return false;
@@ -612,6 +674,7 @@ bool MediaItem::isAudioMeta(Meta meta){
         case MediaItem::Meta::Thumbnail:
         case MediaItem::Meta::FileSize:
         case MediaItem::Meta::LastModifiedDate:
+        case MediaItem::Meta::LastModifiedDateRaw:
         case MediaItem::Meta::AlbumArtist:
         case MediaItem::Meta::Track:
         case MediaItem::Meta::TotalTracks:
@@ -639,9 +702,11 @@ bool MediaItem::isVideoMeta(Meta meta){
         case MediaItem::Meta::AudioCodec:
         case MediaItem::Meta::Thumbnail:
         case MediaItem::Meta::FrameRate:
+        case MediaItem::Meta::Trickplay:
         case MediaItem::Meta::FileSize:
         case MediaItem::Meta::DateOfCreation:
         case MediaItem::Meta::LastModifiedDate:
+        case MediaItem::Meta::LastModifiedDateRaw:
             return true;
         default:
             return false;
@@ -661,6 +726,7 @@ bool MediaItem::isImageMeta(Meta meta){
         case MediaItem::Meta::FileSize:
         case MediaItem::Meta::DateOfCreation:
         case MediaItem::Meta::LastModifiedDate:
+        case MediaItem::Meta::LastModifiedDateRaw:
             return true;
         default:
             return false;
@@ -668,14 +734,23 @@ bool MediaItem::isImageMeta(Meta meta){
     return false;
 }
 
-std::string MediaItem::generateRandFilename() const
+std::string MediaItem::generateThumbnailId() const
+{
+    std::string key = (device_ ? device_->uuid() : std::string()) + "\n" + path_ +
+        "\n" + std::to_string(hash_);
+    gchar *digest = g_compute_checksum_for_string(G_CHECKSUM_MD5, key.c_str(), key.size());
+    if (!digest) {
+        LOG_ERROR(0, "Failed to compute thumbnail id for '%s'", path_.c_str());
+        return std::to_string(hash_);
+    }
+    std::string id(digest);
+    g_free(digest);
+    return id;
+}
+
+const std::string &MediaItem::thumbnailId() const
 {
-    uint64_t val = 0;
-    std::ifstream fs("/dev/urandom", std::ios::in|std::ios::binary);
-    if (fs)
-        fs.read(reinterpret_cast<char *>(&val), sizeof(val));
-    fs.close();
-    return std::to_string(val).substr(0, thumbnailFileNameLength_);
+    return thumbnailId_;
 }
 
 std::string MediaItem::getThumbnailFileName() const
@@ -30,6 +30,7 @@
 #include <ctime>
 #include <iomanip>
 #include <vector>
+#include <cstdio>
 
 class Device;
 
@@ -90,6 +91,7 @@ public:
         BitPerSample, ///<Audio bit per sample.
         Lyric, ///< Audio Lyric.
         FrameRate, ///< Video framerate.
+        Trickplay, ///< Video seek preview sprite sheet index.
         EOL /// End of list marker.
     };
 
@@ -237,11 +239,13 @@ public:
      * \param[in] ext The media file extension.
      * \param[in] type The media item type.
      * \param[in] extType The extractor type.
+     * \param[in] modifiedTime The modification time as already known
+     * from the file-tree-walk, avoids a second stat() in the extractors.
      */
     MediaItem(std::shared_ptr<Device> device, const std::string &path,
               const std::string &mime, unsigned long hash, unsigned long filesize,
               const std::string &ext, const MediaItem::Type &type,
-              const MediaItem::ExtractorType &extType);
+              const MediaItem::ExtractorType &extType, std::time_t modifiedTime = 0);
 
     /**
      * \brief Construct media item only with uri.
@@ -258,7 +262,23 @@ public:
      */
     MediaItem(const std::string &uri);
 
-    virtual ~MediaItem() {};
+    virtual ~MediaItem();
+
+    /// The media item owns an open file handle, do not copy.
+    MediaItem(const MediaItem &) = delete;
+    MediaItem &operator=(const MediaItem &) = delete;
+
+    /**
+     * \brief Compute the media item hash from a file modification time.
+     *
+     * Gives the same value as the last_write_time() of
+     * std::filesystem so hashes stay compatible with cache and
+     * database while the caller only needs a single stat().
+     *
+     * \param[in] mtime The modification time from struct stat.
+     * \return The hash value.
+     */
+    static unsigned long hashFromModifiedTime(const struct timespec &mtime);
 
     /**
      * \brief put meta data of this media item to given json object.
@@ -290,6 +310,29 @@ public:
      */
      unsigned long fileSize() const;
 
+    /**
+     * \brief Get file modification time of media item.
+     *
+     * \return The modification time or 0 if unknown.
+     */
+    std::time_t modifiedTime() const;
+
+    /**
+     * \brief Get the read-only file handle of the media item.
+     *
+     * The file is opened on first request only and then shared by
+     * all extractors working on this media item, the handle is
+     * rewound to the beginning of the file before being returned.
+     *
+     * \return The file handle or nullptr if the file can't be opened.
+     */
+    FILE *file();
+
+    /**
+     * \brief Release the file handle once extraction has finished.
+     */
+    void closeFile();
+
     /**
      * \brief Give the path as set from constructor.
      *
@@ -403,11 +446,21 @@ public:
     bool isImageMeta(Meta meta);
 
     /**
-     *\brief Generate the random thumbnail file name of media item
+     *\brief Generate the thumbnail id of media item.
      *
-     * \return The thumbnail file name.
+     * The id is derived from device uuid, path and hash so the same
+     * media item revision always maps to the same thumbnail file.
+     *
+     * \return The thumbnail id, the file name without extension.
+     */
+    std::string generateThumbnailId() const;
+
+    /**
+     *\brief Get the thumbnail id of media item
+     *
+     * \return The thumbnail id.
      */
-    std::string generateRandFilename() const;
+    const std::string &thumbnailId() const;
 
     /**
      *\brief Get the thumbnail file name of media item
@@ -441,6 +494,10 @@ private:
     unsigned long hash_;
     /// filesize
     unsigned long filesize_;
+    /// file modification time
+    std::time_t modifiedTime_ = 0;
+    /// Opened file, shared between the extractors.
+    FILE *file_ = nullptr;
     /// If the media item has been parsed.
     bool parsed_;
     /// The media item uri.
@@ -455,9 +512,10 @@ private:
     ExtractorType extractorType_;
     /// Not supported ext
     static std::vector<std::string> notSupportedExt_;
+    /// The thumbnail id
+    std::string thumbnailId_;
     /// The thumbnail file name
     std::string thumbnailFileName_;
-    const int thumbnailFileNameLength_ = 15; 
 };
 
 /// Useful when iterating over enum.
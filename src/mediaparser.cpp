@@ -19,6 +19,7 @@
 #include "plugins/plugin.h"
 #include "metadataextractors/imetadataextractor.h"
 #include "dbconnector/mediadb.h"
+#include "configurator.h"
 #include <thread>
 #include <chrono>
 #include <condition_variable>
@@ -30,6 +31,8 @@ int MediaParser::runningThreads_ = 0;
 std::mutex MediaParser::lock_;
 std::unique_ptr<MediaParser> MediaParser::instance_;
 std::mutex MediaParser::ctorLock_;
+std::set<std::string> MediaParser::pendingThumbnails_;
+std::set<std::string> MediaParser::pendingTrickplays_;
 
 
 void MediaParser::enqueueTask(MediaItemPtr mediaItem)
@@ -48,6 +51,117 @@ void MediaParser::enqueueTask(MediaItemPtr mediaItem)
     }
 }
 
+void MediaParser::regenerateThumbnail(const std::string &uri)
+{
+    // replies of several clients may ask for the same thumbnail
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!pendingThumbnails_.insert(uri).second)
+            return;
+    }
+
+    MediaParser* mParser = MediaParser::instance();
+    GError *error = nullptr;
+    if (!g_thread_pool_push(mParser->thumbnailPool_,
+            static_cast<void*>(new std::string(uri)), &error)) {
+        LOG_ERROR(0, "Fail occurred in g_thread_pool_push");
+        if (error) {
+            LOG_ERROR(0, "Error Message : %s", error->message);
+            g_error_free(error);
+        }
+    }
+}
+
+void MediaParser::regenerate(void *data, void *user_data)
+{
+    std::unique_ptr<std::string> uri(static_cast<std::string *>(data));
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        pendingThumbnails_.erase(*uri);
+    }
+
+    try {
+        // the device might have been removed meanwhile
+        if (!Device::device(*uri)) {
+            LOG_DEBUG("No device for thumbnail regeneration of '%s'", uri->c_str());
+            return;
+        }
+
+        auto mi = std::make_unique<MediaItem>(*uri);
+        if (mi->type() == MediaItem::Type::EOL || *mi->path().begin() != '/') {
+            LOG_WARNING(0, "Thumbnail of '%s' can not be regenerated", uri->c_str());
+            return;
+        }
+
+        auto p = getType(mi->type(), mi->ext());
+        auto extractor = extractor_.find(p);
+        if (extractor == extractor_.end()) {
+            LOG_WARNING(0, "No extractor to regenerate thumbnail of '%s'", uri->c_str());
+            return;
+        }
+
+        LOG_INFO(0, "Regenerate thumbnail of '%s'", uri->c_str());
+        if (!extractor->second->extractThumbnail(*mi))
+            LOG_WARNING(0, "%s thumbnail generation failed!", uri->c_str());
+        mi->closeFile();
+    } catch (const std::exception & e) {
+        LOG_ERROR(0, "MediaParser::regenerate failure: %s", e.what());
+    } catch (...) {
+        LOG_ERROR(0, "MediaParser::regenerate failure by unexpected failure");
+    }
+}
+
+void MediaParser::generateTrickplay(const std::string &uri)
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!pendingTrickplays_.insert(uri).second)
+            return;
+    }
+
+    MediaParser* mParser = MediaParser::instance();
+    GError *error = nullptr;
+    if (!g_thread_pool_push(mParser->trickplayPool_,
+            static_cast<void*>(new std::string(uri)), &error)) {
+        LOG_ERROR(0, "Fail occurred in g_thread_pool_push");
+        if (error) {
+            LOG_ERROR(0, "Error Message : %s", error->message);
+            g_error_free(error);
+        }
+    }
+}
+
+void MediaParser::trickplay(void *data, void *user_data)
+{
+    std::unique_ptr<std::string> uri(static_cast<std::string *>(data));
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        pendingTrickplays_.erase(*uri);
+    }
+
+    try {
+        // the device might have been removed meanwhile
+        if (!Device::device(*uri))
+            return;
+
+        auto mi = std::make_unique<MediaItem>(*uri);
+        if (mi->type() != MediaItem::Type::Video || *mi->path().begin() != '/')
+            return;
+
+        auto extractor = extractor_.find(getType(mi->type(), mi->ext()));
+        if (extractor == extractor_.end())
+            return;
+
+        if (!extractor->second->extractTrickplay(*mi))
+            LOG_DEBUG("No trickplay for '%s'", uri->c_str());
+        mi->closeFile();
+    } catch (const std::exception & e) {
+        LOG_ERROR(0, "MediaParser::trickplay failure: %s", e.what());
+    } catch (...) {
+        LOG_ERROR(0, "MediaParser::trickplay failure by unexpected failure");
+    }
+}
+
 MediaParser *MediaParser::instance()
 {
     std::lock_guard<std::mutex> lk(ctorLock_);
@@ -63,6 +177,8 @@ MediaParser::~MediaParser()
     // anything here
     LOG_INFO(0, "MediaParser Dtor!!!");
     g_thread_pool_free(pool, TRUE, TRUE);
+    g_thread_pool_free(thumbnailPool_, TRUE, TRUE);
+    g_thread_pool_free(trickplayPool_, TRUE, TRUE);
     //mediaItem_.reset();
 }
 
@@ -70,6 +186,8 @@ MediaParser::MediaParser()
 {
     pool = g_thread_pool_new((GFunc) &MediaParser::extractMeta, this, PARALLEL_META_EXTRACTION, TRUE, NULL);
     g_thread_pool_set_max_unused_threads(PARALLEL_META_EXTRACTION);
+    thumbnailPool_ = g_thread_pool_new((GFunc) &MediaParser::regenerate, this, 1, FALSE, NULL);
+    trickplayPool_ = g_thread_pool_new((GFunc) &MediaParser::trickplay, this, 1, FALSE, NULL);
 
     // create each extractors
     for (auto type = MediaItem::ExtractorType::TagLibExtractor;
@@ -99,6 +217,25 @@ MediaItem::ExtractorType MediaParser::getType(MediaItem::Type type, const std::s
     return ret;
 }
 
+bool MediaParser::hasThumbnailVariants(MediaItem::Type type, const std::string &ext)
+{
+    // the extractors are created by the constructor
+    MediaParser::instance();
+    auto extractor = extractor_.find(getType(type, ext));
+    if (extractor == extractor_.end() || !extractor->second)
+        return false;
+    return extractor->second->hasThumbnailVariants();
+}
+
+bool MediaParser::canExtractThumbnail(MediaItem::Type type, const std::string &ext)
+{
+    // the extractors are created by the constructor
+    MediaParser::instance();
+    auto extractor = extractor_.find(getType(type, ext));
+    if (extractor == extractor_.end() || !extractor->second)
+        return false;
+    return extractor->second->canExtractThumbnail();
+}
 
 bool MediaParser::setMediaItem(std::string & uri)
 {
@@ -183,7 +320,13 @@ void MediaParser::extractMeta(void *data, void *user_data)
             MediaItem::ExtractorType p = mip->extractorType();
             if (!extractor_[p]->extractMeta(*mip)) {
                 LOG_WARNING(0, "%s meta data extraction failed!", mip->uri().c_str());
+            } else if (mip->type() == MediaItem::Type::Video &&
+                       Configurator::instance()->getTrickplay().enabled) {
+                generateTrickplay(mip->uri());
             }
+            // the item may stay buffered for a while until written to
+            // the database, do not keep the file open meanwhile
+            mip->closeFile();
         } else {
             auto plg = PluginFactory().plugin(mip->uri());
             plg->extractMeta(*mip);
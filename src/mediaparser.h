@@ -26,6 +26,7 @@
 #include <mutex>
 #include <queue>
 #include <list>
+#include <set>
 #include <atomic>
 #include <glib.h>
 
@@ -38,6 +39,28 @@ class MediaParser
 
     static void extractMeta(void *data, void *user_data);
 
+    /**
+     * \brief Generate the thumbnail of a media item again.
+     *
+     * Used for thumbnails removed by the storage quota and for variants
+     * generated on request, the media item is extracted in the
+     * background without a database update as the thumbnail file name
+     * does not change.
+     *
+     * \param[in] uri Uri of the media item.
+     */
+    static void regenerateThumbnail(const std::string &uri);
+
+    /**
+     * \brief Generate the seek preview sprite sheet of a video.
+     *
+     * Runs in the background on a single thread, the extractor keeps
+     * within the configured cpu budget.
+     *
+     * \param[in] uri Uri of the media item.
+     */
+    static void generateTrickplay(const std::string &uri);
+
     /**
      * \brief Get media parser object.
      *
@@ -47,6 +70,28 @@ class MediaParser
 
     static MediaItem::ExtractorType getType(MediaItem::Type type, const std::string &ext);
 
+    /**
+     * \brief Check if thumbnails of a media type can be regenerated.
+     *
+     * Only the extractors creating thumbnail variants can generate a
+     * removed thumbnail or a missing variant again.
+     *
+     * \param[in] type The media type.
+     * \param[in] ext The file extension.
+     * \return True if regenerateThumbnail() creates the thumbnail.
+     */
+    static bool hasThumbnailVariants(MediaItem::Type type, const std::string &ext);
+
+    /**
+     * \brief Check if a removed thumbnail of a media type can be
+     * generated again from the media file.
+     *
+     * \param[in] type The media type.
+     * \param[in] ext The file extension.
+     * \return True if regenerateThumbnail() creates the thumbnail.
+     */
+    static bool canExtractThumbnail(MediaItem::Type type, const std::string &ext);
+
     bool setMediaItem(std::string & uri);
 
     /// Construction is only allowed with media item.
@@ -63,6 +108,12 @@ class MediaParser
     /// Start new task, must be called with lock locked.
     static void runTask();
 
+    /// Thumbnail regeneration task.
+    static void regenerate(void *data, void *user_data);
+
+    /// Sprite sheet generation task.
+    static void trickplay(void *data, void *user_data);
+
     static std::unique_ptr<MediaParser> instance_;
     /// Queue of meta data extraction tasks.
     static std::queue<std::unique_ptr<MediaParser>> tasks_;
@@ -71,10 +122,18 @@ class MediaParser
     /// Make class static data thread safe.
     static std::mutex lock_;
     static std::mutex ctorLock_;
+    /// Media items queued for thumbnail regeneration, protected by lock_.
+    static std::set<std::string> pendingThumbnails_;
+    /// Videos queued for sprite sheet generation, protected by lock_.
+    static std::set<std::string> pendingTrickplays_;
     /// Meta data extrator.
     static std::map<MediaItem::ExtractorType,
            std::shared_ptr<IMetaDataExtractor>> extractor_;
     GThreadPool *pool = nullptr;
+    /// Single thread for thumbnail regeneration.
+    GThreadPool *thumbnailPool_ = nullptr;
+    /// Single thread for sprite sheet generation.
+    GThreadPool *trickplayPool_ = nullptr;
     std::mutex mediaItemLock_;
     /// The media item this media parser works on - extractMeta will
     /// modify it internally though it is otherwise consideren to be
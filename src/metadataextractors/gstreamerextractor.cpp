@@ -15,6 +15,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "gstreamerextractor.h"
+#include "thumbnailquota.h"
 #include <glib.h>
 #include <gst/gst.h>
 #include <png.h>
@@ -23,8 +24,19 @@
 #include <fstream>
 #include <csetjmp>
 #include <vector>
-
-#define CAPS "video/x-raw,format=RGBA,width=160,height=160,pixel-aspect-ratio=1/1"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined HAS_WEBP
+#include <webp/encode.h>
+#endif
+
+#define CAPS "video/x-raw,format=RGBA,width=%d,height=%d,pixel-aspect-ratio=1/1"
+#define TRICKPLAY_CAPS "video/x-raw,format=RGBA,width=%d,pixel-aspect-ratio=1/1"
 
 #define RETURN_AFTER_RELEASE(pipeline, uridecodebin, videosink, state, message) \
 do { \
@@ -36,6 +48,101 @@ do { \
     return false; \
 } while(0)
 
+/**
+ * \brief Per thread JPEG encoder.
+ *
+ * Keeps the TurboJPEG handle and the output buffer of a thread between
+ * thumbnails, the buffer only grows if a larger image is compressed.
+ */
+struct JpegEncoder
+{
+    ~JpegEncoder()
+    {
+        if (handle)
+            tjDestroy(handle);
+        if (buffer)
+            tjFree(buffer);
+    }
+
+    /// Make sure the buffer holds the worst case output of an image.
+    bool reserve(int32_t width, int32_t height, int32_t subsamp)
+    {
+        if (!handle && !(handle = tjInitCompress()))
+            return false;
+        unsigned long size = tjBufSize(width, height, subsamp);
+        if (size == static_cast<unsigned long>(-1))
+            return false;
+        if (size <= capacity)
+            return true;
+        if (buffer)
+            tjFree(buffer);
+        capacity = 0;
+        if (!(buffer = tjAlloc(size)))
+            return false;
+        capacity = size;
+        return true;
+    }
+
+    tjhandle handle = nullptr;
+    uint8_t *buffer = nullptr;
+    unsigned long capacity = 0;
+};
+
+static thread_local JpegEncoder jpegEncoder;
+
+/// Write a file so that it only becomes visible once it is complete.
+static bool writeComplete(const std::string &filename, const uint8_t *data, size_t size)
+{
+    auto slash = filename.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "." : filename.substr(0, slash);
+    auto writeAll = [data, size](int fd) {
+        size_t done = 0;
+        while (done < size) {
+            auto n = ::write(fd, data + done, size - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            done += n;
+        }
+        return true;
+    };
+
+    // an unnamed file is linked into the directory once it is written,
+    // file systems without O_TMPFILE use a temporary name instead
+    int fd = open(dir.c_str(), O_TMPFILE | O_WRONLY, 0644);
+    if (fd >= 0) {
+        std::string proc = "/proc/self/fd/" + std::to_string(fd);
+        if (!writeAll(fd)) {
+            close(fd);
+            return false;
+        }
+        bool ok = !linkat(AT_FDCWD, proc.c_str(), AT_FDCWD, filename.c_str(),
+            AT_SYMLINK_FOLLOW);
+        if (!ok && errno == EEXIST) {
+            unlink(filename.c_str());
+            ok = !linkat(AT_FDCWD, proc.c_str(), AT_FDCWD, filename.c_str(),
+                AT_SYMLINK_FOLLOW);
+        }
+        close(fd);
+        // without /proc the file can not be linked
+        if (ok)
+            return true;
+    }
+
+    std::string part = filename + ".part";
+    fd = open(part.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = writeAll(fd);
+    close(fd);
+    if (ok)
+        ok = !rename(part.c_str(), filename.c_str());
+    if (!ok)
+        unlink(part.c_str());
+    return ok;
+}
+
 std::map<std::string, MediaItem::Meta> GStreamerExtractor::metaMap_ = {
     {GST_TAG_TITLE,                     MediaItem::Meta::Title},
     {GST_TAG_GENRE,                     MediaItem::Meta::Genre},
@@ -155,6 +262,11 @@ bool GStreamerExtractor::extractMeta(MediaItem &mediaItem, bool extra) const
             setMeta(mediaItem, discoverInfo, GST_TAG_DATE_TIME);
             setMeta(mediaItem, discoverInfo, GST_TAG_VIDEO_CODEC);
             setMeta(mediaItem, discoverInfo, GST_TAG_AUDIO_CODEC);
+            // the sprite sheet is generated in the background
+            auto index = trickplayIndexPath(mediaItem);
+            std::error_code err;
+            if (std::filesystem::exists(index, err))
+                mediaItem.setMeta(MediaItem::Meta::Trickplay, index);
         }
         setStreamMeta(mediaItem, streamInfo, extra);
         break;
@@ -189,51 +301,119 @@ bool GStreamerExtractor::extractMeta(MediaItem &mediaItem, bool extra) const
     return ret;
 }
 
+bool GStreamerExtractor::extractThumbnail(MediaItem &mediaItem) const
+{
+    std::string filename;
+    return getThumbnail(mediaItem, filename, "jpg", true);
+}
+
+bool GStreamerExtractor::saveThumbnailVariant(void *data, int32_t width, int32_t height,
+                                              const ThumbnailVariant &variant,
+                                              const std::string &filename) const
+{
+    if (variant.size == width && variant.size == height)
+        return saveBufferToImage(data, width, height, 0, filename, variant.format,
+            variant.quality);
+
+    GdkPixbuf *frame = gdk_pixbuf_new_from_data(static_cast<guchar *>(data),
+        GDK_COLORSPACE_RGB, TRUE, 8, width, height, width * 4, nullptr, nullptr);
+    if (!frame) {
+        LOG_ERROR(0, "Failed to wrap frame for thumbnail variant '%s'", variant.name.c_str());
+        return false;
+    }
+
+    GdkPixbuf *scaled = gdk_pixbuf_scale_simple(frame, variant.size, variant.size,
+        GDK_INTERP_BILINEAR);
+    g_object_unref(frame);
+    if (!scaled) {
+        LOG_ERROR(0, "Failed to scale thumbnail variant '%s'", variant.name.c_str());
+        return false;
+    }
+
+    bool ret = saveBufferToImage(gdk_pixbuf_get_pixels(scaled), variant.size, variant.size,
+        gdk_pixbuf_get_rowstride(scaled), filename, variant.format, variant.quality);
+    g_object_unref(scaled);
+    return ret;
+}
+
 bool GStreamerExtractor::saveBufferToImage(void *data, int32_t width, int32_t height,
-                                  const std::string &filename, const std::string &ext) const
+                                  int32_t pitch, const std::string &filename,
+                                  const std::string &ext, int32_t quality) const
 {
-    auto writeData = [&](uint8_t *_data, uint32_t _dataSize) -> bool {
+    auto writeData = [&](uint8_t *_data, unsigned long _dataSize) -> bool {
         LOG_DEBUG("Save Attached Image, fullpath : %s",filename.c_str());
-        std::ofstream ofs(filename, std::ios_base::out | std::ios_base::binary);
-        ofs.write(reinterpret_cast<char *>(_data), _dataSize);
-        if (ofs.fail())
-        {
+        if (!writeComplete(filename, _data, _dataSize)) {
             LOG_ERROR(0, "Failed to write attached image %s to device", filename.c_str());
             return false;
         }
-        ofs.flush();
-        ofs.close();
-        tjFree(_data);
+        ThumbnailQuota::instance()->add(filename);
         return true;
     };
 
-    tjhandle tjInstance = NULL;
-    uint8_t *outData = NULL;
-    unsigned long outDataSize = 0;
+#if defined HAS_WEBP
+    if (ext == "webp") {
+        uint8_t *outData = nullptr;
+        size_t outDataSize = WebPEncodeRGBA(static_cast<uint8_t *>(data), width, height,
+            pitch ? pitch : width * 4, quality, &outData);
+        if (outDataSize == 0) {
+            LOG_ERROR(0, "WebP compression failed");
+            return false;
+        }
+        bool ret = writeData(outData, outDataSize);
+        WebPFree(outData);
+        return ret;
+    }
+#endif
+
     int32_t outSubSample = TJSAMP_420;
-    int32_t flag = TJFLAG_FASTDCT;
+    int32_t flag = TJFLAG_FASTDCT | TJFLAG_NOREALLOC;
     int32_t format = TJPF_RGBA;
-    int32_t quality = 75;
-    if ((tjInstance = tjInitCompress()) == NULL) {
+    if (!jpegEncoder.reserve(width, height, outSubSample)) {
         LOG_ERROR(0, "instance initialization failed");
         return false;
     }
 
-    // ext in this function parameter is always jpg.
-    if (tjCompress2(tjInstance, static_cast<uint8_t *>(data), width, 
-                    0, height, format, &outData, &outDataSize, outSubSample,
+    uint8_t *outData = jpegEncoder.buffer;
+    unsigned long outDataSize = jpegEncoder.capacity;
+    if (tjCompress2(jpegEncoder.handle, static_cast<uint8_t *>(data), width,
+                    pitch, height, format, &outData, &outDataSize, outSubSample,
                     quality, flag) < 0) {
-        LOG_ERROR(0, "Image compression failed");
+        LOG_ERROR(0, "Image compression failed: %s", tjGetErrorStr());
         return false;
     }
-    tjDestroy(tjInstance);  tjInstance = NULL;
     return writeData(outData, outDataSize);
 }
 
-bool GStreamerExtractor::getThumbnail(MediaItem &mediaItem, std::string &filename, const std::string &ext) const
+bool GStreamerExtractor::getThumbnail(MediaItem &mediaItem, std::string &filename, const std::string &ext,
+                                      bool allVariants) const
 {
     LOG_DEBUG("Thumbnail Image creation start");
 
+    // thumbnail names are derived from the media item revision, an
+    // existing file is still valid and does not need to be decoded again
+    std::string thumbnailPath = THUMBNAIL_DIRECTORY + mediaItem.uuid() + "/" +
+        mediaItem.getThumbnailFileName();
+    auto configurator = Configurator::instance();
+    std::vector<std::pair<const ThumbnailVariant *, std::string>> missing;
+    int32_t decodeSize = 0;
+    for (const auto &variant : configurator->getThumbnailVariants()) {
+        if (!variant.eager && !allVariants)
+            continue;
+        std::string path = configurator->thumbnailVariantPath(thumbnailPath, variant.name);
+        std::error_code err;
+        auto size = std::filesystem::file_size(path, err);
+        if (!err && size > 0)
+            continue;
+        missing.emplace_back(&variant, path);
+        decodeSize = std::max(decodeSize, static_cast<int32_t>(variant.size));
+    }
+
+    if (missing.empty()) {
+        LOG_DEBUG("Reuse existing thumbnail image '%s'", thumbnailPath.c_str());
+        filename = thumbnailPath;
+        return true;
+    }
+
     auto begin = std::chrono::high_resolution_clock::now();
     std::string uri = "file://";
     uri.append(mediaItem.path());
@@ -244,7 +424,7 @@ bool GStreamerExtractor::getThumbnail(MediaItem &mediaItem, std::string &filenam
     GstSample *sample;
     gchar *pipelineStr = nullptr;
     GError *error = nullptr;
-    gint64 duration, position;
+    gint64 duration = -1, position;
     GstStateChangeReturn ret;
     GstMapInfo map;
     gboolean res;
@@ -254,7 +434,7 @@ bool GStreamerExtractor::getThumbnail(MediaItem &mediaItem, std::string &filenam
                                    force-sw-decoders=true ! queue ! \
                                    videoconvert n-threads=4 ! videoscale ! \
                                    "" appsink name=video-sink \
-                                   caps=\"" CAPS "\"", uri.c_str());
+                                   caps=\"" CAPS "\"", uri.c_str(), decodeSize, decodeSize);
 
     thumbPipeline = gst_parse_launch(pipelineStr, &error);
     g_free(pipelineStr);
@@ -343,46 +523,90 @@ bool GStreamerExtractor::getThumbnail(MediaItem &mediaItem, std::string &filenam
     }
     gst_element_query_duration (thumbPipeline, GST_FORMAT_TIME, &duration);
 
-    if (duration != -1)
-        position = duration * 50 / 100;
-    else
-        position = 1 * GST_SECOND;
-    gst_element_seek(thumbPipeline, 1.0f, GST_FORMAT_TIME,
-                     GstSeekFlags(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT),
-                     GST_SEEK_TYPE_SET, position,
-                     GST_SEEK_TYPE_NONE, 0);
-    g_signal_emit_by_name (videoSink, "pull-preroll", &sample, NULL);
+    // the middle of the video comes first so the common case costs a
+    // single seek, the others are tried if that frame is black or flat
+    static const gint64 percent[THUMBNAIL_CANDIDATES] = { 50, 25, 75, 10 };
+    static const gint64 seconds[THUMBNAIL_CANDIDATES] = { 1, 5, 10, 30 };
+    GstSample *best = nullptr;
+    double bestValue = -1.0;
+    int tried = 0;
+    for (int i = 0; i < THUMBNAIL_CANDIDATES; ++i) {
+        if (duration != -1)
+            position = duration * percent[i] / 100;
+        else
+            position = seconds[i] * GST_SECOND;
+        if (!gst_element_seek(thumbPipeline, 1.0f, GST_FORMAT_TIME,
+                              GstSeekFlags(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT),
+                              GST_SEEK_TYPE_SET, position,
+                              GST_SEEK_TYPE_NONE, 0) && i > 0)
+            break;
+
+        sample = nullptr;
+        g_signal_emit_by_name (videoSink, "pull-preroll", &sample, NULL);
+        if (!sample)
+            continue;
+        ++tried;
+
+        GstCaps *caps = gst_sample_get_caps (sample);
+        GstStructure *s = caps ? gst_caps_get_structure (caps, 0) : nullptr;
+        if (!s || !gst_structure_get_int (s, "width", &width) ||
+            !gst_structure_get_int (s, "height", &height)) {
+            gst_sample_unref (sample);
+            continue;
+        }
+
+        GstBuffer *buffer = gst_sample_get_buffer (sample);
+        if (!buffer || !gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+            gst_sample_unref (sample);
+            continue;
+        }
+        auto score = scoreFrame(map.data, width, height);
+        gst_buffer_unmap (buffer, &map);
+
+        LOG_DEBUG("Thumbnail candidate at %" G_GINT64_FORMAT " ms: mean %.1f, stddev %.1f, "
+            "entropy %.2f", position / GST_MSECOND, score.mean, score.stddev, score.entropy);
+        if (score.value() > bestValue) {
+            if (best)
+                gst_sample_unref (best);
+            best = sample;
+            bestValue = score.value();
+        } else {
+            gst_sample_unref (sample);
+        }
+        if (score.acceptable())
+            break;
+    }
+
+    sample = best;
     if (sample) {
         GstBuffer *buffer;
         GstCaps *caps;
         GstStructure *s;
 
         caps = gst_sample_get_caps (sample);
-        if (!caps)
-            RETURN_AFTER_RELEASE(thumbPipeline, uridecodebin, videoSink, GST_STATE_NULL,
-                    "could not get snapshot format");
-
         s = gst_caps_get_structure (caps, 0);
-
         res = gst_structure_get_int (s, "width", &width);
-        res |= gst_structure_get_int (s, "height", &height);
-        if (!res)
-            RETURN_AFTER_RELEASE(thumbPipeline, uridecodebin, videoSink, GST_STATE_NULL,
-                    "could not get resolution information");
-
+        res &= gst_structure_get_int (s, "height", &height);
         buffer = gst_sample_get_buffer (sample);
-        gst_buffer_map (buffer, &map, GST_MAP_READ);
-
-        filename = THUMBNAIL_DIRECTORY + mediaItem.uuid() + "/" + mediaItem.getThumbnailFileName();
-        if (!saveBufferToImage(map.data, width, height, filename, ext)) {
+        if (!res || !gst_buffer_map (buffer, &map, GST_MAP_READ)) {
             gst_sample_unref (sample);
-            gst_buffer_unmap (buffer, &map);
             RETURN_AFTER_RELEASE(thumbPipeline, uridecodebin, videoSink, GST_STATE_NULL,
-                    "could not save thumbnail image");
+                    "could not get snapshot");
+        }
+
+        // every variant from this one decoded frame
+        bool saved = true;
+        for (const auto &[variant, path] : missing) {
+            if (!saveThumbnailVariant(map.data, width, height, *variant, path))
+                saved = false;
         }
 
-        gst_sample_unref (sample);
         gst_buffer_unmap (buffer, &map);
+        gst_sample_unref (sample);
+        if (!saved)
+            RETURN_AFTER_RELEASE(thumbPipeline, uridecodebin, videoSink, GST_STATE_NULL,
+                    "could not save thumbnail image");
+        filename = thumbnailPath;
     }
     else
     {
@@ -395,11 +619,238 @@ bool GStreamerExtractor::getThumbnail(MediaItem &mediaItem, std::string &filenam
 
     auto end = std::chrono::high_resolution_clock::now();
     auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin);
-    LOG_DEBUG("Thumbnail Image creation done, elapsed time = %d [ms]",
-            (int)(elapsedTime.count()));
+    LOG_DEBUG("Thumbnail Image creation done, %d candidates, elapsed time = %d [ms]",
+            tried, (int)(elapsedTime.count()));
+    return true;
+}
+
+std::string GStreamerExtractor::trickplayIndexPath(const MediaItem &mediaItem) const
+{
+    return THUMBNAIL_DIRECTORY + mediaItem.uuid() + "/" + mediaItem.thumbnailId() +
+        TRICKPLAY_INDEX_SUFFIX;
+}
+
+bool GStreamerExtractor::extractTrickplay(MediaItem &mediaItem) const
+{
+    const auto &config = Configurator::instance()->getTrickplay();
+    if (!config.enabled || mediaItem.type() != MediaItem::Type::Video)
+        return false;
+
+    // the names follow the thumbnail id, a changed file gets new ones
+    std::string spriteName = mediaItem.thumbnailId() + TRICKPLAY_SPRITE_SUFFIX;
+    std::string spritePath = THUMBNAIL_DIRECTORY + mediaItem.uuid() + "/" + spriteName;
+    std::string indexPath = trickplayIndexPath(mediaItem);
+    std::error_code err;
+    if (std::filesystem::exists(spritePath, err) && std::filesystem::exists(indexPath, err)) {
+        mediaItem.setMeta(MediaItem::Meta::Trickplay, indexPath);
+        return true;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::string uri = "file://";
+    uri.append(mediaItem.path());
+    gchar *pipelineStr = g_strdup_printf("uridecodebin uri=\"%s\" name=uridecodebin "
+        "force-sw-decoders=true ! queue ! videoconvert ! videoscale ! "
+        "appsink name=video-sink sync=false caps=\"" TRICKPLAY_CAPS "\"",
+        uri.c_str(), config.tileWidth);
+    GError *error = nullptr;
+    GstElement *pipeline = gst_parse_launch(pipelineStr, &error);
+    g_free(pipelineStr);
+    if (error) {
+        LOG_ERROR(0, "Failed to establish trickplay pipeline, Error Message : %s",
+            error->message);
+        g_error_free(error);
+        if (pipeline)
+            gst_object_unref(pipeline);
+        return false;
+    }
+    if (!pipeline)
+        return false;
+
+    GstElement *videoSink = gst_bin_get_by_name(GST_BIN(pipeline), "video-sink");
+    if (!videoSink) {
+        LOG_ERROR(0, "Failed to get video sink");
+        gst_object_unref(pipeline);
+        return false;
+    }
+
+    auto release = [&]() -> void {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_object_unref(videoSink);
+        gst_object_unref(pipeline);
+    };
+
+    gint64 duration = -1;
+    if (gst_element_set_state(pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE ||
+        gst_element_get_state(pipeline, NULL, NULL, 5 * GST_SECOND) != GST_STATE_CHANGE_SUCCESS ||
+        !gst_element_query_duration(pipeline, GST_FORMAT_TIME, &duration) || duration <= 0) {
+        LOG_WARNING(0, "Can not walk '%s' for trickplay", uri.c_str());
+        release();
+        return false;
+    }
+
+    // long videos get a longer interval instead of a larger sheet
+    gint64 interval = config.interval * GST_SECOND;
+    if (duration / interval >= config.maxTiles)
+        interval = duration / config.maxTiles + 1;
+    int expected = static_cast<int>((duration + interval - 1) / interval);
+    int columns = std::min(config.columns, expected);
+
+    std::vector<uint8_t> sheet;
+    std::vector<gint64> timestamps;
+    gint tileWidth = 0, tileHeight = 0;
+    GstClockTime last = GST_CLOCK_TIME_NONE;
+    std::chrono::steady_clock::duration busy(0);
+    for (gint64 position = 0; position < duration &&
+         static_cast<int>(timestamps.size()) < expected; position += interval) {
+        auto frameBegin = std::chrono::steady_clock::now();
+        // key unit seeks decode the next keyframe only
+        if (!gst_element_seek(pipeline, 1.0f, GST_FORMAT_TIME,
+                GstSeekFlags(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT |
+                    GST_SEEK_FLAG_SNAP_AFTER),
+                GST_SEEK_TYPE_SET, position, GST_SEEK_TYPE_NONE, 0))
+            break;
+
+        GstSample *sample = nullptr;
+        g_signal_emit_by_name(videoSink, "pull-preroll", &sample, NULL);
+        if (!sample)
+            break;
+
+        GstBuffer *buffer = gst_sample_get_buffer(sample);
+        GstCaps *caps = gst_sample_get_caps(sample);
+        GstStructure *st = caps ? gst_caps_get_structure(caps, 0) : nullptr;
+        gint width = 0, height = 0;
+        GstMapInfo map;
+        if (buffer && st && gst_structure_get_int(st, "width", &width) &&
+            gst_structure_get_int(st, "height", &height) && width > 0 && height > 0 &&
+            gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+            if (!tileWidth) {
+                tileWidth = width;
+                tileHeight = height;
+                int rows = (expected + columns - 1) / columns;
+                sheet.assign(static_cast<size_t>(columns) * tileWidth * rows * tileHeight * 4, 0);
+            }
+
+            // sparse keyframes make several positions snap to one frame
+            auto pts = GST_BUFFER_PTS(buffer);
+            size_t rowBytes = static_cast<size_t>(tileWidth) * 4;
+            if (width == tileWidth && height == tileHeight && pts != last &&
+                map.size >= rowBytes * tileHeight) {
+                size_t i = timestamps.size();
+                size_t x = (i % columns) * tileWidth;
+                size_t y = (i / columns) * tileHeight;
+                size_t sheetRow = static_cast<size_t>(columns) * tileWidth;
+                for (gint r = 0; r < tileHeight; ++r)
+                    memcpy(&sheet[((y + r) * sheetRow + x) * 4], map.data + r * rowBytes,
+                        rowBytes);
+                timestamps.push_back((GST_CLOCK_TIME_IS_VALID(pts) ? pts : position) /
+                    GST_MSECOND);
+                last = pts;
+            }
+            gst_buffer_unmap(buffer, &map);
+        }
+        gst_sample_unref(sample);
+
+        // stay within the cpu budget, decoding runs in the streaming
+        // threads so the wall time of a frame is what it costs
+        auto spent = std::chrono::steady_clock::now() - frameBegin;
+        busy += spent;
+        std::this_thread::sleep_for(spent * (100 - config.cpuBudget) / config.cpuBudget);
+    }
+    release();
+
+    if (timestamps.empty()) {
+        LOG_WARNING(0, "No trickplay frames found in '%s'", uri.c_str());
+        return false;
+    }
+
+    int rows = static_cast<int>((timestamps.size() + columns - 1) / columns);
+    if (!saveBufferToImage(sheet.data(), columns * tileWidth, rows * tileHeight, 0,
+            spritePath, "jpg", config.quality))
+        return false;
+
+    auto times = pbnjson::Array();
+    for (auto t : timestamps)
+        times.append(static_cast<int64_t>(t));
+    auto index = pbnjson::Object();
+    index.put("sprite", spriteName);
+    index.put("tileWidth", tileWidth);
+    index.put("tileHeight", tileHeight);
+    index.put("columns", columns);
+    index.put("timestamps", times);
+
+    // the index is written last, readers rely on the sprite sheet
+    std::string tmp = indexPath + ".tmp";
+    std::ofstream ofs(tmp, std::ios_base::out | std::ios_base::trunc);
+    ofs << index.stringify();
+    ofs.close();
+    if (ofs.fail() || std::rename(tmp.c_str(), indexPath.c_str())) {
+        LOG_ERROR(0, "Failed to write trickplay index '%s'", indexPath.c_str());
+        std::remove(tmp.c_str());
+        return false;
+    }
+    mediaItem.setMeta(MediaItem::Meta::Trickplay, indexPath);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+    auto decode = std::chrono::duration_cast<std::chrono::milliseconds>(busy).count();
+    auto bytes = std::filesystem::file_size(spritePath, err);
+    LOG_INFO(0, "Trickplay of '%s': %zu frames in %lld ms (%.1f frames/s decoding), "
+        "%.0f bytes per hour", uri.c_str(), timestamps.size(), (long long) elapsed,
+        decode ? timestamps.size() * 1000.0 / decode : 0.0,
+        err ? 0.0 : bytes * 3600.0 * GST_SECOND / duration);
     return true;
 }
 
+bool GStreamerExtractor::FrameScore::acceptable() const
+{
+    return mean >= THUMBNAIL_MIN_LUMA && mean <= THUMBNAIL_MAX_LUMA &&
+        stddev >= THUMBNAIL_MIN_STDDEV && entropy >= THUMBNAIL_MIN_ENTROPY;
+}
+
+double GStreamerExtractor::FrameScore::value() const
+{
+    // entropy separates detailed frames from fades, the deviation
+    // breaks ties between flat frames
+    return entropy + stddev / 64.0;
+}
+
+GStreamerExtractor::FrameScore GStreamerExtractor::scoreFrame(const uint8_t *data,
+    int32_t width, int32_t height) const
+{
+    FrameScore score;
+    size_t pixels = static_cast<size_t>(width) * height;
+    if (!data || !pixels)
+        return score;
+
+    // BT.601 luma in fixed point, the loop has no branches so the
+    // compiler vectorizes it
+    std::vector<uint8_t> luma(pixels);
+    uint64_t sum = 0, sumSq = 0;
+    for (size_t i = 0; i < pixels; ++i) {
+        const uint8_t *p = data + i * 4;
+        uint32_t y = (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+        luma[i] = static_cast<uint8_t>(y);
+        sum += y;
+        sumSq += y * y;
+    }
+
+    uint32_t histogram[32] = {};
+    for (auto y : luma)
+        ++histogram[y >> 3];
+
+    score.mean = static_cast<double>(sum) / pixels;
+    auto variance = static_cast<double>(sumSq) / pixels - score.mean * score.mean;
+    score.stddev = variance > 0.0 ? std::sqrt(variance) : 0.0;
+    for (auto count : histogram) {
+        if (!count)
+            continue;
+        double p = static_cast<double>(count) / pixels;
+        score.entropy -= p * std::log2(p);
+    }
+    return score;
+}
+
 
 MediaItem::Meta GStreamerExtractor::metaFromTag(const char *gstTag) const
 {
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "imetadataextractor.h"
+#include "configurator.h"
 
 #if defined HAS_GSTREAMER
 #include <gst/gst.h>
@@ -31,6 +32,22 @@
 
 #define GST_TAG_THUMBNAIL "thumbnail"
 
+/// File name suffix of the seek preview sprite sheet.
+#define TRICKPLAY_SPRITE_SUFFIX ".trickplay.jpg"
+/// File name suffix of the seek preview sprite sheet index.
+#define TRICKPLAY_INDEX_SUFFIX ".trickplay.json"
+
+/// Number of video frames tried for a meaningful thumbnail.
+#define THUMBNAIL_CANDIDATES 4
+/// Frames with a darker mean luma are rejected as black.
+#define THUMBNAIL_MIN_LUMA 24
+/// Frames with a brighter mean luma are rejected as white.
+#define THUMBNAIL_MAX_LUMA 232
+/// Frames with less luma standard deviation are rejected as flat.
+#define THUMBNAIL_MIN_STDDEV 12.0
+/// Frames with less luma histogram entropy in bits are rejected.
+#define THUMBNAIL_MIN_ENTROPY 3.0
+
 /**
  * \brief Media parser class for meta data extraction.
  *
@@ -56,6 +73,25 @@ public:
     /// From interface.
     bool extractMeta(MediaItem &mediaItem, bool extra = false) const;
 
+    /// From interface.
+    bool extractThumbnail(MediaItem &mediaItem) const;
+
+    /// From interface.
+    bool hasThumbnailVariants() const { return true; }
+
+    /**
+     * \brief Generate the seek preview sprite sheet of a video.
+     *
+     * Seeks from keyframe to keyframe every configured interval within
+     * one pipeline session, so only keyframes are decoded, and tiles
+     * the frames into one JPEG sprite sheet. A JSON index next to it
+     * lists the tile geometry and the timestamp of every tile.
+     *
+     * \param[in] mediaItem The media item.
+     * \return False if no sprite sheet is available.
+     */
+    bool extractTrickplay(MediaItem &mediaItem) const;
+
 private:
     /// Get message id.
     LOG_MSGID;
@@ -63,12 +99,60 @@ private:
     /// Get media item meta identifier from GStreamer tag.
     MediaItem::Meta metaFromTag(const char *gstTag) const;
 
-    /// Get Thumbnail Image of video
-    bool getThumbnail(MediaItem &mediaItem, std::string &filename, const std::string &ext = "jpg") const;
+    /**
+     * \brief Get Thumbnail Image of video.
+     *
+     * The frame is decoded once in the size of the largest missing
+     * thumbnail variant and scaled down for the others. Up to
+     * THUMBNAIL_CANDIDATES positions are tried until a frame that is
+     * not black or flat is found, else the best one is taken.
+     *
+     * \param[in] mediaItem The media item.
+     * \param[out] filename The default thumbnail file.
+     * \param[in] ext Format of the default thumbnail.
+     * \param[in] allVariants Also create variants generated on request.
+     */
+    bool getThumbnail(MediaItem &mediaItem, std::string &filename, const std::string &ext = "jpg",
+                      bool allVariants = false) const;
+
+    /// Information content of a decoded frame.
+    struct FrameScore {
+        /// Mean luma.
+        double mean = 0.0;
+        /// Luma standard deviation.
+        double stddev = 0.0;
+        /// Entropy of the luma histogram in bits.
+        double entropy = 0.0;
+
+        /// Check if the frame is good enough to stop looking.
+        bool acceptable() const;
+        /// Rank of the frame among candidates, higher is better.
+        double value() const;
+    };
+
+    /**
+     * \brief Score a decoded RGBA frame.
+     *
+     * Black, faded and solid colour frames get a low score.
+     *
+     * \param[in] data The frame.
+     * \param[in] width The frame width.
+     * \param[in] height The frame height.
+     * \return The score.
+     */
+    FrameScore scoreFrame(const uint8_t *data, int32_t width, int32_t height) const;
+
+    /// Get the sprite sheet index file of a media item.
+    std::string trickplayIndexPath(const MediaItem &mediaItem) const;
+
+    /// Scale a decoded RGBA frame to the variant size and save it.
+    bool saveThumbnailVariant(void *data, int32_t width, int32_t height,
+                              const ThumbnailVariant &variant, const std::string &filename) const;
 
-    /// Save Image to jpeg with libjpeg-turbo
-    bool saveBufferToImage(void *data, int32_t width, int32_t height,
-                                  const std::string &filename, const std::string &ext = "jpg") const;
+    /// Save RGBA image to jpeg with libjpeg-turbo or to webp with libwebp.
+    bool saveBufferToImage(void *data, int32_t width, int32_t height, int32_t pitch,
+                           const std::string &filename, const std::string &ext = "jpg",
+                           int32_t quality = 75) const;
 
     /// Set media item media per media type.
     void setMeta(MediaItem &mediaItem, GstDiscovererInfo *metaInfo,
@@ -0,0 +1,277 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "gstreamerpreloader.h"
+#include "configurator.h"
+
+#include <gst/pbutils/pbutils.h>
+#include <glib/gstdio.h>
+
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/// Plugins every GStreamer extraction needs.
+static const char *basePlugins[] = {
+    "coreelements", "typefindfunctions", "playback", "app", "pbtypes",
+    "videoconvert", "videoscale", "videoconvertscale", "audioconvert",
+    "audioresample", "id3demux", "apetag", "audioparsers", "videoparsersbad",
+    "libav"
+};
+
+/// Demuxer and decoder plugins by file extension.
+static const std::map<std::string, std::vector<const char *>> extensionPlugins = {
+    { "mp3", { "mpg123" } },
+    { "mp2", { "mpg123" } },
+    { "ogg", { "ogg", "vorbis", "opus", "theora" } },
+    { "aac", { } },
+    { "wav", { "wavparse" } },
+    { "3gp", { "isomp4" } },
+    { "3g2", { "isomp4" } },
+    { "k3g", { "isomp4" } },
+    { "f4v", { "isomp4" } },
+    { "m4v", { "isomp4" } },
+    { "mov", { "isomp4" } },
+    { "mp4", { "isomp4" } },
+    { "avi", { "avi" } },
+    { "divx", { "avi" } },
+    { "flv", { "flv" } },
+    { "mkv", { "matroska" } },
+    { "webm", { "matroska", "vpx", "opus", "vorbis" } },
+    { "mpeg", { "mpegpsdemux" } },
+    { "mpg", { "mpegpsdemux" } },
+    { "ps", { "mpegpsdemux" } },
+    { "ts", { "mpegtsdemux" } },
+    { "wmv", { "asf" } }
+};
+
+std::unique_ptr<GStreamerPreloader> GStreamerPreloader::instance_;
+
+GStreamerPreloader *GStreamerPreloader::instance()
+{
+    if (!instance_.get())
+        instance_.reset(new GStreamerPreloader());
+    return instance_.get();
+}
+
+GStreamerPreloader::GStreamerPreloader()
+{
+    // nothing to be done here
+}
+
+GStreamerPreloader::~GStreamerPreloader()
+{
+    if (task_.joinable())
+        task_.join();
+}
+
+std::set<std::string> GStreamerPreloader::allowedPlugins()
+{
+    auto configurator = Configurator::instance();
+    std::set<std::string> allowed(std::begin(basePlugins), std::end(basePlugins));
+    for (const auto &[ext, typeInfo] : configurator->getSupportedExtensions()) {
+        if (typeInfo.first != MediaItem::Type::Audio &&
+            typeInfo.first != MediaItem::Type::Video)
+            continue;
+        auto plugins = extensionPlugins.find(configurator->toLower(ext));
+        if (plugins != extensionPlugins.end())
+            allowed.insert(plugins->second.begin(), plugins->second.end());
+    }
+    for (const auto &plugin : configurator->getGStreamer().plugins)
+        allowed.insert(plugin);
+    return allowed;
+}
+
+void GStreamerPreloader::init()
+{
+    const auto &config = Configurator::instance()->getGStreamer();
+    auto begin = std::chrono::steady_clock::now();
+
+    // an explicitly set registry or plugin path wins
+    std::set<std::string> allowed = allowedPlugins();
+    bool pluginPath = getenv("GST_PLUGIN_SYSTEM_PATH_1_0") ||
+        getenv("GST_PLUGIN_SYSTEM_PATH");
+    bool trimmed = false;
+    if (config.trimRegistry) {
+        g_mkdir_with_parents(CACHE_DIRECTORY, 0755);
+        setenv("GST_REGISTRY", GST_PRELOAD_REGISTRY, 0);
+        if (!pluginPath)
+            trimmed = usePluginDir(allowed);
+    }
+    gst_init(nullptr, nullptr);
+
+    if (config.trimRegistry && !trimmed) {
+        trimRegistry(allowed);
+        if (!pluginPath)
+            writePluginDir(allowed);
+    }
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+    LOG_INFO(0, "GStreamer initialized in %lld ms", static_cast<long long>(ms));
+
+    if (config.preload)
+        task_ = std::thread(&GStreamerPreloader::preload, this, std::move(allowed));
+}
+
+void GStreamerPreloader::deinit()
+{
+    if (task_.joinable())
+        task_.join();
+    gst_deinit();
+}
+
+bool GStreamerPreloader::usePluginDir(const std::set<std::string> &allowed) const
+{
+    std::ifstream list(GST_PRELOAD_PLUGIN_LIST);
+    std::set<std::string> linked;
+    for (std::string name; std::getline(list, name); )
+        linked.insert(name);
+    if (!list.eof() || linked != allowed || !fs::is_directory(GST_PRELOAD_PLUGIN_DIR))
+        return false;
+
+    setenv("GST_PLUGIN_SYSTEM_PATH_1_0", GST_PRELOAD_PLUGIN_DIR, 1);
+    LOG_INFO(0, "GStreamer plugins scanned from '%s'", GST_PRELOAD_PLUGIN_DIR);
+    return true;
+}
+
+void GStreamerPreloader::writePluginDir(const std::set<std::string> &allowed) const
+{
+    std::error_code err;
+    fs::remove(GST_PRELOAD_PLUGIN_LIST, err);
+    fs::remove_all(GST_PRELOAD_PLUGIN_DIR, err);
+    if (!fs::create_directories(GST_PRELOAD_PLUGIN_DIR, err)) {
+        LOG_WARNING(0, "Failed to create '%s': %s", GST_PRELOAD_PLUGIN_DIR,
+            err.message().c_str());
+        return;
+    }
+
+    // the links follow updates of the plugin files, gstreamer rescans
+    // them when their modification time changes
+    GList *plugins = gst_registry_get_plugin_list(gst_registry_get());
+    int linked = 0;
+    for (GList *l = plugins; l; l = l->next) {
+        auto plugin = GST_PLUGIN(l->data);
+        const gchar *file = gst_plugin_get_filename(plugin);
+        if (!file || allowed.find(gst_plugin_get_name(plugin)) == allowed.end())
+            continue;
+        fs::path target(file);
+        fs::create_symlink(target, fs::path(GST_PRELOAD_PLUGIN_DIR) /
+            target.filename(), err);
+        if (err) {
+            LOG_WARNING(0, "Failed to link plugin '%s': %s", file,
+                err.message().c_str());
+            continue;
+        }
+        linked++;
+    }
+    gst_plugin_list_free(plugins);
+
+    std::ofstream list(GST_PRELOAD_PLUGIN_LIST);
+    for (const auto &name : allowed)
+        list << name << std::endl;
+    if (!list) {
+        LOG_WARNING(0, "Failed to write '%s'", GST_PRELOAD_PLUGIN_LIST);
+        fs::remove(GST_PRELOAD_PLUGIN_LIST, err);
+        return;
+    }
+
+    // the registry file still holds the full scan, the next start
+    // writes it again from the linked plugins only
+    const char *registry = getenv("GST_REGISTRY");
+    if (registry && !strcmp(registry, GST_PRELOAD_REGISTRY))
+        fs::remove(GST_PRELOAD_REGISTRY, err);
+    LOG_INFO(0, "GStreamer plugin directory written, %d plugins linked", linked);
+}
+
+void GStreamerPreloader::trimRegistry(const std::set<std::string> &allowed) const
+{
+    auto registry = gst_registry_get();
+    GList *plugins = gst_registry_get_plugin_list(registry);
+    int removed = 0;
+    for (GList *l = plugins; l; l = l->next) {
+        auto plugin = GST_PLUGIN(l->data);
+        if (allowed.find(gst_plugin_get_name(plugin)) != allowed.end())
+            continue;
+        gst_registry_remove_plugin(registry, plugin);
+        removed++;
+    }
+    gst_plugin_list_free(plugins);
+    LOG_INFO(0, "GStreamer registry trimmed, %d plugins removed", removed);
+}
+
+void GStreamerPreloader::preload(std::set<std::string> allowed) const
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    // loading a feature loads its plugin, referencing the class runs the
+    // class initialization that otherwise happens with the first element
+    GList *factories = gst_element_factory_list_get_elements(
+        GST_ELEMENT_FACTORY_TYPE_DEMUXER | GST_ELEMENT_FACTORY_TYPE_PARSER |
+        GST_ELEMENT_FACTORY_TYPE_DECODER, GST_RANK_MARGINAL);
+    int loaded = 0;
+    for (GList *l = factories; l; l = l->next) {
+        auto factory = GST_ELEMENT_FACTORY(l->data);
+        const gchar *plugin = gst_plugin_feature_get_plugin_name(GST_PLUGIN_FEATURE(factory));
+        const gchar *klass = gst_element_factory_get_metadata(factory,
+            GST_ELEMENT_METADATA_KLASS);
+        if (!plugin || allowed.find(plugin) == allowed.end() ||
+            (klass && strstr(klass, "Hardware")))
+            continue;
+
+        auto feature = gst_plugin_feature_load(GST_PLUGIN_FEATURE(factory));
+        if (!feature)
+            continue;
+        GType type = gst_element_factory_get_element_type(GST_ELEMENT_FACTORY(feature));
+        if (type)
+            g_type_class_unref(g_type_class_ref(type));
+        gst_object_unref(feature);
+        loaded++;
+    }
+    gst_plugin_feature_list_free(factories);
+
+    // the pipelines of the extractors are built per item, build them
+    // once so their elements are initialized
+    GError *error = nullptr;
+    GstElement *pipeline = gst_parse_launch("uridecodebin name=uridecodebin ! "
+        "videoconvert ! videoscale ! appsink name=videosink", &error);
+    if (error) {
+        LOG_WARNING(0, "Failed to build thumbnail pipeline: %s", error->message);
+        g_error_free(error);
+        error = nullptr;
+    }
+    if (pipeline)
+        gst_object_unref(pipeline);
+
+    GstDiscoverer *discoverer = gst_discoverer_new(GST_SECOND, &error);
+    if (error) {
+        LOG_WARNING(0, "Failed to create discoverer: %s", error->message);
+        g_error_free(error);
+    }
+    if (discoverer)
+        g_object_unref(discoverer);
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+    LOG_INFO(0, "GStreamer preload done, %d features in %lld ms", loaded,
+        static_cast<long long>(ms));
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <gst/gst.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+
+/// Private GStreamer registry of the service.
+#define GST_PRELOAD_REGISTRY CACHE_DIRECTORY "gstreamer-registry.bin"
+/// Links to the allowed plugin files, the plugin scan path of the service.
+#define GST_PRELOAD_PLUGIN_DIR CACHE_DIRECTORY "gstreamer-plugins"
+/// Allowed plugin names the links have been made for.
+#define GST_PRELOAD_PLUGIN_LIST CACHE_DIRECTORY "gstreamer-plugins.list"
+
+/**
+ * \brief GStreamer start up of the service.
+ *
+ * Initializes GStreamer and, if configured, restricts the registry to
+ * the plugins the supported file extensions need. The registry is
+ * kept in a file of its own so other GStreamer users on the system
+ * do not invalidate it.
+ *
+ * The first start scans all plugins and links the allowed plugin files
+ * into a directory of the service. Later starts use that directory as
+ * the plugin system path, so only the allowed plugins are scanned and
+ * the registry file holds only them. A changed list of allowed plugins
+ * takes one more full scan.
+ *
+ * The demuxer, parser and software decoder features are then loaded on
+ * a background thread, together with one throwaway pipeline of each
+ * kind the extractors build. That way the first device scan after boot
+ * does not pay for plugin loading and class initialization.
+ */
+class GStreamerPreloader
+{
+public:
+    /**
+     * \brief Get the preloader.
+     *
+     * \return Singleton object.
+     */
+    static GStreamerPreloader *instance();
+
+    virtual ~GStreamerPreloader();
+
+    /// Initialize GStreamer and start the preload.
+    void init();
+
+    /// Wait for the preload and deinitialize GStreamer.
+    void deinit();
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// Singleton.
+    GStreamerPreloader();
+
+    /// Plugins needed for the supported extensions.
+    static std::set<std::string> allowedPlugins();
+
+    /**
+     * \brief Scan only the linked plugins.
+     *
+     * \param[in] allowed Plugins needed for the supported extensions.
+     * \return False if the links are missing or for other plugins.
+     */
+    bool usePluginDir(const std::set<std::string> &allowed) const;
+
+    /// Link the allowed plugin files for the next start.
+    void writePluginDir(const std::set<std::string> &allowed) const;
+
+    /// Remove all other plugins from the registry.
+    void trimRegistry(const std::set<std::string> &allowed) const;
+
+    /// Load the features and build the pipelines.
+    void preload(std::set<std::string> allowed) const;
+
+    /// The singleton.
+    static std::unique_ptr<GStreamerPreloader> instance_;
+
+    /// Background preload.
+    std::thread task_;
+};
@@ -14,7 +14,11 @@
 //
 // SPDX-License-Identifier: Apache-2.0
 #include "imageextractor.h"
+#include <libexif/exif-loader.h>
+#include <unistd.h>
+#include <cstdlib>
 #define PNG_BYTES_TO_CHECK 8
+#define BMP_HEADER_SIZE 26
 #define MSGID "IMAGEEXTRACTOR"
 LOG_MSGID
 
@@ -68,7 +72,7 @@ bool setJpegImageResolution(MediaItem &mediaItem, void *ctx)
         jmp_buf setjmpBuffer;
     } jpeg_error_handler;
 
-    FILE *fp = fopen(mediaItem.path().c_str(), "rb");
+    FILE *fp = mediaItem.file();
     if(fp == NULL) {
          LOG_ERROR(0, "Failed to open file %s", mediaItem.path().c_str());
          return false;
@@ -80,7 +84,6 @@ bool setJpegImageResolution(MediaItem &mediaItem, void *ctx)
     if(setjmp(jpeg_error_handler.setjmpBuffer)) {
         LOG_ERROR(0, "error while reading JPEG file");
         jpeg_destroy_decompress(&cinfo);
-        fclose(fp);
         return false;
     }
     jpeg_create_decompress(&cinfo);
@@ -89,7 +92,6 @@ bool setJpegImageResolution(MediaItem &mediaItem, void *ctx)
     mediaItem.setMeta(MediaItem::Meta::Width, MediaItem::MetaData(cinfo.image_width));
     mediaItem.setMeta(MediaItem::Meta::Height, MediaItem::MetaData(cinfo.image_height));
     jpeg_destroy_decompress(&cinfo);
-    fclose(fp);
     //auto end = std::chrono::high_resolution_clock::now();
     //auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin);
     //LOG_DEBUG("elapsed time = %d", (int)(elapsedTime.count()));
@@ -99,16 +101,41 @@ bool setJpegImageResolution(MediaItem &mediaItem, void *ctx)
 bool setBmpImageResolution(MediaItem &mediaItem, void *ctx)
 {
     //auto begin = std::chrono::high_resolution_clock::now();
-    gint width, height;
+    gint width = 0, height = 0;
     auto fname = mediaItem.path().c_str();
-    if (gdk_pixbuf_get_file_info(fname, &width, &height)) {
-        LOG_DEBUG("set width/height of bmp file for %s, (%d, %d)", fname, width, height);
-        mediaItem.setMeta(MediaItem::Meta::Width, MediaItem::MetaData(width));
-        mediaItem.setMeta(MediaItem::Meta::Height, MediaItem::MetaData(height));
-    } else {
-        LOG_ERROR(0, "Failed to get information from bmp %s", fname);
-        return false;
+    unsigned char buf[BMP_HEADER_SIZE];
+    FILE *fp = mediaItem.file();
+    // the resolution is part of the bitmap header, parse it directly
+    // from the already opened file instead of probing by file name
+    if (fp && fread(buf, 1, BMP_HEADER_SIZE, fp) == BMP_HEADER_SIZE &&
+        buf[0] == 'B' && buf[1] == 'M') {
+        auto le16 = [](const unsigned char *p) -> std::uint32_t {
+            return p[0] | (p[1] << 8);
+        };
+        auto le32 = [](const unsigned char *p) -> std::uint32_t {
+            return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+        };
+        auto dibSize = le32(buf + 14);
+        if (dibSize == 12) {
+            // OS/2 BITMAPCOREHEADER
+            width = static_cast<gint>(le16(buf + 18));
+            height = static_cast<gint>(le16(buf + 20));
+        } else if (dibSize >= 40) {
+            // BITMAPINFOHEADER and later, negative height is top-down
+            width = static_cast<std::int32_t>(le32(buf + 18));
+            height = std::abs(static_cast<std::int32_t>(le32(buf + 22)));
+        }
     }
+    if (width <= 0 || height <= 0) {
+        LOG_DEBUG("Unknown bmp header for %s, fall back to gdk-pixbuf", fname);
+        if (!gdk_pixbuf_get_file_info(fname, &width, &height)) {
+            LOG_ERROR(0, "Failed to get information from bmp %s", fname);
+            return false;
+        }
+    }
+    LOG_DEBUG("set width/height of bmp file for %s, (%d, %d)", fname, width, height);
+    mediaItem.setMeta(MediaItem::Meta::Width, MediaItem::MetaData(width));
+    mediaItem.setMeta(MediaItem::Meta::Height, MediaItem::MetaData(height));
     //auto end = std::chrono::high_resolution_clock::now();
     //auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin);
     //LOG_DEBUG("elapsed time = %d", (int)(elapsedTime.count()));
@@ -120,7 +147,7 @@ bool setPngImageResolution(MediaItem &mediaItem, void *ctx)
     //auto begin = std::chrono::high_resolution_clock::now();
     unsigned char buf[PNG_BYTES_TO_CHECK];
     auto fname = mediaItem.path().c_str();
-    FILE *fp = fopen(fname, "rb");
+    FILE *fp = mediaItem.file();
     if (fp == NULL) {
         LOG_ERROR(0, "Failed to read file %s", fname);
         return false;
@@ -158,10 +185,8 @@ bool setPngImageResolution(MediaItem &mediaItem, void *ctx)
         mediaItem.setMeta(MediaItem::Meta::Width, MediaItem::MetaData(width));
         mediaItem.setMeta(MediaItem::Meta::Height, MediaItem::MetaData(height));
         png_destroy_read_struct(&pngPtr, &infoPtr, NULL);
-        fclose(fp);
     } else {
         LOG_ERROR(0, "png_sig_cmp failed");
-        fclose(fp);
         return false;
     }
     //auto end = std::chrono::high_resolution_clock::now();
@@ -169,7 +194,6 @@ bool setPngImageResolution(MediaItem &mediaItem, void *ctx)
     //LOG_DEBUG("elapsed time = %d", (int)(elapsedTime.count()));
     return true;
 png_read_failure:
-    fclose(fp);
     return false;
 }
 
@@ -177,15 +201,22 @@ bool setGifImageResolution(MediaItem &mediaItem, void *ctx)
 {
     //auto begin = std::chrono::high_resolution_clock::now();
     int err;
-    auto fname = mediaItem.path().c_str();
-    GifFileType* gifFileType = DGifOpenFileName(fname, &err);
-    if (!gifFileType) {
-        LOG_ERROR(0, "DGifOpenFileName() failed - %s", GifErrorString(err));
+    FILE *fp = mediaItem.file();
+    if (fp == NULL) {
+        LOG_ERROR(0, "Failed to read file %s", mediaItem.path().c_str());
         return false;
     }
-    if (DGifSlurp(gifFileType) == GIF_ERROR) {
-        LOG_ERROR(0, "DGifSlurp() failed - %s", GifErrorString(gifFileType->Error));
-        DGifCloseFile(gifFileType, &err);
+    // giflib takes ownership of the descriptor, hand over a duplicate
+    int fd = dup(fileno(fp));
+    if (fd < 0) {
+        LOG_ERROR(0, "Failed to duplicate file descriptor for %s", mediaItem.path().c_str());
+        return false;
+    }
+    // the logical screen descriptor is read on open already, no need
+    // to slurp all image frames just for the resolution
+    GifFileType* gifFileType = DGifOpenFileHandle(fd, &err);
+    if (!gifFileType) {
+        LOG_ERROR(0, "DGifOpenFileHandle() failed - %s", GifErrorString(err));
         return false;
     }
     mediaItem.setMeta(MediaItem::Meta::Width, MediaItem::MetaData((std::uint32_t)gifFileType->SWidth));
@@ -282,8 +313,23 @@ bool ImageExtractor::setDefaultMeta(MediaItem &mediaItem, bool extra) const
 
 bool ImageExtractor::getExifData(MediaItem &mediaItem) const
 {
-    auto fname = mediaItem.path().c_str();
-    exifData_ = exif_data_new_from_file(fname);
+    FILE *fp = mediaItem.file();
+    if (!fp)
+        return false;
+
+    // feed the loader from the shared file handle, it stops reading
+    // as soon as the exif block has been found
+    ExifLoader *loader = exif_loader_new();
+    if (!loader)
+        return false;
+    unsigned char buf[1024];
+    size_t size;
+    while ((size = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        if (!exif_loader_write(loader, buf, size))
+            break;
+    }
+    exifData_ = exif_loader_get_data(loader);
+    exif_loader_unref(loader);
 
     if (exifData_)
         return true;
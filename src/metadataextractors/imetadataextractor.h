@@ -50,13 +50,56 @@ public:
      */
     virtual bool extractMeta(MediaItem &mediaItem, bool extra = false) const = 0;
 
+    /**
+     * \brief Generate the thumbnail files of a media item.
+     *
+     * Also generates the thumbnail variants configured to be created
+     * on request only.
+     *
+     * \param[in] mediaItem The media item.
+     * \return False if no thumbnail has been generated.
+     */
+    virtual bool extractThumbnail(MediaItem &mediaItem) const
+    {
+        return false;
+    }
+
+    /**
+     * \brief Check if a removed thumbnail can be generated again.
+     *
+     * \return True if extractThumbnail() creates the thumbnail.
+     */
+    virtual bool canExtractThumbnail() const
+    {
+        return hasThumbnailVariants();
+    }
+
+    /**
+     * \brief Check if thumbnails can be generated again.
+     *
+     * \return True if extractThumbnail() creates the thumbnail and its
+     * variants.
+     */
+    virtual bool hasThumbnailVariants() const
+    {
+        return false;
+    }
+
+    /**
+     * \brief Generate the seek preview sprite sheet of a media item.
+     *
+     * \param[in] mediaItem The media item.
+     * \return False if no sprite sheet has been generated.
+     */
+    virtual bool extractTrickplay(MediaItem &mediaItem) const
+    {
+        return false;
+    }
+
 
     /// Get base filename from mediaItem
     virtual std::string baseFilename(MediaItem &mediaItem, bool noExt = false, std::string delimeter = "//") const;
 
-    /// Get random filename for attached image
-    virtual std::string randFilename() const;
-
     /// Get extension from mediaItem
     virtual std::string extension(MediaItem &mediaItem) const;
 
@@ -70,6 +113,13 @@ public:
      */
     virtual std::string lastModifiedDate(MediaItem &mediaItem, bool localTime = false) const;
 
+    /**
+     * \brief Gives us the last modified date in seconds since the epoch.
+     * \param[in] mediaItem mediaitem.
+     * \return The modification time, 0 on error.
+     */
+    virtual std::int64_t lastModifiedTime(MediaItem &mediaItem) const;
+
     void setMetaCommon(MediaItem &mediaItem) const;
 
 protected:
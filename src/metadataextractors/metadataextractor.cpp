@@ -21,7 +21,6 @@
 #include "logging.h"
 
 #include <cinttypes>
-#include <fstream>
 #include <iostream>
 #include <string.h>
 #include <errno.h>
@@ -67,20 +66,6 @@ std::string IMetaDataExtractor::baseFilename(MediaItem &mediaItem, bool noExt, s
     return ret;
 }
 
-/// Get random filename for attached image
-std::string IMetaDataExtractor::randFilename() const
-{
-    size_t size = TAGLIB_FILE_NAME_SIZE-1;
-    uint64_t val = 0;
-    std::ifstream fs("/dev/urandom", std::ios::in|std::ios::binary);
-    if (fs)
-    {
-        fs.read(reinterpret_cast<char *>(&val), sizeof(val));
-    }
-    fs.close();
-    return std::to_string(val).substr(0, size);
-}
-
 /// Get extension from mediaItem
 std::string IMetaDataExtractor::extension(MediaItem &mediaItem) const
 {
@@ -92,37 +77,57 @@ std::string IMetaDataExtractor::extension(MediaItem &mediaItem) const
     return ret;
 }
 
-std::string IMetaDataExtractor::lastModifiedDate(MediaItem &mediaItem, bool localTime) const
+std::int64_t IMetaDataExtractor::lastModifiedTime(MediaItem &mediaItem) const
 {
     std::string path = mediaItem.path();
     if (path.empty())
     {
         LOG_ERROR(0, "Invalid media item path");
-        return "";
+        return 0;
     }
 
-    struct stat fStatus;
-    if (stat(path.c_str(), &fStatus) < 0) {
-        LOG_ERROR(0, "stat error, caused by : %s", strerror(errno));
-        return "";
+    // the file-tree-walk already did the stat(), only fall back to
+    // it for media items created without that information
+    std::time_t modified = mediaItem.modifiedTime();
+    if (!modified) {
+        struct stat fStatus;
+        if (stat(path.c_str(), &fStatus) < 0) {
+            LOG_ERROR(0, "stat error, caused by : %s", strerror(errno));
+            return 0;
+        }
+        modified = fStatus.st_mtime;
     }
-    std::stringstream ss;
-    std::time_t timeFormatted = fStatus.st_mtime;
+    return modified;
+}
+
+std::string IMetaDataExtractor::lastModifiedDate(MediaItem &mediaItem, bool localTime) const
+{
+    std::time_t timeFormatted = lastModifiedTime(mediaItem);
+    if (!timeFormatted)
+        return "";
+
+    struct tm tmFormatted;
     if (localTime)
-    {
-        ss << std::put_time(std::localtime(&timeFormatted), "%c %Z");
-        LOG_DEBUG("Return time with formatted value %s", ss.str().c_str());
-        return ss.str();
+        localtime_r(&timeFormatted, &tmFormatted);
+    else
+        gmtime_r(&timeFormatted, &tmFormatted);
+
+    char buf[64];
+    if (!strftime(buf, sizeof(buf), "%c %Z", &tmFormatted)) {
+        LOG_ERROR(0, "Failed to format last modified date");
+        return "";
     }
-    ss << std::put_time(std::gmtime(&timeFormatted), "%c %Z");
-    LOG_DEBUG("Return time with formatted value %s", ss.str().c_str());
-    return ss.str();
+    LOG_DEBUG("Return time with formatted value %s", buf);
+    return std::string(buf);
 }
 
 void IMetaDataExtractor::setMetaCommon(MediaItem &mediaItem) const
 {
     std::string modified = lastModifiedDate(mediaItem, false);
+    std::int64_t modifiedRaw = lastModifiedTime(mediaItem);
     std::int64_t filesize = mediaItem.fileSize();
     mediaItem.setMeta(MediaItem::Meta::LastModifiedDate, modified);
+    // the formatted date does not sort, lists are ordered by this one
+    mediaItem.setMeta(MediaItem::Meta::LastModifiedDateRaw, modifiedRaw);
     mediaItem.setMeta(MediaItem::Meta::FileSize, filesize);
 }
@@ -14,6 +14,7 @@
 //
 // SPDX-License-Identifier: Apache-2.0
 #include "taglibextractor.h"
+#include "thumbnailquota.h"
 #include <tag.h>
 #include <fileref.h>
 #include <mpegfile.h>
@@ -26,18 +27,68 @@
 #include <tstring.h>
 #include <tfile.h>
 #include <attachedpictureframe.h>
+#include <id3v2framefactory.h>
 #include <textidentificationframe.h>
 #include <xiphcomment.h>
 #include <oggfile.h>
 #include <vorbisfile.h>
 #include <fstream>
 #include <cinttypes>
+#include <cstdlib>
 
 using namespace std;
 using namespace TagLib;
 using namespace TagLib::ID3v2;
 using namespace TagLib::Ogg;
 
+namespace {
+
+/**
+ * \brief Read-only view of a stream starting at an offset.
+ *
+ * Lets TagLib read the audio properties of a MPEG file without parsing
+ * the ID3v2 tag in front of the audio data again.
+ */
+class OffsetStream : public TagLib::IOStream
+{
+public:
+    OffsetStream(TagLib::IOStream *stream, long offset) :
+        stream_(stream),
+        offset_(offset)
+    {
+        stream_->seek(offset_);
+    }
+
+    FileName name() const override { return stream_->name(); }
+    ByteVector readBlock(unsigned long length) override { return stream_->readBlock(length); }
+    void writeBlock(const ByteVector &) override {}
+    void insert(const ByteVector &, unsigned long = 0, unsigned long = 0) override {}
+    void removeBlock(unsigned long = 0, unsigned long = 0) override {}
+    bool readOnly() const override { return true; }
+    bool isOpen() const override { return stream_->isOpen(); }
+    void clear() override { stream_->clear(); }
+    long length() override { return stream_->length() - offset_; }
+    void truncate(long) override {}
+
+    void seek(long offset, Position p = Beginning) override
+    {
+        if (p == Beginning)
+            stream_->seek(offset_ + offset);
+        else
+            stream_->seek(offset, p);
+        if (stream_->tell() < offset_)
+            stream_->seek(offset_);
+    }
+
+    long tell() const override { return stream_->tell() - offset_; }
+
+private:
+    TagLib::IOStream *stream_;
+    long offset_;
+};
+
+} // namespace
+
 TaglibExtractor::TaglibExtractor()
 {
     // nothing to be done here
@@ -73,42 +124,57 @@ std::string TaglibExtractor::saveAttachedImage(MediaItem &mediaItem, TagLib::ID3
     std::string of = "";
     if (tag->frameListMap().contains("APIC"))
     {
-        std::string ext = "";
         ID3v2::AttachedPictureFrame *frame
             = dynamic_cast<TagLib::ID3v2::AttachedPictureFrame*>(tag->frameListMap()["APIC"].front());
-        if (frame->mimeType().find(EXT_JPG) || frame->mimeType().find(EXT_JPG))
-            ext = EXT_JPG;
-        else if (frame->mimeType().find(EXT_PNG))
-            ext = EXT_PNG;
-
-        auto device = mediaItem.device();
-        if (device.get()) {
-            if (!device->createThumbnailDirectory()) {
-                LOG_ERROR(0, "Failed to create Thumbnail directory for UUID %s", mediaItem.uuid().c_str());
-            }
-        } else {
-            LOG_ERROR(0, "Invalid device for creating thumbnail directory for UUID %s", mediaItem.uuid().c_str());
-        }
+        of = savePicture(mediaItem, frame->mimeType().to8Bit(), frame->picture().data(),
+            frame->picture().size(), fname);
+    }
+    return of;
+}
 
-        std::string thumbnailName = fname + "." + ext;
-        of = TAGLIB_BASE_DIRECTORY + mediaItem.uuid() + "/" + thumbnailName;
-        mediaItem.setThumbnailFileName(thumbnailName);
+std::string TaglibExtractor::savePicture(MediaItem &mediaItem, const std::string &mime,
+    const char *data, size_t size, const std::string &fname) const
+{
+    std::string ext = "";
+    if (mime.find(EXT_JPG) || mime.find(EXT_JPG))
+        ext = EXT_JPG;
+    else if (mime.find(EXT_PNG))
+        ext = EXT_PNG;
 
-        LOG_DEBUG("Save Attached Image, fullpath : %s",of.c_str());
-        std::ofstream ofs(of, ios_base::out | ios_base::binary);
-        ofs.write(frame->picture().data(), frame->picture().size());
-        if (ofs.fail())
-        {
-            LOG_ERROR(0, "Failed to write attached image %s to device", of.c_str());
-            return std::string();
+    auto device = mediaItem.device();
+    if (device.get()) {
+        if (!device->createThumbnailDirectory()) {
+            LOG_ERROR(0, "Failed to create Thumbnail directory for UUID %s", mediaItem.uuid().c_str());
         }
-        ofs.flush();
-        ofs.close();
+    } else {
+        LOG_ERROR(0, "Invalid device for creating thumbnail directory for UUID %s", mediaItem.uuid().c_str());
     }
+
+    std::string thumbnailName = fname + "." + ext;
+    std::string of = TAGLIB_BASE_DIRECTORY + mediaItem.uuid() + "/" + thumbnailName;
+    mediaItem.setThumbnailFileName(thumbnailName);
+
+    std::error_code err;
+    auto fileSize = std::filesystem::file_size(of, err);
+    if (!err && fileSize == size) {
+        LOG_DEBUG("Reuse existing attached image %s", of.c_str());
+        return of;
+    }
+
+    LOG_DEBUG("Save Attached Image, fullpath : %s",of.c_str());
+    std::ofstream ofs(of, ios_base::out | ios_base::binary);
+    ofs.write(data, size);
+    if (ofs.fail())
+    {
+        LOG_ERROR(0, "Failed to write attached image %s to device", of.c_str());
+        return std::string();
+    }
+    ofs.flush();
+    ofs.close();
+    ThumbnailQuota::instance()->add(of);
     return of;
 }
 
-
 bool TaglibExtractor::extractMeta(MediaItem &mediaItem, bool extra) const
 {
     std::string uri(mediaItem.path());
@@ -122,9 +188,34 @@ bool TaglibExtractor::extractMeta(MediaItem &mediaItem, bool extra) const
         uri.c_str(), MediaItem::mediaTypeToString(mediaItem.type()).c_str());
 
     setMetaCommon(mediaItem);
+
+    // read through the already opened media file, the stream owns the
+    // descriptor it is given so hand over a duplicate
+    FILE *fp = mediaItem.file();
+    if (!fp) {
+        LOG_ERROR(0, "Failed to open file %s", uri.c_str());
+        return false;
+    }
+    TagLib::FileStream stream(dup(fileno(fp)), true);
+    if (!stream.isOpen()) {
+        LOG_ERROR(0, "Failed to create file stream for %s", uri.c_str());
+        return false;
+    }
+
+    FileTypes types = NotDefined;
     if (uri.rfind(EXT_MP3) != std::string::npos)
+        types = Mp3;
+    else if (uri.rfind(EXT_OGG) != std::string::npos)
+        types = Ogg;
+
+    if (types != NotDefined && extractNative(mediaItem, &stream, fileno(fp), types, extra))
+        return true;
+    // the native reader might have moved the stream
+    stream.seek(0);
+
+    if (types == Mp3)
     {
-        TagLib::MPEG::File f(uri.c_str());
+        TagLib::MPEG::File f(&stream, ID3v2::FrameFactory::instance());
         ID3v2::Tag *tag = f.ID3v2Tag();
         LOG_DEBUG("Setting Meta data for Mp3");
         setMetaFromFile(mediaItem, &f, Mp3, extra);
@@ -136,9 +227,9 @@ bool TaglibExtractor::extractMeta(MediaItem &mediaItem, bool extra) const
         setMetaFromTag(mediaItem, tag, Mp3, extra);
         LOG_DEBUG("Setting Meta data for Mp3 Done");
     }
-    else if (uri.rfind(EXT_OGG) != std::string::npos)
+    else if (types == Ogg)
     {
-        TagLib::Vorbis::File oggf(uri.c_str());
+        TagLib::Vorbis::File oggf(&stream);
         Ogg::XiphComment *tag = oggf.tag();
         LOG_DEBUG("Setting Meta data for Ogg");
         setMetaFromFile(mediaItem, &oggf, Ogg, extra);
@@ -157,6 +248,138 @@ bool TaglibExtractor::extractMeta(MediaItem &mediaItem, bool extra) const
     return true;
 }
 
+bool TaglibExtractor::extractThumbnail(MediaItem &mediaItem) const
+{
+    std::string uri(mediaItem.path());
+
+    // only the pictures of mp3 files are stored as thumbnail
+    if (uri.rfind(EXT_MP3) == std::string::npos)
+        return false;
+
+    FILE *fp = mediaItem.file();
+    if (!fp) {
+        LOG_ERROR(0, "Failed to open file %s", uri.c_str());
+        return false;
+    }
+
+    std::string outImagePath;
+    std::string baseName = mediaItem.thumbnailId();
+    TagReader reader(fileno(fp));
+    TagReader::Tags tags;
+    if (reader.readId3(tags)) {
+        if (tags.picture)
+            outImagePath = savePicture(mediaItem, tags.pictureMime,
+                reinterpret_cast<const char *>(tags.picture), tags.pictureSize, baseName);
+    } else {
+        TagLib::FileStream stream(dup(fileno(fp)), true);
+        TagLib::MPEG::File f(&stream, ID3v2::FrameFactory::instance());
+        ID3v2::Tag *tag = f.ID3v2Tag();
+        if (tag)
+            outImagePath = saveAttachedImage(mediaItem, tag, baseName);
+    }
+
+    if (outImagePath.empty())
+        return false;
+    LOG_DEBUG("Extracted Image has been saved in %s", outImagePath.c_str());
+    return true;
+}
+
+bool TaglibExtractor::extractNative(MediaItem &mediaItem, TagLib::IOStream *stream,
+    int fd, FileTypes types, bool extra) const
+{
+    TagReader reader(fd);
+    TagReader::Tags tags;
+
+    if (types == Mp3) {
+        if (!reader.readId3(tags) || reader.audioOffset() >= stream->length())
+            return false;
+        LOG_DEBUG("Setting Meta data for Mp3");
+        TagReader::StreamInfo info;
+        if (reader.readMpeg(info)) {
+            setMetaFromStreamInfo(mediaItem, info, "MPEG-1 Layer 3 (MP3)", extra);
+        } else {
+            // VBR without header, TagLib is only used for the audio
+            // properties and does not see the ID3v2 tag
+            OffsetStream audio(stream, reader.audioOffset());
+            TagLib::MPEG::File f(&audio, ID3v2::FrameFactory::instance());
+            if (!f.isValid() || !f.audioProperties())
+                return false;
+            setMetaFromFile(mediaItem, &f, Mp3, extra);
+        }
+        setMetaFromTags(mediaItem, tags, Mp3, extra);
+        LOG_DEBUG("Setting Meta data for Mp3 Done");
+        return true;
+    }
+
+    TagReader::StreamInfo info;
+    if (!reader.readVorbis(tags, info))
+        return false;
+    LOG_DEBUG("Setting Meta data for Ogg");
+    setMetaFromStreamInfo(mediaItem, info, "Vorbis", extra);
+    setMetaFromTags(mediaItem, tags, Ogg, extra);
+    LOG_DEBUG("Setting Meta data for Ogg Done");
+    return true;
+}
+
+void TaglibExtractor::setMetaFromStreamInfo(MediaItem &mediaItem,
+    const TagReader::StreamInfo &info, const std::string &codec, bool extra) const
+{
+    if (!extra) {
+        mediaItem.setMeta(MediaItem::Meta::Duration, {info.duration});
+    } else {
+        mediaItem.setMeta(MediaItem::Meta::SampleRate, {info.sampleRate});
+        mediaItem.setMeta(MediaItem::Meta::BitRate, {info.bitRate});
+        mediaItem.setMeta(MediaItem::Meta::Channels, {info.channels});
+        mediaItem.setMeta(MediaItem::Meta::AudioCodec, {codec});
+    }
+}
+
+void TaglibExtractor::setMetaFromTags(MediaItem &mediaItem, const TagReader::Tags &tags,
+    FileTypes types, bool extra) const
+{
+    bool empty = tags.title.empty() && tags.artist.empty() && tags.album.empty() &&
+        tags.albumArtist.empty() && tags.genre.empty() && tags.date.empty() &&
+        tags.track.empty() && tags.year.empty() && !tags.picture;
+    if (empty) {
+        LOG_DEBUG("tag for %s is empty", mediaItem.path().c_str());
+        return;
+    }
+
+    // ID3v2 text frames are set even if missing, Vorbis comments only
+    // if present
+    auto set = [&mediaItem, types] (MediaItem::Meta meta, const std::string &value) {
+        if (types == Mp3 || !value.empty())
+            mediaItem.setMeta(meta, {value});
+    };
+
+    if (!extra) {
+        set(MediaItem::Meta::Title, tags.title);
+        set(MediaItem::Meta::Genre, tags.genre);
+        set(MediaItem::Meta::Album, tags.album);
+        set(MediaItem::Meta::Artist, tags.artist);
+        if (types == Mp3 && tags.picture) {
+            std::string baseName = mediaItem.thumbnailId();
+            std::string outImagePath = savePicture(mediaItem, tags.pictureMime,
+                reinterpret_cast<const char *>(tags.picture), tags.pictureSize, baseName);
+            if (outImagePath.empty()) {
+                LOG_ERROR(0, "Extracting Image from %s is failed", baseName.c_str());
+            } else {
+                LOG_DEBUG("Extracted Image has been saved in %s", outImagePath.c_str());
+                mediaItem.setMeta(MediaItem::Meta::Thumbnail, {outImagePath});
+            }
+        }
+    } else {
+        set(MediaItem::Meta::DateOfCreation, tags.date);
+        set(MediaItem::Meta::AlbumArtist, tags.albumArtist);
+        set(MediaItem::Meta::Track, tags.track);
+        if (types == Mp3)
+            mediaItem.setMeta(MediaItem::Meta::Year,
+                {static_cast<std::int32_t>(std::atoi(tags.year.c_str()))});
+        else
+            set(MediaItem::Meta::Year, tags.year);
+    }
+}
+
 bool TaglibExtractor::setMetaFromFile(MediaItem &mediaItem, TagLib::File *file, FileTypes types, bool extra) const
 {
     switch(types)
@@ -273,7 +496,7 @@ void TaglibExtractor::setMetaMp3(MediaItem &mediaItem, TagLib::ID3v2::Tag *tag,
             case MediaItem::Meta::Thumbnail:
             {
                 if (tag) {
-                    std::string baseName = randFilename();//baseFilename(mediaItem, true);//
+                    std::string baseName = mediaItem.thumbnailId();
                     std::string outImagePath = saveAttachedImage(mediaItem, tag, baseName);
                     if (outImagePath.empty())
                     {
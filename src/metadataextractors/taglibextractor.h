@@ -17,6 +17,7 @@
 #pragma once
 
 #include "imetadataextractor.h"
+#include "tagreader.h"
 
 #if defined HAS_TAGLIB
 #include <tag.h>
@@ -25,7 +26,6 @@
 #include <string.h>
 
 #define TAGLIB_BASE_DIRECTORY THUMBNAIL_DIRECTORY
-#define TAGLIB_FILE_NAME_SIZE 16
 namespace TagLib { class File; }
 namespace TagLib { class Tag; }
 namespace TagLib { namespace ID3v2 { class Tag; } }
@@ -34,6 +34,7 @@ namespace TagLib { namespace MPEG { class Properties; } }
 namespace TagLib { namespace Ogg { class XiphComment; } }
 namespace TagLib { namespace Ogg { class File; } }
 namespace TagLib { class ByteVector; }
+namespace TagLib { class IOStream; }
 
 /**
  * \brief Media parser class for meta data extraction.
@@ -56,6 +57,12 @@ class TaglibExtractor : public IMetaDataExtractor
     /// From interface.
     bool extractMeta(MediaItem &mediaItem, bool extra = false) const;
 
+    /// From interface, saves the attached picture of mp3 files again.
+    bool extractThumbnail(MediaItem &mediaItem) const;
+
+    /// From interface.
+    bool canExtractThumbnail() const { return true; }
+
  private:
     /// Get message id.
     LOG_MSGID;
@@ -66,6 +73,23 @@ class TaglibExtractor : public IMetaDataExtractor
     /// Get attached image of mp3 from APIC key frame
     std::string saveAttachedImage(MediaItem &mediaItem, TagLib::ID3v2::Tag *tag, const std::string &fname) const;
 
+    /// Save picture data with the given mime type as thumbnail.
+    std::string savePicture(MediaItem &mediaItem, const std::string &mime,
+        const char *data, size_t size, const std::string &fname) const;
+
+    /// Extract meta data with the native tag reader, false to fall back
+    /// to TagLib.
+    bool extractNative(MediaItem &mediaItem, TagLib::IOStream *stream, int fd,
+        FileTypes types, bool extra) const;
+
+    /// Set media item meta from natively read stream properties.
+    void setMetaFromStreamInfo(MediaItem &mediaItem, const TagReader::StreamInfo &info,
+        const std::string &codec, bool extra) const;
+
+    /// Set media item meta from natively read tags.
+    void setMetaFromTags(MediaItem &mediaItem, const TagReader::Tags &tags,
+        FileTypes types, bool extra) const;
+
     /// Set media item media per media type(for mp3 file format).
     void setMetaMp3(MediaItem &mediaItem, TagLib::ID3v2::Tag *tag, TagLib::MPEG::File *file,
         MediaItem::Meta flag) const;
@@ -0,0 +1,850 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "tagreader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <climits>
+#include <cstring>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// ID3v1 genre names, also referenced by number from ID3v2 TCON.
+static const char *id3v1Genres[] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge",
+    "Hip-Hop", "Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B",
+    "Rap", "Reggae", "Rock", "Techno", "Industrial", "Alternative", "Ska",
+    "Death Metal", "Pranks", "Soundtrack", "Euro-Techno", "Ambient",
+    "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance", "Classical",
+    "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "Alternative Rock", "Bass", "Soul", "Punk", "Space", "Meditative",
+    "Instrumental Pop", "Instrumental Rock", "Ethnic", "Gothic", "Darkwave",
+    "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+    "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap",
+    "Pop/Funk", "Jungle", "Native American", "Cabaret", "New Wave",
+    "Psychedelic", "Rave", "Showtunes", "Trailer", "Lo-Fi", "Tribal",
+    "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll",
+    "Hard Rock", "Folk", "Folk/Rock", "National Folk", "Swing", "Fast-Fusion",
+    "Bebob", "Latin", "Revival", "Celtic", "Bluegrass", "Avantgarde",
+    "Gothic Rock", "Progressive Rock", "Psychedelic Rock", "Symphonic Rock",
+    "Slow Rock", "Big Band", "Chorus", "Easy Listening", "Acoustic", "Humour",
+    "Speech", "Chanson", "Opera", "Chamber Music", "Sonata", "Symphony",
+    "Booty Bass", "Primus", "Porn Groove", "Satire", "Slow Jam", "Club",
+    "Tango", "Samba", "Folklore", "Ballad", "Power Ballad", "Rhythmic Soul",
+    "Freestyle", "Duet", "Punk Rock", "Drum Solo", "A Cappella", "Euro-House",
+    "Dance Hall", "Goa", "Drum & Bass", "Club-House", "Hardcore", "Terror",
+    "Indie", "BritPop", "Afro-Punk", "Polsk Punk", "Beat",
+    "Christian Gangsta Rap", "Heavy Metal", "Black Metal", "Crossover",
+    "Contemporary Christian", "Christian Rock", "Merengue", "Salsa",
+    "Thrash Metal", "Anime", "Jpop", "Synthpop", "Abstract", "Art Rock",
+    "Baroque", "Bhangra", "Big Beat", "Breakbeat", "Chillout", "Downtempo",
+    "Dub", "EBM", "Eclectic", "Electro", "Electroclash", "Emo",
+    "Experimental", "Garage", "Global", "IDM", "Illbient", "Industro-Goth",
+    "Jam Band", "Krautrock", "Leftfield", "Lounge", "Math Rock",
+    "New Romantic", "Nu-Breakz", "Post-Punk", "Post-Rock", "Psytrance",
+    "Shoegaze", "Space Rock", "Trop Rock", "World Music", "Neoclassical",
+    "Audiobook", "Audio Theatre", "Neue Deutsche Welle", "Podcast",
+    "Indie Rock", "G-Funk", "Dubstep", "Garage Rock", "Psybient"
+};
+
+/// MPEG audio bitrates in kbit/s by MPEG-1/MPEG-2, layer and index.
+static const int mpegBitRates[2][3][14] = {
+    {
+        { 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }
+    },
+    {
+        { 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+    }
+};
+
+/// MPEG-1 sample rates, halved for MPEG-2 and quartered for MPEG-2.5.
+static const int mpegSampleRates[] = { 44100, 48000, 32000 };
+
+/// Map ID3v2.2 frame ids to their ID3v2.3 counterparts.
+static const char *id3v22Frames[][2] = {
+    { "TT2", "TIT2" }, { "TP1", "TPE1" }, { "TAL", "TALB" },
+    { "TP2", "TPE2" }, { "TCO", "TCON" }, { "TYE", "TYER" },
+    { "TPA", "TPOS" }, { "PIC", "APIC" }
+};
+
+static inline uint32_t be32(const uint8_t *p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+static inline uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t(p[3]) << 24) | (uint32_t(p[2]) << 16) | (uint32_t(p[1]) << 8) | p[0];
+}
+
+static inline uint64_t le64(const uint8_t *p)
+{
+    return (uint64_t(le32(p + 4)) << 32) | le32(p);
+}
+
+/// Decode a synchsafe integer, false if a byte has the high bit set.
+static inline bool synchsafe(const uint8_t *p, uint32_t &value)
+{
+    if ((p[0] | p[1] | p[2] | p[3]) & 0x80)
+        return false;
+    value = (uint32_t(p[0]) << 21) | (uint32_t(p[1]) << 14) | (uint32_t(p[2]) << 7) | p[3];
+    return true;
+}
+
+/// Remove the 0x00 stuffed after every 0xff.
+static void deunsync(const uint8_t *data, size_t size, std::string &out)
+{
+    out.clear();
+    out.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        out.push_back(static_cast<char>(data[i]));
+        if (data[i] == 0xff && i + 1 < size && data[i + 1] == 0x00)
+            ++i;
+    }
+}
+
+static void appendUtf8(std::string &out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else {
+        out.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    }
+}
+
+/**
+ * \brief Decode ID3v2 text to UTF-8.
+ *
+ * Several null separated values are joined with " / " like TagLib
+ * does.
+ */
+static std::string decodeText(uint8_t encoding, const uint8_t *data, size_t size)
+{
+    std::string out;
+    if (encoding == 1 || encoding == 2) {
+        bool bigEndian = encoding == 2;
+        size_t i = 0;
+        bool first = true;
+        while (i + 1 < size) {
+            // every value of UTF-16 text may start with its own BOM
+            if (data[i] == 0xff && data[i + 1] == 0xfe) {
+                bigEndian = false;
+                i += 2;
+                continue;
+            }
+            if (data[i] == 0xfe && data[i + 1] == 0xff) {
+                bigEndian = true;
+                i += 2;
+                continue;
+            }
+            uint32_t u = bigEndian ? (data[i] << 8) | data[i + 1] : (data[i + 1] << 8) | data[i];
+            i += 2;
+            if (!u) {
+                first = true;
+                continue;
+            }
+            if (first && !out.empty())
+                out += " / ";
+            first = false;
+            if (u >= 0xd800 && u < 0xdc00 && i + 1 < size) {
+                uint32_t l = bigEndian ? (data[i] << 8) | data[i + 1] : (data[i + 1] << 8) | data[i];
+                if (l >= 0xdc00 && l < 0xe000) {
+                    i += 2;
+                    u = 0x10000 + ((u - 0xd800) << 10) + (l - 0xdc00);
+                }
+            }
+            appendUtf8(out, u);
+        }
+        return out;
+    }
+
+    bool first = true;
+    for (size_t i = 0; i < size; ++i) {
+        if (!data[i]) {
+            first = true;
+            continue;
+        }
+        if (first && !out.empty())
+            out += " / ";
+        first = false;
+        // ISO-8859-1 maps to the first 256 code points
+        if (encoding == 0)
+            appendUtf8(out, data[i]);
+        else
+            out.push_back(static_cast<char>(data[i]));
+    }
+    return out;
+}
+
+/// Length of a string in the given encoding including its terminator.
+static size_t terminatedLength(uint8_t encoding, const uint8_t *data, size_t size)
+{
+    if (encoding == 1 || encoding == 2) {
+        for (size_t i = 0; i + 1 < size; i += 2)
+            if (!data[i] && !data[i + 1])
+                return i + 2;
+        return size;
+    }
+    auto end = static_cast<const uint8_t *>(memchr(data, 0, size));
+    return end ? end - data + 1 : size;
+}
+
+/// Resolve numeric genre references like "(17)" or "17".
+static std::string resolveGenre(const std::string &genre)
+{
+    auto name = [](const std::string &number) -> std::string {
+        if (number.empty() || number.size() > 3 ||
+            number.find_first_not_of("0123456789") != std::string::npos)
+            return "";
+        auto n = std::stoi(number);
+        if (n < static_cast<int>(sizeof(id3v1Genres) / sizeof(id3v1Genres[0])))
+            return id3v1Genres[n];
+        return "";
+    };
+
+    std::string out;
+    size_t pos = 0;
+    while (pos < genre.size() && genre[pos] == '(' &&
+           genre.compare(pos, 2, "((")) {
+        auto close = genre.find(')', pos);
+        if (close == std::string::npos)
+            break;
+        auto ref = genre.substr(pos + 1, close - pos - 1);
+        std::string resolved = name(ref);
+        if (ref == "RX")
+            resolved = "Remix";
+        else if (ref == "CR")
+            resolved = "Cover";
+        if (!resolved.empty())
+            out += (out.empty() ? "" : " ") + resolved;
+        pos = close + 1;
+    }
+
+    // text after the references refines them
+    auto rest = genre.substr(pos);
+    if (!rest.compare(0, 2, "(("))
+        rest.erase(0, 1);
+    if (!rest.empty()) {
+        auto resolved = name(rest);
+        return resolved.empty() ? rest : resolved;
+    }
+    return out;
+}
+
+TagReader::TagReader(int fd) :
+    fd_(fd)
+{
+    struct stat st;
+    if (!fstat(fd_, &st))
+        size_ = st.st_size;
+}
+
+TagReader::~TagReader()
+{
+}
+
+off_t TagReader::audioOffset() const
+{
+    return audioOffset_;
+}
+
+bool TagReader::load(off_t offset, size_t size, Region &region) const
+{
+    release(region);
+    if (offset >= size_)
+        return false;
+    size = std::min<size_t>(size, size_ - offset);
+
+    // read instead of mapping, a removed medium or a truncated file
+    // fails the read instead of raising SIGBUS on access
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd_, buffer.get() + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            LOG_DEBUG("Reading %zu bytes at %jd failed: %s", size, intmax_t(offset),
+                strerror(errno));
+            return false;
+        }
+        if (!n)
+            break;
+        done += n;
+    }
+    if (!done)
+        return false;
+
+    region.buffer = std::move(buffer);
+    region.data = region.buffer.get();
+    region.size = done;
+    return true;
+}
+
+void TagReader::release(Region &region) const
+{
+    region = Region();
+}
+
+bool TagReader::readId3(Tags &tags)
+{
+    uint8_t header[10];
+    if (pread(fd_, header, sizeof(header), 0) == sizeof(header) &&
+        !memcmp(header, "ID3", 3)) {
+        int major = header[3];
+        uint8_t flags = header[5];
+        uint32_t size = 0;
+        if (major < 2 || major > 4 || header[4] == 0xff || !synchsafe(header + 6, size) ||
+            size > TAGREADER_ID3V2_MAX)
+            return false;
+        // ID3v2.2 compression has never been defined
+        if (major == 2 && (flags & 0x40))
+            return false;
+
+        audioOffset_ = 10 + size + ((major == 4 && (flags & 0x10)) ? 10 : 0);
+        if (size && !load(10, size, head_))
+            return false;
+
+        const uint8_t *data = head_.data;
+        size_t length = head_.size;
+        // the whole tag is unsynchronised before ID3v2.4, in ID3v2.4
+        // the flag means all frames are
+        if ((flags & 0x80) && major < 4) {
+            deunsync(data, length, unsync_);
+            data = reinterpret_cast<const uint8_t *>(unsync_.data());
+            length = unsync_.size();
+        }
+
+        if (major > 2 && (flags & 0x40) && length >= 4) {
+            uint32_t extended = 0;
+            if (major == 3)
+                extended = be32(data) + 4;
+            else if (!synchsafe(data, extended))
+                return false;
+            if (extended > length)
+                return false;
+            data += extended;
+            length -= extended;
+        }
+
+        if (!readId3v2Frames(data, length, major, major == 4 && (flags & 0x80), tags))
+            return false;
+    }
+
+    readId3v1(tags);
+    return true;
+}
+
+bool TagReader::readId3v2Frames(const uint8_t *data, size_t size, int major,
+    bool unsync, Tags &tags)
+{
+    size_t headerSize = (major == 2) ? 6 : 10;
+    size_t pos = 0;
+    while (pos + headerSize <= size) {
+        const uint8_t *h = data + pos;
+        // padding
+        if (!h[0])
+            break;
+
+        char id[5] = {};
+        uint32_t frameSize = 0;
+        uint8_t format = 0;
+        if (major == 2) {
+            char id22[4] = { char(h[0]), char(h[1]), char(h[2]), 0 };
+            for (const auto &m : id3v22Frames)
+                if (!strcmp(m[0], id22))
+                    memcpy(id, m[1], 4);
+            frameSize = (uint32_t(h[3]) << 16) | (uint32_t(h[4]) << 8) | h[5];
+        } else {
+            memcpy(id, h, 4);
+            if (major == 3)
+                frameSize = be32(h + 4);
+            else if (!synchsafe(h + 4, frameSize))
+                return false;
+            format = h[9];
+        }
+        if (frameSize > size - pos - headerSize)
+            break;
+
+        const uint8_t *frame = h + headerSize;
+        pos += headerSize + frameSize;
+        if (!id[0] || (id[0] != 'T' && strcmp(id, "APIC")))
+            continue;
+        // first frame wins like with TagLib
+        if (!strcmp(id, "APIC") && tags.picture)
+            continue;
+
+        bool compressed, encrypted, frameUnsync = unsync;
+        if (major == 3) {
+            compressed = format & 0x80;
+            encrypted = format & 0x40;
+            if (format & 0x20) {
+                // grouping identity
+                if (!frameSize)
+                    continue;
+                ++frame;
+                --frameSize;
+            }
+        } else {
+            compressed = format & 0x08;
+            encrypted = format & 0x04;
+            frameUnsync = frameUnsync || (format & 0x02);
+            if (format & 0x40) {
+                if (!frameSize)
+                    continue;
+                ++frame;
+                --frameSize;
+            }
+            if (format & 0x01) {
+                // data length indicator
+                if (frameSize < 4)
+                    continue;
+                frame += 4;
+                frameSize -= 4;
+            }
+        }
+        if (compressed || encrypted) {
+            LOG_DEBUG("Compressed or encrypted frame '%s', use TagLib", id);
+            return false;
+        }
+
+        if (frameUnsync) {
+            std::string plain;
+            deunsync(frame, frameSize, plain);
+            readId3v2Frame(id, reinterpret_cast<const uint8_t *>(plain.data()),
+                plain.size(), major == 2, tags);
+            // the picture must outlive the temporary copy
+            if (tags.picture && tags.picture >= reinterpret_cast<const uint8_t *>(plain.data()) &&
+                tags.picture < reinterpret_cast<const uint8_t *>(plain.data()) + plain.size()) {
+                picture_.assign(reinterpret_cast<const char *>(tags.picture), tags.pictureSize);
+                tags.picture = reinterpret_cast<const uint8_t *>(picture_.data());
+            }
+        } else {
+            readId3v2Frame(id, frame, frameSize, major == 2, tags);
+        }
+    }
+    return true;
+}
+
+void TagReader::readId3v2Frame(const char *id, const uint8_t *data, size_t size,
+    bool major2, Tags &tags)
+{
+    if (size < 2)
+        return;
+    uint8_t encoding = data[0];
+    if (encoding > 3)
+        return;
+
+    if (!strcmp(id, "APIC")) {
+        size_t pos = 1;
+        if (major2) {
+            // three character image format
+            if (size < 5)
+                return;
+            tags.pictureMime.assign(reinterpret_cast<const char *>(data + 1), 3);
+            std::transform(tags.pictureMime.begin(), tags.pictureMime.end(),
+                tags.pictureMime.begin(), ::tolower);
+            pos = 4;
+        } else {
+            auto len = terminatedLength(0, data + pos, size - pos);
+            tags.pictureMime = decodeText(0, data + pos, len);
+            pos += len;
+        }
+        // picture type
+        if (++pos >= size)
+            return;
+        pos += terminatedLength(encoding, data + pos, size - pos);
+        if (pos >= size)
+            return;
+        tags.picture = data + pos;
+        tags.pictureSize = size - pos;
+        return;
+    }
+
+    std::string *field = nullptr;
+    if (!strcmp(id, "TIT2"))
+        field = &tags.title;
+    else if (!strcmp(id, "TPE1"))
+        field = &tags.artist;
+    else if (!strcmp(id, "TALB"))
+        field = &tags.album;
+    else if (!strcmp(id, "TPE2"))
+        field = &tags.albumArtist;
+    else if (!strcmp(id, "TCON"))
+        field = &tags.genre;
+    else if (!strcmp(id, "TDRC") || !strcmp(id, "TYER"))
+        field = &tags.date;
+    else if (!strcmp(id, "TPOS"))
+        field = &tags.track;
+    if (!field || !field->empty())
+        return;
+
+    *field = decodeText(encoding, data + 1, size - 1);
+    if (field == &tags.genre)
+        *field = resolveGenre(*field);
+    else if (field == &tags.date && tags.year.empty())
+        tags.year = field->substr(0, 4);
+}
+
+void TagReader::readId3v1(Tags &tags) const
+{
+    if (size_ < 128)
+        return;
+    uint8_t tag[128];
+    if (pread(fd_, tag, sizeof(tag), size_ - 128) != sizeof(tag) || memcmp(tag, "TAG", 3))
+        return;
+
+    auto text = [&tag](size_t offset, size_t length) -> std::string {
+        auto end = static_cast<const uint8_t *>(memchr(tag + offset, 0, length));
+        size_t len = end ? end - (tag + offset) : length;
+        while (len && tag[offset + len - 1] == ' ')
+            --len;
+        return decodeText(0, tag + offset, len);
+    };
+
+    if (tags.title.empty())
+        tags.title = text(3, 30);
+    if (tags.artist.empty())
+        tags.artist = text(33, 30);
+    if (tags.album.empty())
+        tags.album = text(63, 30);
+    if (tags.year.empty())
+        tags.year = text(93, 4);
+    if (tags.genre.empty() && tag[127] < sizeof(id3v1Genres) / sizeof(id3v1Genres[0]))
+        tags.genre = id3v1Genres[tag[127]];
+}
+
+bool TagReader::parseFrame(const uint8_t *data, MpegFrame &frame)
+{
+    if (data[0] != 0xff || (data[1] & 0xe0) != 0xe0)
+        return false;
+    int version = (data[1] >> 3) & 0x03;
+    int layer = 4 - ((data[1] >> 1) & 0x03);
+    int bitRateIndex = data[2] >> 4;
+    int sampleRateIndex = (data[2] >> 2) & 0x03;
+    if (version == 1 || layer == 4 || !bitRateIndex || bitRateIndex == 15 ||
+        sampleRateIndex == 3)
+        return false;
+
+    bool mpeg1 = (version == 3);
+    bool mono = ((data[3] >> 6) == 3);
+    int padding = (data[2] >> 1) & 0x01;
+    frame.version = version;
+    frame.layer = layer;
+    frame.bitRate = mpegBitRates[mpeg1 ? 0 : 1][layer - 1][bitRateIndex - 1];
+    frame.sampleRate = mpegSampleRates[sampleRateIndex] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    frame.channels = mono ? 1 : 2;
+    if (layer == 1) {
+        frame.samples = 384;
+        frame.length = (12 * frame.bitRate * 1000 / frame.sampleRate + padding) * 4;
+    } else {
+        frame.samples = (layer == 3 && !mpeg1) ? 576 : 1152;
+        frame.length = frame.samples / 8 * frame.bitRate * 1000 / frame.sampleRate + padding;
+    }
+    if (layer != 3)
+        frame.sideInfo = 0;
+    else if (mpeg1)
+        frame.sideInfo = mono ? 17 : 32;
+    else
+        frame.sideInfo = mono ? 9 : 17;
+    return true;
+}
+
+const uint8_t *TagReader::findFrame(const uint8_t *data, size_t size, MpegFrame &frame)
+{
+    for (size_t i = 0; i + 4 <= size; ++i) {
+        if (data[i] != 0xff || !parseFrame(data + i, frame))
+            continue;
+        // the frame sync also occurs in audio data, require the next
+        // frame to match
+        MpegFrame next;
+        size_t following = i + frame.length;
+        if (following + 4 <= size && parseFrame(data + following, next) &&
+            next.version == frame.version && next.layer == frame.layer &&
+            next.sampleRate == frame.sampleRate)
+            return data + i;
+    }
+    return nullptr;
+}
+
+bool TagReader::readMpeg(StreamInfo &info)
+{
+    // the ID3v1 tag is not part of the audio data
+    off_t end = size_;
+    uint8_t id3v1[3];
+    if (size_ >= 128 && pread(fd_, id3v1, sizeof(id3v1), size_ - 128) == sizeof(id3v1) &&
+        !memcmp(id3v1, "TAG", 3))
+        end -= 128;
+    if (audioOffset_ >= end)
+        return false;
+
+    Region region;
+    if (!load(audioOffset_, TAGREADER_MPEG_SCAN, region))
+        return false;
+    MpegFrame frame;
+    const uint8_t *first = findFrame(region.data, region.size, frame);
+    if (!first) {
+        release(region);
+        return false;
+    }
+    off_t start = audioOffset_ + (first - region.data);
+    size_t available = std::min(frame.length, region.size - (first - region.data));
+    info.sampleRate = frame.sampleRate;
+    info.channels = frame.channels;
+
+    // the first frame of a VBR file carries a Xing or VBRI header with
+    // the frame count instead of audio, LAME adds the encoder delay and
+    // padding which are not part of the duration
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    int delay = 0;
+    int padding = 0;
+    size_t xing = 4 + frame.sideInfo;
+    if (available >= xing + 8 &&
+        (!memcmp(first + xing, "Xing", 4) || !memcmp(first + xing, "Info", 4))) {
+        const uint8_t *p = first + xing + 4;
+        const uint8_t *limit = first + available;
+        uint32_t flags = be32(p);
+        p += 4;
+        if ((flags & 0x01) && p + 4 <= limit) {
+            frames = be32(p);
+            p += 4;
+        }
+        if ((flags & 0x02) && p + 4 <= limit) {
+            bytes = be32(p);
+            p += 4;
+        }
+        // skip the TOC and the quality indicator, the encoder tag
+        // follows only if the frame holds them
+        size_t skip = ((flags & 0x04) ? 100 : 0) + ((flags & 0x08) ? 4 : 0);
+        if (size_t(limit - p) >= skip + 24)
+            p += skip;
+        else
+            p = limit;
+        if (p + 24 <= limit && (!memcmp(p, "LAME", 4) || !memcmp(p, "Lavc", 4) ||
+                !memcmp(p, "Lavf", 4))) {
+            delay = (p[21] << 4) | (p[22] >> 4);
+            padding = ((p[22] & 0x0f) << 8) | p[23];
+        }
+    } else if (available >= 4 + 32 + 18 && !memcmp(first + 36, "VBRI", 4)) {
+        bytes = be32(first + 36 + 10);
+        frames = be32(first + 36 + 14);
+    }
+    release(region);
+
+    if (frames) {
+        auto samples = static_cast<int64_t>(frames * frame.samples) - delay - padding;
+        if (samples <= 0)
+            samples = frames * frame.samples;
+        if (!bytes || static_cast<off_t>(bytes) > end - start)
+            bytes = end - start;
+        auto ms = samples * 1000 / frame.sampleRate;
+        info.duration = static_cast<int>(ms / 1000);
+        info.bitRate = ms > 0 ? static_cast<int>(bytes * 8 / ms) : frame.bitRate;
+        return true;
+    }
+
+    // without header only a constant bitrate allows to estimate the
+    // duration from the file size
+    off_t audio = end - start;
+    for (int i = 1; i <= TAGREADER_MPEG_SAMPLES; ++i) {
+        off_t offset = start + audio * i / (TAGREADER_MPEG_SAMPLES + 1);
+        Region sample;
+        MpegFrame other;
+        if (!load(offset, TAGREADER_MPEG_SAMPLE, sample))
+            return false;
+        bool found = findFrame(sample.data, sample.size, other);
+        release(sample);
+        if (!found || other.bitRate != frame.bitRate || other.sampleRate != frame.sampleRate)
+            return false;
+    }
+
+    info.bitRate = frame.bitRate;
+    info.duration = static_cast<int>(audio * 8 / (frame.bitRate * 1000));
+    return true;
+}
+
+bool TagReader::readVorbis(Tags &tags, StreamInfo &info)
+{
+    if (!load(0, TAGREADER_OGG_HEAD, head_))
+        return false;
+
+    // collect the identification and the comment packet of the first
+    // logical stream, both may span several pages
+    const uint8_t *d = head_.data;
+    size_t n = head_.size;
+    size_t pos = 0;
+    uint32_t serial = 0;
+    bool first = true;
+    int packets = 0;
+    std::string packet;
+    std::string ident;
+    while (packets < 2) {
+        if (pos + 27 > n || memcmp(d + pos, "OggS", 4))
+            return false;
+        size_t segments = d[pos + 26];
+        if (pos + 27 + segments > n)
+            return false;
+        const uint8_t *table = d + pos + 27;
+        size_t body = pos + 27 + segments;
+        size_t bodySize = 0;
+        for (size_t i = 0; i < segments; ++i)
+            bodySize += table[i];
+        if (body + bodySize > n)
+            return false;
+
+        uint32_t pageSerial = le32(d + pos + 14);
+        if (first) {
+            serial = pageSerial;
+            first = false;
+        }
+        if (pageSerial == serial) {
+            size_t offset = body;
+            for (size_t i = 0; i < segments && packets < 2; ++i) {
+                packet.append(reinterpret_cast<const char *>(d + offset), table[i]);
+                offset += table[i];
+                if (table[i] == 255)
+                    continue;
+                if (packets++ == 0) {
+                    ident.swap(packet);
+                    packet.clear();
+                }
+            }
+        }
+        pos = body + bodySize;
+    }
+
+    auto id = reinterpret_cast<const uint8_t *>(ident.data());
+    if (ident.size() < 30 || id[0] != 1 || memcmp(id + 1, "vorbis", 6))
+        return false;
+    info.channels = id[11];
+    info.sampleRate = static_cast<int>(le32(id + 12));
+    int nominal = static_cast<int>(le32(id + 20));
+    if (info.sampleRate <= 0)
+        return false;
+
+    if (!readVorbisComment(packet, tags))
+        return false;
+
+    // the granule position of the last page is the number of samples
+    Region tail;
+    off_t tailOffset = std::max<off_t>(0, size_ - TAGREADER_OGG_TAIL);
+    if (load(tailOffset, TAGREADER_OGG_TAIL, tail)) {
+        for (size_t i = tail.size >= 27 ? tail.size - 26 : 0; i-- > 0;) {
+            if (memcmp(tail.data + i, "OggS", 4) || le32(tail.data + i + 14) != serial)
+                continue;
+            auto granule = static_cast<int64_t>(le64(tail.data + i + 6));
+            // a broken granule position must not overflow the duration
+            if (granule <= 0 || granule / info.sampleRate > INT_MAX)
+                continue;
+            auto ms = granule / info.sampleRate * 1000 +
+                granule % info.sampleRate * 1000 / info.sampleRate;
+            info.duration = static_cast<int>(ms / 1000);
+            if (ms > 0)
+                info.bitRate = static_cast<int>(size_ * 8 / ms);
+            break;
+        }
+        release(tail);
+    }
+    if (!info.bitRate && nominal > 0)
+        info.bitRate = nominal / 1000;
+    return true;
+}
+
+bool TagReader::readVorbisComment(const std::string &packet, Tags &tags) const
+{
+    auto d = reinterpret_cast<const uint8_t *>(packet.data());
+    size_t n = packet.size();
+    if (n < 11 || d[0] != 3 || memcmp(d + 1, "vorbis", 6))
+        return false;
+
+    size_t pos = 7;
+    uint32_t vendor = le32(d + pos);
+    if (vendor > n - pos - 4)
+        return false;
+    pos += 4 + vendor;
+    if (pos + 4 > n)
+        return false;
+    uint32_t count = le32(d + pos);
+    pos += 4;
+
+    // several values of one field are joined with a space like TagLib
+    auto add = [](std::string &field, const char *value, size_t size) {
+        if (!field.empty())
+            field += " ";
+        field.append(value, size);
+    };
+
+    std::string track, trackNum;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (pos + 4 > n)
+            return false;
+        uint32_t len = le32(d + pos);
+        pos += 4;
+        if (len > n - pos)
+            return false;
+        auto entry = reinterpret_cast<const char *>(d + pos);
+        pos += len;
+
+        auto eq = static_cast<const char *>(memchr(entry, '=', len));
+        if (!eq)
+            continue;
+        size_t keyLen = eq - entry;
+        const char *value = eq + 1;
+        size_t valueLen = len - keyLen - 1;
+        auto is = [entry, keyLen](const char *key) {
+            return strlen(key) == keyLen && !strncasecmp(entry, key, keyLen);
+        };
+
+        if (is("TITLE"))
+            add(tags.title, value, valueLen);
+        else if (is("ARTIST"))
+            add(tags.artist, value, valueLen);
+        else if (is("ALBUM"))
+            add(tags.album, value, valueLen);
+        else if (is("PERFORMER"))
+            add(tags.albumArtist, value, valueLen);
+        else if (is("GENRE"))
+            add(tags.genre, value, valueLen);
+        else if (is("DATE"))
+            add(tags.date, value, valueLen);
+        else if (is("YEAR"))
+            add(tags.year, value, valueLen);
+        else if (is("TRACKNUMBER"))
+            add(track, value, valueLen);
+        else if (is("TRACKNUM"))
+            add(trackNum, value, valueLen);
+    }
+    tags.track = track.empty() ? trackNum : track;
+    return true;
+}
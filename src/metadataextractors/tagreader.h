@@ -0,0 +1,199 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <sys/types.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/// Largest ID3v2 tag that is read natively, larger tags go to TagLib.
+#define TAGREADER_ID3V2_MAX (16 * 1024 * 1024)
+/// Region at the start of an Ogg file that holds the Vorbis headers.
+#define TAGREADER_OGG_HEAD (256 * 1024)
+/// Region at the end of an Ogg file searched for the last page.
+#define TAGREADER_OGG_TAIL (64 * 1024)
+/// Region after the ID3v2 tag searched for the first MPEG frame.
+#define TAGREADER_MPEG_SCAN (64 * 1024)
+/// Region searched for a frame when sampling a MPEG file.
+#define TAGREADER_MPEG_SAMPLE (8 * 1024)
+/// Frames sampled to tell constant bitrate files without header apart.
+#define TAGREADER_MPEG_SAMPLES 3
+
+/**
+ * \brief Native reader for ID3v2, ID3v1 and Vorbis comment tags.
+ *
+ * Reads only the tag region of the file and decodes the few fields the
+ * media database stores, no frame lists or strings are built for the
+ * rest. Files the reader can not handle, like compressed or encrypted
+ * frames, are reported so the caller can fall back to TagLib.
+ *
+ * The picture of the tags points into the read buffer and is valid as
+ * long as the reader exists.
+ */
+class TagReader
+{
+public:
+    /// The decoded fields, empty if not found.
+    struct Tags {
+        std::string title;
+        std::string artist;
+        std::string album;
+        std::string albumArtist;
+        std::string genre;
+        std::string date;
+        std::string track;
+        std::string year;
+        /// Mime type or ID3v2.2 image format of the attached picture.
+        std::string pictureMime;
+        /// The attached picture data.
+        const uint8_t *picture = nullptr;
+        /// Size of the attached picture.
+        size_t pictureSize = 0;
+    };
+
+    /// Stream properties of an Ogg Vorbis or MPEG audio file.
+    struct StreamInfo {
+        /// Duration in seconds.
+        int duration = 0;
+        /// Sample rate in Hz.
+        int sampleRate = 0;
+        /// Number of channels.
+        int channels = 0;
+        /// Average bitrate in kbit/s.
+        int bitRate = 0;
+    };
+
+    /**
+     * \brief Create reader on an open file.
+     *
+     * \param[in] fd The file descriptor, not owned by the reader.
+     */
+    TagReader(int fd);
+    virtual ~TagReader();
+
+    /**
+     * \brief Read the ID3v2 tag and fill missing fields from ID3v1.
+     *
+     * \param[out] tags The decoded fields.
+     * \return False if the tags can not be read natively.
+     */
+    bool readId3(Tags &tags);
+
+    /**
+     * \brief Read the Vorbis comments and stream properties.
+     *
+     * \param[out] tags The decoded fields.
+     * \param[out] info The stream properties.
+     * \return False if this is no Ogg Vorbis file or it can not be
+     *         read natively.
+     */
+    bool readVorbis(Tags &tags, StreamInfo &info);
+
+    /**
+     * \brief Read the stream properties of a MPEG audio file.
+     *
+     * Uses the Xing/Info, VBRI and LAME headers of the first frame, files
+     * without such a header are sampled at a few positions and accepted
+     * if the bitrate is constant. Call after readId3() so the search
+     * starts behind the ID3v2 tag.
+     *
+     * \param[out] info The stream properties.
+     * \return False if the properties can not be determined this way.
+     */
+    bool readMpeg(StreamInfo &info);
+
+    /**
+     * \brief Get the offset of the audio data.
+     *
+     * \return The first byte after the ID3v2 tag, 0 if there is none.
+     */
+    off_t audioOffset() const;
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// A file region read into memory.
+    struct Region {
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+        std::unique_ptr<uint8_t[]> buffer;
+    };
+
+    /// A MPEG audio frame header.
+    struct MpegFrame {
+        /// Version bits, 3 for MPEG-1, 2 for MPEG-2, 0 for MPEG-2.5.
+        int version = 0;
+        /// Layer 1, 2 or 3.
+        int layer = 0;
+        /// Bitrate in kbit/s.
+        int bitRate = 0;
+        /// Sample rate in Hz.
+        int sampleRate = 0;
+        /// Number of channels.
+        int channels = 0;
+        /// Samples per frame.
+        int samples = 0;
+        /// Frame length in bytes.
+        size_t length = 0;
+        /// Size of the layer 3 side information.
+        size_t sideInfo = 0;
+    };
+
+    /// Decode a MPEG frame header.
+    static bool parseFrame(const uint8_t *data, MpegFrame &frame);
+
+    /// Find a frame followed by a matching frame.
+    static const uint8_t *findFrame(const uint8_t *data, size_t size,
+        MpegFrame &frame);
+
+    /// Read size bytes from offset, clipped to the file size.
+    bool load(off_t offset, size_t size, Region &region) const;
+
+    /// Release a read region.
+    void release(Region &region) const;
+
+    /// Decode the frames of an ID3v2 tag.
+    bool readId3v2Frames(const uint8_t *data, size_t size, int major,
+        bool unsync, Tags &tags);
+
+    /// Decode one ID3v2 frame, the id is in ID3v2.3 form.
+    void readId3v2Frame(const char *id, const uint8_t *data, size_t size,
+        bool major2, Tags &tags);
+
+    /// Fill missing fields from an ID3v1 tag.
+    void readId3v1(Tags &tags) const;
+
+    /// Decode the Vorbis comment header packet.
+    bool readVorbisComment(const std::string &packet, Tags &tags) const;
+
+    /// File descriptor.
+    int fd_;
+    /// File size.
+    off_t size_ = 0;
+    /// Tag region at the start of the file.
+    Region head_;
+    /// Tag data with the unsynchronisation removed.
+    std::string unsync_;
+    /// Picture data with the unsynchronisation removed.
+    std::string picture_;
+    /// First byte after the ID3v2 tag.
+    off_t audioOffset_ = 0;
+};
@@ -0,0 +1,290 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "artfetcher.h"
+#include "thumbnailquota.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <strings.h>
+#include <sys/stat.h>
+
+ArtFetcher::ArtFetcher()
+{
+    pool_ = g_thread_pool_new((GFunc) &ArtFetcher::run, this,
+        UPNP_ART_FETCH_THREADS, FALSE, NULL);
+}
+
+ArtFetcher::~ArtFetcher()
+{
+    // the pool does not free dropped requests, let it run the queued
+    // ones without downloading and wait for the running ones
+    stopped_ = true;
+    g_thread_pool_free(pool_, FALSE, TRUE);
+}
+
+bool ArtFetcher::fetch(const std::string &url, const std::string &base)
+{
+    if (url.empty() || base.empty())
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (pending_.size() >= UPNP_ART_FETCH_QUEUE_MAX ||
+            !pending_.insert(base).second)
+            return false;
+    }
+
+    g_thread_pool_push(pool_, new Request({url, base}), NULL);
+    return true;
+}
+
+std::string ArtFetcher::get(const std::string &url, const std::string &base)
+{
+    if (url.empty() || base.empty())
+        return "";
+
+    // a queued download keeps the image up to date
+    auto file = storedFile(base);
+    if (!file.empty())
+        return file;
+
+    if (!download(Request({url, base}), file)) {
+        LOG_DEBUG("Album art '%s' not downloaded", url.c_str());
+        return "";
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (pending_.count(base))
+        done_.insert(base);
+    return file;
+}
+
+void ArtFetcher::run(gpointer data, gpointer userData)
+{
+    auto req = static_cast<Request *>(data);
+    auto fetcher = static_cast<ArtFetcher *>(userData);
+    if (fetcher->stopped_) {
+        delete req;
+        return;
+    }
+
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lock(fetcher->lock_);
+        done = fetcher->done_.erase(req->base);
+    }
+
+    std::string file;
+    if (!done && !fetcher->download(*req, file))
+        LOG_DEBUG("Album art '%s' not downloaded", req->url.c_str());
+
+    {
+        std::lock_guard<std::mutex> lock(fetcher->lock_);
+        fetcher->pending_.erase(req->base);
+    }
+    delete req;
+}
+
+bool ArtFetcher::download(const Request &req, std::string &file)
+{
+    std::string host, path;
+    guint16 port = 0;
+    if (!HttpConnection::parseUrl(req.url, host, port, path)) {
+        LOG_DEBUG("Unsupported album art url '%s'", req.url.c_str());
+        return false;
+    }
+
+    // ask for the image only if it changed since we stored it
+    Validator validator;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = validators_.find(req.url);
+        if (it != validators_.end())
+            validator = it->second;
+    }
+    file = storedFile(req.base);
+    struct stat st;
+    bool stored = !file.empty() && !stat(file.c_str(), &st);
+    if (stored && validator.lastModified.empty()) {
+        char date[64];
+        struct tm tm;
+        gmtime_r(&st.st_mtime, &tm);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        validator.lastModified = date;
+    }
+
+    auto conn = acquire(host, port);
+    std::string request = "GET " + path + " HTTP/1.1\r\n"
+        "Host: " + conn->hostHeader() + "\r\n"
+        "Connection: keep-alive\r\n";
+    if (stored && !validator.etag.empty())
+        request += "If-None-Match: " + validator.etag + "\r\n";
+    if (stored)
+        request += "If-Modified-Since: " + validator.lastModified + "\r\n";
+    request += "\r\n";
+
+    throttle(conn->hostHeader());
+
+    // an idle connection might have been closed by the server, retry
+    // once on a new connection then
+    HttpConnection::Response resp;
+    bool reused = conn->connected();
+    bool ok = conn->send(request) && conn->receive(resp, false, UPNP_ART_SIZE_MAX);
+    if (!ok && reused)
+        ok = conn->send(request) && conn->receive(resp, false, UPNP_ART_SIZE_MAX);
+    if (!ok)
+        return false;
+
+    if (resp.keepAlive)
+        release(std::move(conn));
+
+    if (resp.status == 304) {
+        LOG_DEBUG("Album art '%s' unchanged", req.url.c_str());
+        return stored;
+    }
+    if (resp.status != 200 || resp.body.empty()) {
+        LOG_DEBUG("Album art request '%s' failed with status %i",
+            req.url.c_str(), resp.status);
+        return false;
+    }
+
+    auto type = resp.headers.find("content-type");
+    auto target = req.base + "." + extension(
+        (type == resp.headers.end()) ? std::string() : type->second);
+    if (!store(target, resp.body))
+        return false;
+
+    // the server changed the image type
+    if (stored && file != target) {
+        std::remove(file.c_str());
+        ThumbnailQuota::instance()->remove(file);
+    }
+    file = target;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    auto &v = validators_[req.url];
+    auto etag = resp.headers.find("etag");
+    v.etag = (etag == resp.headers.end()) ? std::string() : etag->second;
+    auto lastModified = resp.headers.find("last-modified");
+    v.lastModified = (lastModified == resp.headers.end()) ?
+        std::string() : lastModified->second;
+
+    return true;
+}
+
+bool ArtFetcher::store(const std::string &path, const std::string &data) const
+{
+    std::error_code err;
+    std::filesystem::create_directories(
+        std::filesystem::path(path).parent_path(), err);
+    if (err) {
+        LOG_ERROR(0, "Failed to create directory for '%s'", path.c_str());
+        return false;
+    }
+
+    // readers must never see a partially written image, get() and the
+    // download threads might store the same image
+    auto tmp = path + ".part" +
+        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::ofstream ofs(tmp, std::ios_base::out | std::ios_base::binary);
+    ofs.write(data.data(), data.size());
+    ofs.close();
+    if (ofs.fail() || std::rename(tmp.c_str(), path.c_str())) {
+        LOG_ERROR(0, "Failed to store album art '%s'", path.c_str());
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+    ThumbnailQuota::instance()->add(path);
+    return true;
+}
+
+std::string ArtFetcher::storedFile(const std::string &base) const
+{
+    struct stat st;
+    for (auto ext : { "jpg", "png", "gif", "bmp", "webp" }) {
+        auto file = base + "." + ext;
+        if (!stat(file.c_str(), &st))
+            return file;
+    }
+    return "";
+}
+
+const char *ArtFetcher::extension(const std::string &contentType)
+{
+    // DLNA album art is JPEG unless the server says otherwise
+    static const std::pair<const char *, const char *> types[] = {
+        { "image/png", "png" },
+        { "image/gif", "gif" },
+        { "image/bmp", "bmp" },
+        { "image/webp", "webp" },
+    };
+    for (const auto &t : types) {
+        if (!strncasecmp(contentType.c_str(), t.first, strlen(t.first)))
+            return t.second;
+    }
+    return "jpg";
+}
+
+std::unique_ptr<HttpConnection> ArtFetcher::acquire(const std::string &host,
+    guint16 port)
+{
+    auto server = host + " " + std::to_string(port);
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = idle_.find(server);
+        if (it != idle_.end()) {
+            auto conn = std::move(it->second);
+            idle_.erase(it);
+            return conn;
+        }
+    }
+    return std::make_unique<HttpConnection>(host, port);
+}
+
+void ArtFetcher::release(std::unique_ptr<HttpConnection> conn)
+{
+    if (!conn->connected())
+        return;
+
+    auto server = conn->host() + " " + std::to_string(conn->port());
+    std::lock_guard<std::mutex> lock(lock_);
+    if (idle_.count(server) < UPNP_ART_FETCH_IDLE_MAX)
+        idle_.emplace(server, std::move(conn));
+}
+
+void ArtFetcher::throttle(const std::string &server)
+{
+    gint64 slot;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto now = g_get_monotonic_time();
+        auto &next = nextRequest_[server];
+        slot = std::max(now, next);
+        next = slot + UPNP_ART_FETCH_INTERVAL_MS * 1000;
+    }
+
+    auto wait = slot - g_get_monotonic_time();
+    if (wait > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(wait));
+}
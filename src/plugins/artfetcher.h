@@ -0,0 +1,156 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+#include "httpconnection.h"
+
+#include <glib.h>
+
+#include <string>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+/// Number of concurrent album art downloads.
+#define UPNP_ART_FETCH_THREADS 2
+/// Maximum number of queued album art downloads.
+#define UPNP_ART_FETCH_QUEUE_MAX 512
+/// Minimum time between two requests to the same server in ms.
+#define UPNP_ART_FETCH_INTERVAL_MS 50
+/// Maximum number of idle connections kept per server.
+#define UPNP_ART_FETCH_IDLE_MAX 2
+/// Maximum size of a downloaded image in bytes.
+#define UPNP_ART_SIZE_MAX (4 * 1024 * 1024)
+
+/**
+ * \brief Background download of UPnP album art and thumbnails.
+ *
+ * Downloads run in a small thread pool so browsing is never blocked
+ * by slow image servers. Connections are kept open and reused per
+ * server, requests to the same server are spaced out and images that
+ * are already stored are only requested conditionally.
+ */
+class ArtFetcher
+{
+public:
+    ArtFetcher();
+    virtual ~ArtFetcher();
+
+    /**
+     * \brief Queue the download of an image.
+     *
+     * Does nothing if the same target is already queued or the queue is
+     * full.
+     *
+     * \param[in] url The http url of the image.
+     * \param[in] base The thumbnail file without extension, the
+     *            extension follows the image type.
+     * \return True if the download has been queued.
+     */
+    bool fetch(const std::string &url, const std::string &base);
+
+    /**
+     * \brief Get a stored image, download it first if required.
+     *
+     * The download runs in the calling thread.
+     *
+     * \param[in] url The http url of the image.
+     * \param[in] base The thumbnail file without extension.
+     * \return The thumbnail file or empty string if the image could not
+     *         be downloaded.
+     */
+    std::string get(const std::string &url, const std::string &base);
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// A queued download.
+    struct Request {
+        std::string url;
+        std::string base;
+    };
+
+    /// Cache validators of a downloaded image.
+    struct Validator {
+        std::string etag;
+        std::string lastModified;
+    };
+
+    /**
+     * \brief Thread pool function.
+     *
+     * \param[in] data The Request, deleted here.
+     * \param[in] userData The fetcher instance.
+     */
+    static void run(gpointer data, gpointer userData);
+
+    /**
+     * \brief Download an image if it has changed.
+     *
+     * \param[in] req The request.
+     * \param[out] file The stored thumbnail file.
+     * \return False on error.
+     */
+    bool download(const Request &req, std::string &file);
+
+    /// Find the stored thumbnail file of any image type.
+    std::string storedFile(const std::string &base) const;
+
+    /// Get the file extension for the Content-Type of an image.
+    static const char *extension(const std::string &contentType);
+
+    /**
+     * \brief Store a downloaded image.
+     *
+     * \param[in] path The thumbnail file.
+     * \param[in] data The image data.
+     * \return False on error.
+     */
+    bool store(const std::string &path, const std::string &data) const;
+
+    /// Take an idle connection to a server or create a new one.
+    std::unique_ptr<HttpConnection> acquire(const std::string &host,
+        guint16 port);
+
+    /// Give back a connection that may be reused.
+    void release(std::unique_ptr<HttpConnection> conn);
+
+    /// Wait until the next request to a server is allowed.
+    void throttle(const std::string &server);
+
+    /// Download threads.
+    GThreadPool *pool_ = nullptr;
+    /// Set on destruction, queued downloads are dropped then.
+    std::atomic<bool> stopped_{false};
+
+    /// Protects the members below.
+    std::mutex lock_;
+    /// Targets of queued downloads.
+    std::unordered_set<std::string> pending_;
+    /// Queued targets that have been downloaded by get() meanwhile.
+    std::unordered_set<std::string> done_;
+    /// Cache validators by url.
+    std::map<std::string, Validator> validators_;
+    /// Idle connections by server.
+    std::multimap<std::string, std::unique_ptr<HttpConnection>> idle_;
+    /// Earliest time of the next request by server.
+    std::map<std::string, gint64> nextRequest_;
+};
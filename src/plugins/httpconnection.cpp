@@ -0,0 +1,249 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "httpconnection.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <strings.h>
+
+bool HttpConnection::parseUrl(const std::string &url, std::string &host,
+    guint16 &port, std::string &path)
+{
+    // http://host[:port]/path, servers on the local network use plain
+    // http
+    if (url.compare(0, 7, "http://"))
+        return false;
+    std::string rest = url.substr(7);
+
+    auto slash = rest.find('/');
+    auto hostPort = rest.substr(0, slash);
+    path = (slash == std::string::npos) ? "/" : rest.substr(slash);
+
+    port = 80;
+    auto colon = hostPort.rfind(':');
+    if (colon != std::string::npos && hostPort.find(']', colon) == std::string::npos) {
+        port = static_cast<guint16>(std::atoi(hostPort.c_str() + colon + 1));
+        hostPort.erase(colon);
+    }
+    // remove the brackets of IPv6 addresses
+    if (!hostPort.empty() && hostPort.front() == '[' && hostPort.back() == ']')
+        hostPort = hostPort.substr(1, hostPort.size() - 2);
+    host = hostPort;
+
+    return !host.empty() && port;
+}
+
+HttpConnection::HttpConnection(const std::string &host, guint16 port) :
+    host_(host),
+    port_(port)
+{
+    client_ = g_socket_client_new();
+    g_socket_client_set_timeout(client_, HTTP_TIMEOUT);
+}
+
+HttpConnection::~HttpConnection()
+{
+    disconnect();
+    g_object_unref(client_);
+}
+
+const std::string &HttpConnection::host() const
+{
+    return host_;
+}
+
+guint16 HttpConnection::port() const
+{
+    return port_;
+}
+
+std::string HttpConnection::hostHeader() const
+{
+    if (host_.find(':') != std::string::npos)
+        return "[" + host_ + "]:" + std::to_string(port_);
+    return host_ + ":" + std::to_string(port_);
+}
+
+bool HttpConnection::connected() const
+{
+    return !!conn_;
+}
+
+void HttpConnection::disconnect()
+{
+    if (in_) {
+        g_object_unref(in_);
+        in_ = nullptr;
+    }
+    if (conn_) {
+        g_io_stream_close(G_IO_STREAM(conn_), nullptr, nullptr);
+        g_object_unref(conn_);
+        conn_ = nullptr;
+    }
+}
+
+bool HttpConnection::send(const std::string &requests)
+{
+    GError *error = nullptr;
+    if (!conn_) {
+        conn_ = g_socket_client_connect_to_host(client_, host_.c_str(), port_,
+            nullptr, &error);
+        if (!conn_) {
+            LOG_WARNING(0, "Failed to connect to '%s:%u': %s", host_.c_str(),
+                port_, error ? error->message : "unknown");
+            if (error)
+                g_error_free(error);
+            return false;
+        }
+
+        in_ = g_data_input_stream_new(
+            g_io_stream_get_input_stream(G_IO_STREAM(conn_)));
+        g_data_input_stream_set_newline_type(in_,
+            G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+    }
+
+    auto out = g_io_stream_get_output_stream(G_IO_STREAM(conn_));
+    gsize written = 0;
+    bool ok = g_output_stream_write_all(out, requests.data(), requests.size(),
+        &written, nullptr, &error);
+    if (error)
+        g_error_free(error);
+    if (!ok)
+        disconnect();
+    return ok;
+}
+
+bool HttpConnection::readLine(std::string &line)
+{
+    gsize length = 0;
+    GError *error = nullptr;
+    char *text = g_data_input_stream_read_line(in_, &length, nullptr, &error);
+    if (error)
+        g_error_free(error);
+    if (!text)
+        return false;
+    line.assign(text, length);
+    g_free(text);
+    return true;
+}
+
+bool HttpConnection::readBytes(gsize size, std::string &body, gsize maxBody)
+{
+    // the size comes from the server, do not allocate it blindly
+    auto offset = body.size();
+    if (size > maxBody - offset) {
+        LOG_WARNING(0, "Response body of '%s' exceeds %zu bytes", host_.c_str(),
+            static_cast<size_t>(maxBody));
+        return false;
+    }
+    body.resize(offset + size);
+    gsize read = 0;
+    GError *error = nullptr;
+    bool ok = g_input_stream_read_all(G_INPUT_STREAM(in_), &body[offset], size,
+        &read, nullptr, &error);
+    if (error)
+        g_error_free(error);
+    return ok && read == size;
+}
+
+bool HttpConnection::receive(Response &resp, bool head, gsize maxBody)
+{
+    resp = Response();
+    if (!conn_)
+        return false;
+
+    std::string line;
+    if (!readLine(line) || line.compare(0, 5, "HTTP/")) {
+        disconnect();
+        return false;
+    }
+
+    // HTTP/1.0 closes unless asked otherwise, we do not ask
+    resp.keepAlive = line.compare(0, 8, "HTTP/1.0");
+    auto space = line.find(' ');
+    resp.status = (space == std::string::npos) ? 0 : std::atoi(line.c_str() + space + 1);
+
+    while (true) {
+        if (!readLine(line)) {
+            disconnect();
+            return false;
+        }
+        if (line.empty())
+            break;
+        auto colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+        auto name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(),
+            [](unsigned char c) { return std::tolower(c); });
+        auto start = line.find_first_not_of(' ', colon + 1);
+        resp.headers[name] = (start == std::string::npos) ? std::string() : line.substr(start);
+    }
+
+    auto header = [&resp](const char *name) -> const std::string * {
+        auto it = resp.headers.find(name);
+        return (it == resp.headers.end()) ? nullptr : &it->second;
+    };
+
+    if (auto conn = header("connection"))
+        resp.keepAlive = strncasecmp(conn->c_str(), "close", 5);
+
+    bool ok = true;
+    auto encoding = header("transfer-encoding");
+    auto length = header("content-length");
+    if (head || resp.status == 204 || resp.status == 304 || resp.status / 100 == 1) {
+        // no body
+    } else if (encoding && !strncasecmp(encoding->c_str(), "chunked", 7)) {
+        while (ok) {
+            ok = readLine(line);
+            if (!ok)
+                break;
+            auto size = std::strtoul(line.c_str(), nullptr, 16);
+            if (!size)
+                break;
+            ok = readBytes(size, resp.body, maxBody) && readLine(line);
+        }
+        // skip trailers
+        while (ok) {
+            ok = readLine(line);
+            if (line.empty())
+                break;
+        }
+    } else if (length) {
+        ok = readBytes(std::strtoull(length->c_str(), nullptr, 10), resp.body, maxBody);
+    } else {
+        // body ends with the connection
+        resp.keepAlive = false;
+        char buf[4096];
+        gssize n;
+        while ((n = g_input_stream_read(G_INPUT_STREAM(in_), buf, sizeof(buf),
+                nullptr, nullptr)) > 0) {
+            if (static_cast<gsize>(n) > maxBody - resp.body.size()) {
+                LOG_WARNING(0, "Response body of '%s' exceeds %zu bytes",
+                    host_.c_str(), static_cast<size_t>(maxBody));
+                ok = false;
+                break;
+            }
+            resp.body.append(buf, n);
+        }
+    }
+
+    if (!ok || !resp.keepAlive)
+        disconnect();
+    return ok;
+}
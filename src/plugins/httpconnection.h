@@ -0,0 +1,135 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <gio/gio.h>
+
+#include <string>
+#include <map>
+
+/// Connect and read timeout of HTTP requests in seconds.
+#define HTTP_TIMEOUT 30
+/// Default maximum size of a response body in bytes.
+#define HTTP_BODY_MAX (8 * 1024 * 1024)
+
+/**
+ * \brief Plain HTTP/1.1 client connection.
+ *
+ * A minimal blocking HTTP client for the servers on the local network.
+ * The connection is kept open between requests as long as the server
+ * allows it, requests may be written before earlier responses have
+ * been read.
+ *
+ * The connection is not thread-safe.
+ */
+class HttpConnection
+{
+public:
+    /// A received response.
+    struct Response {
+        /// The HTTP status code.
+        int status = 0;
+        /// Header values by lower case header name.
+        std::map<std::string, std::string> headers;
+        /// The response body.
+        std::string body;
+        /// If the server keeps the connection open.
+        bool keepAlive = true;
+    };
+
+    /**
+     * \brief Split a http url.
+     *
+     * \param[in] url The absolute http url.
+     * \param[out] host The host name without IPv6 brackets.
+     * \param[out] port The port.
+     * \param[out] path The path with query.
+     * \return False if this is not a http url.
+     */
+    static bool parseUrl(const std::string &url, std::string &host,
+        guint16 &port, std::string &path);
+
+    /**
+     * \brief Create connection to a server.
+     *
+     * The connection is opened with the first request.
+     *
+     * \param[in] host The server host.
+     * \param[in] port The server port.
+     */
+    HttpConnection(const std::string &host, guint16 port);
+
+    virtual ~HttpConnection();
+
+    /// Host name of the server.
+    const std::string &host() const;
+
+    /// Port of the server.
+    guint16 port() const;
+
+    /// Host header value of the server.
+    std::string hostHeader() const;
+
+    /**
+     * \brief Write requests.
+     *
+     * Opens the connection if required.
+     *
+     * \param[in] requests One or more complete requests.
+     * \return False on error.
+     */
+    bool send(const std::string &requests);
+
+    /**
+     * \brief Read the next response.
+     *
+     * \param[out] resp The response.
+     * \param[in] head True if the response belongs to a HEAD request.
+     * \param[in] maxBody Larger bodies fail the response.
+     * \return False if the response could not be read, the connection
+     *         is closed then.
+     */
+    bool receive(Response &resp, bool head = false, gsize maxBody = HTTP_BODY_MAX);
+
+    /// Check if the connection is open.
+    bool connected() const;
+
+    /// Close the connection.
+    void disconnect();
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// Read a header or chunk size line without CRLF.
+    bool readLine(std::string &line);
+
+    /// Read exactly size bytes and append them to body if the body
+    /// stays within maxBody.
+    bool readBytes(gsize size, std::string &body, gsize maxBody);
+
+    /// Host name of the server.
+    std::string host_;
+    /// Port of the server.
+    guint16 port_;
+
+    GSocketClient *client_ = nullptr;
+    GSocketConnection *conn_ = nullptr;
+    GDataInputStream *in_ = nullptr;
+};
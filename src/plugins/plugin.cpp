@@ -18,9 +18,14 @@
 #include "ideviceobserver.h"
 #include "configurator.h"
 #include "cachemanager.h"
+#include "thumbnailcollector.h"
+#include "thumbnailquota.h"
 #include <algorithm>
 #include <filesystem>
 #include <cinttypes>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
 
 #include <gio/gio.h>
 
@@ -89,6 +94,7 @@ bool Plugin::injectDevice(std::shared_ptr<Device> device)
     if (!hasDevice(device->uri())) {
         std::unique_lock lock(lock_);
         devices_.emplace(device->uri(), device);
+        publishDevices();
         isNew = true;
     }
 
@@ -107,6 +113,7 @@ bool Plugin::injectDevice(const std::string &uri, int alive, bool avail, std::st
         std::unique_lock lock(lock_);
         LOG_DEBUG("Make new device for uri : %s, uuid : %s", uri.c_str(), uuid.c_str());
         devices_[uri] = std::make_shared<Device>(uri, alive, avail, uuid);
+        publishDevices();
         isNew = true;
     } else {
         auto dev = device(uri);
@@ -133,6 +140,7 @@ bool Plugin::addDevice(const std::string &uri, int alive)
             dev->init();
             LOG_DEBUG("Make new device for uri : %s", uri.c_str());
             devices_[uri] = dev;
+            publishDevices();
             isNew = true;
         }
     }
@@ -166,6 +174,7 @@ bool Plugin::addDevice(const std::string &uri, const std::string &mp, std::strin
             dev->init();
             dev->setMountpoint(mp);
             devices_[uri] = dev;
+            publishDevices();
             isNew = true;
         }
     }
@@ -233,9 +242,22 @@ bool Plugin::hasDevice(const std::string &uri) const
 
 std::shared_ptr<Device> Plugin::device(const std::string &uri) const
 {
-    std::shared_lock lock(lock_);
+    // called for every discovery event and media item, do not contend
+    // with the observer notifications holding lock_
+    auto devices = std::atomic_load(&snapshot_);
+    if (!devices)
+        return nullptr;
+
+    auto it = devices->find(uri);
+    if (it != devices->end())
+        return it->second;
 
-    return deviceUnlocked(uri);
+    for (auto &dev : *devices) {
+        if (matchUri(dev.first, uri))
+            return dev.second;
+    }
+
+    return nullptr;
 }
 
 void Plugin::checkDevices(void)
@@ -317,6 +339,7 @@ bool Plugin::doFileTreeWalkWithCache(const std::shared_ptr<Device>& device,
         return doFileTreeWalk(device, observer, mountPoint);
     }
 
+    bool complete = true;
     try {
         for (const auto &file : fs::recursive_directory_iterator(mountPoint)) {
             std::error_code err;
@@ -340,9 +363,16 @@ bool Plugin::doFileTreeWalkWithCache(const std::shared_ptr<Device>& device,
 
             auto type = typeInfo.first;
             auto extractorType = typeInfo.second;
-            auto fileSize = file.file_size();
-            auto lastWrite = file.last_write_time();
-            auto hash = static_cast<unsigned long>(lastWrite.time_since_epoch().count());
+            // one stat() per file, the result is handed down to the
+            // extractors through the media item
+            struct stat st;
+            if (stat(path.c_str(), &st) < 0) {
+                LOG_WARNING(0, "stat error for '%s', caused by : %s", path.c_str(),
+                        strerror(errno));
+                continue;
+            }
+            auto fileSize = static_cast<unsigned long>(st.st_size);
+            auto hash = MediaItem::hashFromModifiedTime(st.st_mtim);
 
             // check the cache whether exist or not
             bool exist = cache->isExist(path, hash);
@@ -355,7 +385,7 @@ bool Plugin::doFileTreeWalkWithCache(const std::shared_ptr<Device>& device,
             }
 
             MediaItemPtr mi = std::make_unique<MediaItem>(device, path, mimeType, hash,
-                    fileSize, ext, type, extractorType);
+                    fileSize, ext, type, extractorType, st.st_mtime);
             auto thumbnail = mi->getThumbnailFileName();
             cache->insertItem(path, hash, type, thumbnail);
             observer->newMediaItem(std::move(mi));
@@ -363,6 +393,7 @@ bool Plugin::doFileTreeWalkWithCache(const std::shared_ptr<Device>& device,
     } catch (const std::exception &ex) {
         LOG_ERROR(0, "Exception caught while traversing through '%s', exception : %s",
             mountPoint.c_str(), ex.what());
+        complete = false;
     }
     LOG_INFO(0, "File-tree-walk(with cache) on device '%s' has been completed",
         device->uri().c_str());
@@ -382,9 +413,16 @@ bool Plugin::doFileTreeWalkWithCache(const std::shared_ptr<Device>& device,
         // let's first remove thumbnail.
         std::string filePath = THUMBNAIL_DIRECTORY + device->uuid() + "/" + thumb;
         std::filesystem::remove(filePath);
+        ThumbnailQuota::instance()->remove(filePath);
         // now, we have to remove database for syncronization
         observer->removeMediaItem(std::move(mi));
     }
+
+    // the cache now knows every media item on the device, anything
+    // else in the thumbnail directory is an orphan
+    if (complete)
+        ThumbnailCollector::instance()->collect(device->uuid(), cache->thumbnailIds());
+
     bool ret = cacheMgr->generateCacheFile(device->uri(), cache);
     if (!ret)
         LOG_WARNING(0, "Cache file generation fail for '%s'", device->uri().c_str());
@@ -423,11 +461,18 @@ bool Plugin::doFileTreeWalk(const std::shared_ptr<Device> &device,
 
             auto type = typeInfo.first;
             auto extractorType = typeInfo.second;
-            auto lastWrite = file.last_write_time();
-            auto fileSize = file.file_size();
-            auto hash = static_cast<unsigned long>(lastWrite.time_since_epoch().count());
+            // one stat() per file, the result is handed down to the
+            // extractors through the media item
+            struct stat st;
+            if (stat(path.c_str(), &st) < 0) {
+                LOG_WARNING(0, "stat error for '%s', caused by : %s", path.c_str(),
+                        strerror(errno));
+                continue;
+            }
+            auto fileSize = static_cast<unsigned long>(st.st_size);
+            auto hash = MediaItem::hashFromModifiedTime(st.st_mtim);
             MediaItemPtr mi = std::make_unique<MediaItem>(device, path, mimeType, hash,
-                    fileSize, ext, type, extractorType);
+                    fileSize, ext, type, extractorType, st.st_mtime);
             auto thumbnail = mi->getThumbnailFileName();
             cache->insertItem(path, hash, type, thumbnail);
             observer->newMediaItem(std::move(mi));
@@ -453,6 +498,9 @@ bool Plugin::doFileTreeWalk(const std::shared_ptr<Device> &device,
     LOG_INFO(0, "File-tree-walk on device '%s' has been completed",
         device->uri().c_str());
 
+    // thumbnails left from a lost cache are not referenced anymore
+    ThumbnailCollector::instance()->collect(device->uuid(), cache->thumbnailIds());
+
     bool ret = cacheMgr->generateCacheFile(device->uri(), cache);
     if (!ret)
         LOG_WARNING(0, "Cache file generation fail for '%s'", device->uri().c_str());
@@ -523,6 +571,13 @@ Plugin::Plugin(const std::string &uri) :
     // Nothing to be done here.
 }
 
+void Plugin::publishDevices()
+{
+    std::atomic_store(&snapshot_,
+        std::shared_ptr<const std::map<std::string, std::shared_ptr<Device>>>(
+            std::make_shared<std::map<std::string, std::shared_ptr<Device>>>(devices_)));
+}
+
 std::shared_ptr<Device> Plugin::deviceUnlocked(const std::string &uri) const
 {
     for (auto &dev : devices_) {
@@ -236,6 +236,10 @@ private:
     /// Like device() but does not acquire the lock.
     std::shared_ptr<Device> deviceUnlocked(const std::string &uri) const;
 
+    /// Publish a copy of the device map for device(), lock_ held
+    /// exclusively.
+    void publishDevices();
+
     /// Adds observer and returns true if this was the first one, you
     /// can use the method with nullptr to check if there is only a
     /// single oberserver registered.
@@ -274,6 +278,9 @@ private:
     std::string uri_;
     /// Map of devices to their uri detected by this plugin.
     std::map<std::string, std::shared_ptr<Device>> devices_;
+    /// Read-only copy of devices_ for lookups without lock_, replaced
+    /// atomically on every device map change.
+    std::shared_ptr<const std::map<std::string, std::shared_ptr<Device>>> snapshot_;
     /// List of device notification observers.
     std::list<IDeviceObserver *> deviceObservers_;
 };
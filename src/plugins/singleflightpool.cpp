@@ -0,0 +1,66 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "singleflightpool.h"
+
+#include <memory>
+
+SingleFlightPool::SingleFlightPool(int threads)
+{
+    pool_ = g_thread_pool_new((GFunc) &SingleFlightPool::run, this, threads,
+        FALSE, NULL);
+}
+
+SingleFlightPool::~SingleFlightPool()
+{
+    // let queued jobs finish, they own their requests
+    g_thread_pool_free(pool_, FALSE, TRUE);
+}
+
+bool SingleFlightPool::push(const std::string &key, Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!pending_.insert(key).second)
+            return false;
+    }
+
+    auto req = new Request{key, std::move(job)};
+    GError *error = NULL;
+    if (!g_thread_pool_push(pool_, req, &error)) {
+        LOG_ERROR(0, "Fail occurred in g_thread_pool_push");
+        if (error) {
+            LOG_ERROR(0, "Error message : %s", error->message);
+            g_error_free(error);
+        }
+        delete req;
+        std::lock_guard<std::mutex> lock(lock_);
+        pending_.erase(key);
+        return false;
+    }
+    return true;
+}
+
+void SingleFlightPool::run(gpointer data, gpointer userData)
+{
+    std::unique_ptr<Request> req(static_cast<Request *>(data));
+    auto pool = static_cast<SingleFlightPool *>(userData);
+
+    req->job();
+
+    std::lock_guard<std::mutex> lock(pool->lock_);
+    pool->pending_.erase(req->key);
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <glib.h>
+
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+
+/**
+ * \brief Bounded thread pool running one job per key at a time.
+ *
+ * A job for a key that is already queued or running is dropped, so a
+ * burst of requests for the same key costs a single run. The key can
+ * be pushed again once its job has finished.
+ */
+class SingleFlightPool
+{
+public:
+    /// A job run in the pool.
+    typedef std::function<void()> Job;
+
+    /**
+     * \brief Create the pool.
+     *
+     * \param[in] threads Maximum number of concurrently running jobs.
+     */
+    SingleFlightPool(int threads);
+
+    /// Waits for the queued jobs.
+    virtual ~SingleFlightPool();
+
+    /**
+     * \brief Queue a job unless one for the key is queued or running.
+     *
+     * \param[in] key The job key.
+     * \param[in] job The job.
+     * \return False if the job has been dropped.
+     */
+    bool push(const std::string &key, Job job);
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// A queued job.
+    struct Request {
+        std::string key;
+        Job job;
+    };
+
+    /// Run a job in the pool, deletes the request.
+    static void run(gpointer data, gpointer userData);
+
+    GThreadPool *pool_ = nullptr;
+    /// Keys with a job queued or running.
+    std::set<std::string> pending_;
+    /// Lock for pending_.
+    std::mutex lock_;
+};
@@ -0,0 +1,124 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "soapclient.h"
+
+
+/// Escape text for XML element content.
+static std::string xmlEscape(const std::string &text)
+{
+    std::string out;
+    out.reserve(text.size());
+    for (auto c : text) {
+        switch (c) {
+        case '&': out += "&amp;"; break;
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '"': out += "&quot;"; break;
+        case '\'': out += "&apos;"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+SoapClient::SoapClient(const std::string &controlUrl)
+{
+    std::string host;
+    guint16 port = 0;
+    usable_ = HttpConnection::parseUrl(controlUrl, host, port, path_);
+    if (usable_)
+        conn_ = std::make_unique<HttpConnection>(host, port);
+}
+
+SoapClient::~SoapClient()
+{
+    // nothing to be done here
+}
+
+bool SoapClient::usable() const
+{
+    return usable_;
+}
+
+std::string SoapClient::envelope(const std::string &action,
+    const std::string &serviceType, const Arguments &args)
+{
+    std::string body =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+        "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+        "s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\">"
+        "<s:Body><u:" + action + " xmlns:u=\"" + serviceType + "\">";
+    for (const auto &[name, value] : args)
+        body += "<" + name + ">" + xmlEscape(value) + "</" + name + ">";
+    body += "</u:" + action + "></s:Body></s:Envelope>";
+    return body;
+}
+
+bool SoapClient::post(const std::string &soapAction,
+    const std::vector<std::string> &bodies, std::vector<std::string> &responses)
+{
+    responses.clear();
+    if (!usable_ || bodies.empty())
+        return bodies.empty();
+
+    std::string requests;
+    for (const auto &body : bodies) {
+        requests += "POST " + path_ + " HTTP/1.1\r\n"
+            "Host: " + conn_->hostHeader() + "\r\n"
+            "Content-Type: text/xml; charset=\"utf-8\"\r\n"
+            "SOAPACTION: \"" + soapAction + "\"\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "Connection: keep-alive\r\n"
+            "\r\n" + body;
+    }
+
+    // a connection that has been idle might have been closed by the
+    // server, in that case retry once on a new connection
+    bool reused = conn_->connected();
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool keepAlive = conn_->send(requests);
+        while (keepAlive && responses.size() < bodies.size()) {
+            HttpConnection::Response resp;
+            if (!conn_->receive(resp))
+                break;
+            keepAlive = resp.keepAlive;
+            // a fault does not affect the connection, only this request
+            if (resp.status != 200) {
+                LOG_WARNING(0, "SOAP request to '%s' failed with status %i",
+                    conn_->hostHeader().c_str(), resp.status);
+                resp.body.clear();
+            }
+            responses.push_back(std::move(resp.body));
+        }
+
+        if (responses.size() == bodies.size() && keepAlive)
+            return true;
+
+        conn_->disconnect();
+        if (!responses.empty() || !reused) {
+            // the server does not keep the connection open for us
+            LOG_INFO(0, "No keep-alive from '%s', fall back",
+                conn_->hostHeader().c_str());
+            usable_ = false;
+            return responses.size() == bodies.size();
+        }
+        reused = false;
+    }
+
+    usable_ = false;
+    return false;
+}
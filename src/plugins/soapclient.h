@@ -0,0 +1,95 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+#include "httpconnection.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <memory>
+
+/**
+ * \brief SOAP client with a persistent HTTP connection.
+ *
+ * Keeps one HTTP/1.1 keep-alive connection to a control url and allows
+ * several requests to be sent before the responses are read. Once the
+ * server refuses to keep the connection open the client reports that
+ * it is not usable and the caller should fall back to the libupnp
+ * actions.
+ *
+ * The client is not thread-safe, the caller has to serialize requests.
+ */
+class SoapClient
+{
+public:
+    /// Action arguments in order.
+    using Arguments = std::vector<std::pair<std::string, std::string>>;
+
+    /**
+     * \brief Create client for a control url.
+     *
+     * \param[in] controlUrl The absolute http control url.
+     */
+    SoapClient(const std::string &controlUrl);
+
+    virtual ~SoapClient();
+
+    /**
+     * \brief Check if the server keeps connections open.
+     *
+     * \return False if requests should not be sent with this client.
+     */
+    bool usable() const;
+
+    /**
+     * \brief Build the SOAP envelope of an action.
+     *
+     * \param[in] action The action name.
+     * \param[in] serviceType The service type.
+     * \param[in] args The action arguments.
+     * \return The request body.
+     */
+    static std::string envelope(const std::string &action,
+        const std::string &serviceType, const Arguments &args);
+
+    /**
+     * \brief Send requests pipelined and read their responses.
+     *
+     * \param[in] soapAction The SOAPACTION header value.
+     * \param[in] bodies The request bodies.
+     * \param[out] responses The response bodies in request order, may
+     *             be less than requests if the connection failed. The
+     *             body of a failed request is empty.
+     * \return False if not all responses have been received.
+     */
+    bool post(const std::string &soapAction,
+        const std::vector<std::string> &bodies,
+        std::vector<std::string> &responses);
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// Request path.
+    std::string path_;
+    /// If the server supports keep-alive, cleared once it closes.
+    bool usable_ = true;
+    /// Connection to the server.
+    std::unique_ptr<HttpConnection> conn_;
+};
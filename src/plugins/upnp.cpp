@@ -21,6 +21,11 @@
 #include <sstream>
 #include <algorithm>
 #include <thread>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <pbnjson.hpp>
 
 #include "upnptools.h"
 
@@ -44,12 +49,26 @@ Upnp::Upnp() : Plugin(Upnp::uri)
     auto err = UpnpInit2(NULL, 0);
     if (err)
         LOG_CRITICAL(0, "UpnpInit2() failed (%i)", err);
+    loadDescriptions();
+    discovery_ = std::make_unique<SingleFlightPool>(UPNP_DISCOVERY_THREADS);
+    expiryTask_ = std::thread(&Upnp::expiryLoop, this);
+    artFetcher_ = std::make_unique<ArtFetcher>();
 }
 
 Upnp::~Upnp()
 {
     // Unwind UPnP stack.
     runDeviceDetection(false);
+    artFetcher_.reset();
+    // let queued downloads finish
+    discovery_.reset();
+    {
+        std::lock_guard<std::mutex> lock(expiryLock_);
+        expiryExit_ = true;
+    }
+    expiryCv_.notify_one();
+    if (expiryTask_.joinable())
+        expiryTask_.join();
     auto err = UpnpFinish();
     if (err)
         LOG_ERROR(0, "UpnpFinish() failed (%i)", err);
@@ -139,14 +158,10 @@ int Upnp::eventCallback(Upnp_EventType eventType, const void *event,
         /// void**.
         static_cast<Upnp *>(cookie)->serviceFound(&event);
         break;
-    case UPNP_DISCOVERY_SEARCH_TIMEOUT: {
-        LOG_DEBUG("UPnP advertisement search timeout, respawn");
-        auto plugin = static_cast<Upnp *>(cookie);
-        plugin->checkDevices();
-        UpnpSearchAsync(plugin->upnpHandle(), upnpSearchTimeout_,
-            upnpDeviceCategory_, cookie);
+    case UPNP_DISCOVERY_SEARCH_TIMEOUT:
+        // devices expire by their advertisements, no need to poll
+        LOG_DEBUG("UPnP advertisement search timeout");
         break;
-    }
     case UPNP_EVENT_SUBSCRIPTION_REQUEST:
         LOG_DEBUG("UPnP subscription request, ignore");
         break;
@@ -191,18 +206,50 @@ IXML_Document *Upnp::actionResult(UpnpActionComplete *event)
     return res;
 }
 
-void Upnp::getDeviceMeta(Upnp *plugin, std::string uri, std::string location)
+void Upnp::getDeviceMeta(const MetaRequest &req)
+{
+    DeviceDescription desc;
+    bool cached = false;
+    {
+        std::lock_guard<std::mutex> lock(descriptionLock_);
+        auto it = descriptions_.find(req.uri);
+        if (it != descriptions_.end() && it->second.key == req.key) {
+            it->second.used = g_get_real_time();
+            desc = it->second;
+            cached = true;
+        }
+    }
+
+    if (cached) {
+        LOG_DEBUG("Use cached description for '%s'", req.uri.c_str());
+    } else if (downloadDescription(req.location, desc)) {
+        desc.key = req.key;
+        desc.used = g_get_real_time();
+        std::lock_guard<std::mutex> lock(descriptionLock_);
+        // a new server version keeps the learned browse chunk
+        auto &known = descriptions_[req.uri];
+        desc.browseChunk = known.browseChunk;
+        known = desc;
+        saveDescriptions();
+    } else {
+        return;
+    }
+
+    applyDescription(req.uri, desc);
+}
+
+bool Upnp::downloadDescription(const std::string &location,
+    DeviceDescription &desc) const
 {
     // now read the service description xml
     IXML_Document *descDoc = nullptr;
-    std::string meta;
     const DOMString t;
 
     LOG_DEBUG("Get meta data from: '%s'", location.c_str());
 
     UpnpDownloadXmlDoc(location.c_str(), &descDoc);
     if (!descDoc)
-        return;
+        return false;
 
     // strip the base uri from the location
     auto baseUri(location);
@@ -212,42 +259,125 @@ void Upnp::getDeviceMeta(Upnp *plugin, std::string uri, std::string location)
     baseUri.erase(idx, baseUri.end());
 
     // blacklist the plugin if the required service is not found
-    auto controlUrl = plugin->checkServiceCategory(descDoc);
-    auto mp = baseUri;
-    if (!controlUrl) {
-        std::lock_guard<std::mutex> lock(plugin->blacklistLock_);
-        plugin->blacklist_.push_back(uri);
+    auto controlUrl = checkServiceCategory(descDoc);
+    desc.contentDirectory = !!controlUrl;
+    if (!controlUrl)
         goto freeDoc;
-    }
 
-    mp += controlUrl;
-
-    // now that we now the device supports the service we are looking
-    // for let's announce it to the observers
-    plugin->addDevice(uri, mp, "", 4);
+    desc.controlUrl = baseUri + controlUrl;
 
-    t = plugin->getNodeText(descDoc, "friendlyName");
-    if (!!t) {
-        meta = t;
-        plugin->modifyDevice(uri, Device::Meta::Name, meta);
-    }
+    t = getNodeText(descDoc, "friendlyName");
+    if (!!t)
+        desc.name = t;
 
-    t = plugin->getNodeText(descDoc, "modelDescription");
-    if (!!t) {
-        meta = t;
-        plugin->modifyDevice(uri, Device::Meta::Description, meta);
-    }
+    t = getNodeText(descDoc, "modelDescription");
+    if (!!t)
+        desc.description = t;
 
-    t = plugin->getNodeText(descDoc, "url"); // is the url inside <icon>, we
+    t = getNodeText(descDoc, "url"); // is the url inside <icon>, we
     // take the first icon
-    if (!!t) {
-        meta = baseUri + t;
-        plugin->modifyDevice(uri, Device::Meta::Icon, meta);
-    }
+    if (!!t)
+        desc.icon = baseUri + t;
 
     // cleanup
  freeDoc:
     ixmlDocument_free(descDoc);
+    return true;
+}
+
+void Upnp::applyDescription(const std::string &uri,
+    const DeviceDescription &desc)
+{
+    if (!desc.contentDirectory) {
+        std::lock_guard<std::mutex> lock(blacklistLock_);
+        blacklist_.insert(uri);
+        return;
+    }
+
+    // now that we now the device supports the service we are looking
+    // for let's announce it to the observers, the mangled device id
+    // gives the server its own thumbnail directory
+    addDevice(uri, desc.controlUrl, uri.substr(Upnp::uri.size() + 3), -1);
+
+    if (!desc.name.empty())
+        modifyDevice(uri, Device::Meta::Name, desc.name);
+    if (!desc.description.empty())
+        modifyDevice(uri, Device::Meta::Description, desc.description);
+    if (!desc.icon.empty())
+        modifyDevice(uri, Device::Meta::Icon, desc.icon);
+}
+
+void Upnp::loadDescriptions()
+{
+    auto root = pbnjson::JDomParser::fromFile(UPNP_DESCRIPTION_CACHE_FILE);
+    if (!root.isObject())
+        return;
+
+    std::lock_guard<std::mutex> lock(descriptionLock_);
+    for (auto entry : root.children()) {
+        auto val = entry.second;
+        if (!val.isObject() || !val.hasKey("key"))
+            continue;
+        DeviceDescription desc;
+        desc.key = val["key"].asString();
+        desc.contentDirectory = val["contentDirectory"].asBool();
+        desc.controlUrl = val["controlUrl"].asString();
+        desc.name = val["name"].asString();
+        desc.description = val["description"].asString();
+        desc.icon = val["icon"].asString();
+        desc.used = val["used"].asNumber<int64_t>();
+        if (val.hasKey("browseChunk"))
+            desc.browseChunk = val["browseChunk"].asNumber<int32_t>();
+        descriptions_[entry.first.asString()] = desc;
+    }
+    LOG_INFO(0, "Loaded %zu cached UPnP device descriptions",
+        descriptions_.size());
+}
+
+void Upnp::saveDescriptions() const
+{
+    // keep the most recently used descriptions only
+    std::vector<std::pair<gint64, const std::string *>> order;
+    for (const auto &[uri, desc] : descriptions_)
+        order.push_back({desc.used, &uri});
+    std::sort(order.begin(), order.end(),
+        [] (const auto &a, const auto &b) { return a.first > b.first; });
+    if (order.size() > UPNP_DESCRIPTION_CACHE_MAX)
+        order.resize(UPNP_DESCRIPTION_CACHE_MAX);
+
+    auto root = pbnjson::Object();
+    for (const auto &[used, uri] : order) {
+        const auto &desc = descriptions_.at(*uri);
+        auto val = pbnjson::Object();
+        val.put("key", desc.key);
+        val.put("contentDirectory", desc.contentDirectory);
+        val.put("controlUrl", desc.controlUrl);
+        val.put("name", desc.name);
+        val.put("description", desc.description);
+        val.put("icon", desc.icon);
+        val.put("used", static_cast<int64_t>(desc.used));
+        val.put("browseChunk", desc.browseChunk);
+        root.put(*uri, val);
+    }
+
+    // write to a temporary file first so a crash never leaves a
+    // truncated file behind
+    std::error_code err;
+    std::filesystem::create_directories(
+        std::filesystem::path(UPNP_DESCRIPTION_CACHE_FILE).parent_path(), err);
+    std::string tmpFile = std::string(UPNP_DESCRIPTION_CACHE_FILE) + ".tmp";
+    {
+        std::ofstream out(tmpFile, std::ios::trunc);
+        out << root.stringify();
+        if (!out.good()) {
+            LOG_WARNING(0, "Failed to write '%s'", tmpFile.c_str());
+            return;
+        }
+    }
+    std::filesystem::rename(tmpFile, UPNP_DESCRIPTION_CACHE_FILE, err);
+    if (err)
+        LOG_WARNING(0, "Failed to save UPnP device descriptions, error : %s",
+            err.message().c_str());
 }
 
 int Upnp::runDeviceDetection(bool start)
@@ -258,9 +388,18 @@ int Upnp::runDeviceDetection(bool start)
         if (err)
             LOG_ERROR(0, "UpnpRegisterClient() failed (%i)", err);
 
+        // servers announce themselves, search only once and again
+        // when the network changes
         UpnpSearchAsync(upnpHandle_, upnpSearchTimeout_,
             upnpDeviceCategory_, static_cast<void *>(this));
+        networkHandler_ = g_signal_connect(g_network_monitor_get_default(),
+            "network-changed", G_CALLBACK(Upnp::networkChanged), this);
     } else {
+        if (networkHandler_) {
+            g_signal_handler_disconnect(g_network_monitor_get_default(),
+                networkHandler_);
+            networkHandler_ = 0;
+        }
         auto err = UpnpUnRegisterClient(upnpHandle_);
         if (err)
             LOG_ERROR(0, "UpnpUnRegisterClient() failed (%i)", err);
@@ -268,6 +407,63 @@ int Upnp::runDeviceDetection(bool start)
     return 0;
 }
 
+void Upnp::networkChanged(GNetworkMonitor *monitor, gboolean available,
+    gpointer userData)
+{
+    if (!available)
+        return;
+
+    LOG_DEBUG("Network changed, search for UPnP servers");
+    auto plugin = static_cast<Upnp *>(userData);
+    UpnpSearchAsync(plugin->upnpHandle(), upnpSearchTimeout_,
+        upnpDeviceCategory_, userData);
+}
+
+void Upnp::renewDevice(const std::string &uri, int maxAge)
+{
+    if (maxAge <= 0)
+        maxAge = UPNP_DEFAULT_MAX_AGE;
+
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::seconds(maxAge + UPNP_EXPIRY_GRACE);
+    bool earlier = false;
+    {
+        std::lock_guard<std::mutex> lock(expiryLock_);
+        auto it = deadlines_.find(uri);
+        earlier = (it == deadlines_.end() || deadline < it->second);
+        deadlines_[uri] = deadline;
+    }
+    if (earlier)
+        expiryCv_.notify_one();
+}
+
+void Upnp::expiryLoop()
+{
+    std::unique_lock<std::mutex> lock(expiryLock_);
+    while (!expiryExit_) {
+        // few servers per network, a linear search for the next
+        // deadline is cheaper than keeping a second index
+        auto next = std::min_element(deadlines_.begin(), deadlines_.end(),
+            [] (const auto &a, const auto &b) { return a.second < b.second; });
+        if (next == deadlines_.end()) {
+            expiryCv_.wait(lock);
+            continue;
+        }
+
+        if (next->second > std::chrono::steady_clock::now()) {
+            expiryCv_.wait_until(lock, next->second);
+            continue;
+        }
+
+        auto uri = next->first;
+        deadlines_.erase(next);
+        lock.unlock();
+        LOG_INFO(0, "Advertisement of '%s' expired", uri.c_str());
+        removeDevice(uri);
+        lock.lock();
+    }
+}
+
 void Upnp::serviceFound(const void *event)
 {
     /// @todo Remove ugly event hack once libupnp includes 6556b0b.
@@ -281,8 +477,7 @@ void Upnp::serviceFound(const void *event)
     {
         // check if device is blacklisted and shall be ignored
         std::lock_guard<std::mutex> lock(blacklistLock_);
-        auto it = std::find(blacklist_.begin(), blacklist_.end(), uri);
-        if (it != blacklist_.end()) {
+        if (blacklist_.find(uri) != blacklist_.end()) {
             LOG_DEBUG("Device '%s' blacklisted, ignore", uri.c_str());
             return;
         }
@@ -297,16 +492,26 @@ void Upnp::serviceFound(const void *event)
     bool requestMeta = !dev;
     if (!!dev) {
         requestMeta = !dev->available();
-        addDevice(uri, 4); // refresh the available state as this
-                           // device works with timeouts
+        addDevice(uri, -1); // refresh the available state
     }
 
+    // the device stays available as long as it advertises itself
+    renewDevice(uri, UpnpDiscovery_get_Expires(discovery));
+
     if (requestMeta) {
         // now request the meta data for the new device, make a copy of
-        // location which is destroyed when this method returns
-        std::string loc(UpnpString_get_String(location));
-        std::thread t(getDeviceMeta, this, uri, loc);
-        t.detach(); // worker thread
+        // location which is destroyed when this method returns. The
+        // description changes with the location or the server software
+        // which both come with the advertisement.
+        MetaRequest req;
+        req.uri = uri;
+        req.location = UpnpString_get_String(location);
+        req.key = req.location + " " +
+            UpnpString_get_String(UpnpDiscovery_get_Os(discovery));
+
+        // servers announce every service and re-announce, one
+        // description download per device is enough
+        discovery_->push(uri, [this, req] { getDeviceMeta(req); });
     }
 }
 
@@ -317,6 +522,10 @@ void Upnp::serviceLost(const void *event)
     const UpnpString *deviceId = UpnpDiscovery_get_DeviceID(discovery);
     std::string uri = mangleUri(deviceId);
     LOG_DEBUG("Device said byebye, constructed uri: '%s'", uri.c_str());
+    {
+        std::lock_guard<std::mutex> lock(expiryLock_);
+        deadlines_.erase(uri);
+    }
     removeDevice(uri);
 }
 
@@ -457,8 +666,20 @@ bool Upnp::sendBrowseRequest(const std::string &id, int count,
         browseChunk(id, 0, 0, device);
     } else {
         while (done < count) {
-            auto c = browseChunk(id, done, 10, device);
-            if (c < 0) {
+            // request the next chunks at once to save round trips
+            auto chunk = browseChunkSize(device);
+            std::vector<int> starts;
+            for (int start = done; start < count &&
+                 starts.size() < UPNP_BROWSE_PIPELINE_DEPTH; start += chunk)
+                starts.push_back(start);
+
+            auto expected = std::min(count - done,
+                static_cast<int>(starts.size()) * chunk);
+            auto begin = g_get_monotonic_time();
+            auto c = browseChunks(id, starts, chunk, device);
+            adaptBrowseChunk(device, chunk, starts.size(), expected, c,
+                (g_get_monotonic_time() - begin) / 1000);
+            if (c <= 0) {
                 LOG_ERROR(0, "Browse failed");
                 break;
             }
@@ -504,11 +725,118 @@ int Upnp::browseChunk(const std::string &id, int start, int count,
         }
     }
 
+    return parseBrowseResult(resp, device);
+}
+
+int Upnp::browseChunkSize(const std::shared_ptr<Device> &device) const
+{
+    std::lock_guard<std::mutex> lock(descriptionLock_);
+    auto it = descriptions_.find(device->uri());
+    if (it == descriptions_.end() || !it->second.browseChunk)
+        return UPNP_BROWSE_CHUNK_PROBE;
+    return it->second.browseChunk;
+}
+
+void Upnp::adaptBrowseChunk(const std::shared_ptr<Device> &device, int chunk,
+    int requests, int expected, int found, gint64 elapsed) const
+{
+    int size = chunk;
+    if (found < 0) {
+        size = chunk / 2;
+    } else if (found < expected) {
+        // a chunk came back short, most likely the server limit
+        auto rest = found % chunk;
+        size = rest ? rest : chunk / 2;
+    } else if (elapsed > static_cast<gint64>(requests) * UPNP_BROWSE_SLOW_MS) {
+        size = chunk / 2;
+    } else if (found == requests * chunk) {
+        // only full chunks tell that the server could deliver more
+        size = chunk * 2;
+    }
+    size = std::clamp(size, UPNP_BROWSE_CHUNK_MIN, UPNP_BROWSE_CHUNK_MAX);
+    if (size == chunk)
+        return;
+
+    LOG_DEBUG("Browse chunk for '%s' changed from %i to %i",
+        device->uri().c_str(), chunk, size);
+
+    // remember the size for the next session
+    std::lock_guard<std::mutex> lock(descriptionLock_);
+    auto it = descriptions_.find(device->uri());
+    if (it == descriptions_.end())
+        return;
+    it->second.browseChunk = size;
+    saveDescriptions();
+}
+
+int Upnp::browseChunks(const std::string &id, const std::vector<int> &starts,
+    int count, std::shared_ptr<Device> device) const
+{
+    std::vector<std::string> responses;
+    {
+        std::lock_guard<std::mutex> lock(browseLock_);
+
+        auto &client = soapClients_[device->mountpoint()];
+        if (!client)
+            client = std::make_unique<SoapClient>(device->mountpoint());
+
+        if (client->usable()) {
+            std::vector<std::string> bodies;
+            for (auto start : starts) {
+                bodies.push_back(SoapClient::envelope("Browse",
+                    Upnp::upnpServiceCategory_, {
+                        {"ObjectID", id},
+                        {"BrowseFlag", "BrowseDirectChildren"},
+                        {"Filter", "*"},
+                        {"StartingIndex", std::to_string(start)},
+                        {"RequestedCount", std::to_string(count)},
+                        {"SortCriteria", ""}}));
+            }
+            client->post(std::string(Upnp::upnpServiceCategory_) + "#Browse",
+                bodies, responses);
+        }
+    }
+
+    int done = 0;
+    for (size_t i = 0; i < starts.size(); ++i) {
+        int c = -1;
+        if (i < responses.size()) {
+            auto resp = responses[i].empty() ? nullptr :
+                ixmlParseBuffer(responses[i].c_str());
+            if (resp)
+                c = parseBrowseResult(resp, device);
+        } else {
+            // the connection has been closed, one by one via libupnp
+            c = browseChunk(id, starts[i], count, device);
+        }
+
+        if (c < 0)
+            return done ? done : -1;
+        done += c;
+        // the next chunk does not start where this one ended
+        if (c < count)
+            break;
+    }
+
+    return done;
+}
+
+int Upnp::parseBrowseResult(IXML_Document *resp,
+    std::shared_ptr<Device> device) const
+{
+    auto numText = getNodeText(resp, "NumberReturned");
+    auto totalText = getNodeText(resp, "TotalMatches");
+    if (!numText || !totalText) {
+        LOG_ERROR(0, "Invalid browse response from '%s'", device->uri().c_str());
+        ixmlDocument_free(resp);
+        return -1;
+    }
+
     // how many matches did we receive
-    auto num = std::stoi(getNodeText(resp, "NumberReturned"));
+    auto num = std::stoi(numText);
 
     // if there are no matches skip this
-    auto total = std::stoi(getNodeText(resp, "TotalMatches"));
+    auto total = std::stoi(totalText);
     if (!total) {
         ixmlDocument_free(resp);
         return -1;
@@ -590,6 +918,7 @@ bool Upnp::parseBrowseResponse(IXML_Document *doc,
         }
         MediaItemPtr mi(new MediaItem(device,
                 std::string(id), mime, hash));
+        fetchArt(node, *mi, false);
         obs->newMediaItem(std::move(mi));
         free(id);
     };
@@ -625,6 +954,19 @@ bool Upnp::parseMetaDataResponse(IXML_Document *doc,
         std::abort();
     }
 
+    // only a stored image becomes the thumbnail, the file extension
+    // follows the image type sent by the server
+    IXML_Node *item = nullptr;
+    iterateOnTag(doc, "item", [&item](IXML_Node *node) {
+        if (!item)
+            item = node;
+    });
+    if (item) {
+        auto thumbnail = fetchArt(item, mediaItem, true);
+        if (!thumbnail.empty())
+            mediaItem.setMeta(MediaItem::Meta::Thumbnail, thumbnail);
+    }
+
     return true;
 }
 
@@ -718,6 +1060,55 @@ void Upnp::setMetaOnMediaItem(IXML_Document *doc, MediaItem &mediaItem,
     }
 }
 
+std::string Upnp::artUrl(IXML_Node *item) const
+{
+    std::string tn, sm, albumArt;
+    for (auto child = ixmlNode_getFirstChild(item); child;
+         child = ixmlNode_getNextSibling(child)) {
+        auto name = ixmlNode_getNodeName(child);
+        if (!name)
+            continue;
+        if (!strcmp(name, "upnp:albumArtURI")) {
+            auto text = getNodeText(child);
+            if (text && albumArt.empty())
+                albumArt = text;
+        } else if (!strcmp(name, "res")) {
+            auto text = getNodeText(child);
+            auto info = getAttributeText(child, "protocolInfo");
+            if (text && info) {
+                if (strstr(info, "DLNA.ORG_PN=JPEG_TN") && tn.empty())
+                    tn = text;
+                else if (strstr(info, "DLNA.ORG_PN=JPEG_SM") && sm.empty())
+                    sm = text;
+            }
+            free(info);
+        }
+    }
+
+    if (!tn.empty())
+        return tn;
+    if (!sm.empty())
+        return sm;
+    return albumArt;
+}
+
+std::string Upnp::fetchArt(IXML_Node *item, const MediaItem &mediaItem,
+    bool wait) const
+{
+    auto device = mediaItem.device();
+    auto url = artUrl(item);
+    if (url.empty() || !device || device->uuid().empty())
+        return "";
+
+    auto base = THUMBNAIL_DIRECTORY + device->uuid() + "/" +
+        mediaItem.thumbnailId();
+    if (wait)
+        return artFetcher_->get(url, base);
+    if (!artFetcher_->fetch(url, base))
+        LOG_DEBUG("Album art download of '%s' not queued", url.c_str());
+    return "";
+}
+
 unsigned long Upnp::generateItemHash(IXML_Node *item) const
 {
     unsigned long ret = 0;
@@ -18,10 +18,44 @@
 
 #include "plugin.h"
 #include "logging.h"
+#include "soapclient.h"
+#include "artfetcher.h"
+#include "singleflightpool.h"
 
 #include <upnp.h>
+#include <glib.h>
+#include <gio/gio.h>
 
 #include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+
+/// Maximum number of concurrent device description downloads.
+#define UPNP_DISCOVERY_THREADS 2
+/// Persistent cache of device descriptions.
+#define UPNP_DESCRIPTION_CACHE_FILE CACHE_DIRECTORY "upnp-descriptions.json"
+/// Maximum number of cached device descriptions.
+#define UPNP_DESCRIPTION_CACHE_MAX 64
+/// Smallest number of items requested per browse request.
+#define UPNP_BROWSE_CHUNK_MIN 10
+/// Number of items per browse request for unknown servers.
+#define UPNP_BROWSE_CHUNK_PROBE 100
+/// Largest number of items requested per browse request.
+#define UPNP_BROWSE_CHUNK_MAX 2000
+/// Browse requests slower than this in milliseconds shrink the chunk.
+#define UPNP_BROWSE_SLOW_MS 2000
+/// Number of browse requests sent before the responses are read.
+#define UPNP_BROWSE_PIPELINE_DEPTH 4
+/// Lifetime of an advertisement without CACHE-CONTROL max-age in seconds.
+#define UPNP_DEFAULT_MAX_AGE 1800
+/// Tolerance for late re-advertisements in seconds.
+#define UPNP_EXPIRY_GRACE 10
 
 /// UPnP plugin class definition.
 class Upnp : public Plugin
@@ -82,20 +116,86 @@ private:
      */
     static IXML_Document *actionResult(UpnpActionComplete *event);
 
+    /// Device description download request.
+    struct MetaRequest {
+        /// The device uri.
+        std::string uri;
+        /// The location information from discovery response.
+        std::string location;
+        /// Key of the description in the description cache.
+        std::string key;
+    };
+
+    /// What we need from a device description.
+    struct DeviceDescription {
+        /// Location and server header the description belongs to.
+        std::string key;
+        /// If the device provides the content directory service.
+        bool contentDirectory = false;
+        std::string controlUrl;
+        std::string name;
+        std::string description;
+        std::string icon;
+        /// Last time the description has been used.
+        gint64 used = 0;
+        /// Learned number of items per browse request, 0 if unknown.
+        int browseChunk = 0;
+    };
+
     /**
      * \brief Get device meta data and push it into the device.
      *
-     * \param[in] plugin The plugin instance.
-     * \param[in] uri The device uri.
+     * Runs in the discovery thread pool, the description is taken
+     * from the description cache if it is still valid.
+     *
+     * \param[in] req The description request.
+     */
+    void getDeviceMeta(const MetaRequest &req);
+
+    /**
+     * \brief Download and parse the device description.
+     *
      * \param[in] location The location information from discovery.
-     * response.
+     * \param[out] desc The description.
+     * \return False if the download failed.
+     */
+    bool downloadDescription(const std::string &location,
+        DeviceDescription &desc) const;
+
+    /**
+     * \brief Announce a device from its description.
+     *
+     * \param[in] uri The device uri.
+     * \param[in] desc The description.
      */
-    static void getDeviceMeta(Upnp *plugin, std::string uri,
-        std::string location);
+    void applyDescription(const std::string &uri,
+        const DeviceDescription &desc);
+
+    /// Read the description cache file.
+    void loadDescriptions();
+
+    /// Write the description cache file, descriptionLock_ held.
+    void saveDescriptions() const;
 
     /// From plugin base class.
     int runDeviceDetection(bool start);
 
+    /**
+     * \brief Renew the advertisement lifetime of a device.
+     *
+     * \param[in] uri The device uri.
+     * \param[in] maxAge CACHE-CONTROL max-age of the advertisement in
+     *            seconds.
+     */
+    void renewDevice(const std::string &uri, int maxAge);
+
+    /// Expiry thread main loop.
+    void expiryLoop();
+
+    /// Search for servers again if the network has changed.
+    static void networkChanged(GNetworkMonitor *monitor, gboolean available,
+        gpointer userData);
+
     /**
      * Register newly found service.
      *
@@ -221,6 +321,57 @@ private:
     int browseChunk(const std::string &id, int start, int count,
         std::shared_ptr<Device> device) const;
 
+    /**
+     * \brief Browse several chunks of items pipelined.
+     *
+     * Uses a keep-alive connection to the server, chunks that cannot
+     * be sent that way are requested with browseChunk().
+     *
+     * \param[in] id The object id.
+     * \param[in] starts The start index of each chunk.
+     * \param[in] count The number of items to request per chunk.
+     * \param[in] device The device to browse for scan mode.
+     * \return The number of items found in consecutive chunks or -1
+     *         on error.
+     */
+    int browseChunks(const std::string &id, const std::vector<int> &starts,
+        int count, std::shared_ptr<Device> device) const;
+
+    /**
+     * \brief Get the number of items per browse request for a device.
+     *
+     * \param[in] device The device.
+     * \return The chunk size.
+     */
+    int browseChunkSize(const std::shared_ptr<Device> &device) const;
+
+    /**
+     * \brief Adapt the browse chunk size to the last browse result.
+     *
+     * Grows the chunk while the server answers full chunks quickly,
+     * shrinks it to what the server returns on truncated responses and
+     * on errors or slow responses.
+     *
+     * \param[in] device The device.
+     * \param[in] chunk The chunk size used.
+     * \param[in] requests The number of requests sent.
+     * \param[in] expected The number of items expected.
+     * \param[in] found The number of items found or -1 on error.
+     * \param[in] elapsed The time for all requests in milliseconds.
+     */
+    void adaptBrowseChunk(const std::shared_ptr<Device> &device, int chunk,
+        int requests, int expected, int found, gint64 elapsed) const;
+
+    /**
+     * \brief Handle the response of a browse request.
+     *
+     * \param[in] resp The response document, free'd here.
+     * \param[in] device The device to browse for scan mode.
+     * \return The number of items found or -1 on error.
+     */
+    int parseBrowseResult(IXML_Document *resp,
+        std::shared_ptr<Device> device) const;
+
     /**
      * \brief Handle browse response.
      *
@@ -251,6 +402,30 @@ private:
     void setMetaOnMediaItem(IXML_Document *doc, MediaItem &mediaItem,
         MediaItem::Meta meta) const;
 
+    /**
+     * \brief Find the album art or thumbnail of an item.
+     *
+     * Prefers the DLNA JPEG_TN resource, then JPEG_SM, then
+     * upnp:albumArtURI.
+     *
+     * \param[in] item The item node.
+     * \return The image url or empty string.
+     */
+    std::string artUrl(IXML_Node *item) const;
+
+    /**
+     * \brief Download the album art of an item.
+     *
+     * \param[in] item The item node.
+     * \param[in] mediaItem The media item of the node.
+     * \param[in] wait Download in the calling thread instead of queueing
+     *            the download.
+     * \return The stored thumbnail file, empty string if the item has no
+     *         album art, the download failed or has only been queued.
+     */
+    std::string fetchArt(IXML_Node *item, const MediaItem &mediaItem,
+        bool wait) const;
+
     /**
      * \brief Try to generate hash from item tag.
      *
@@ -292,11 +467,39 @@ private:
     UpnpClient_Handle upnpHandle_;
 
     /// List of upnp devices know to not be ContentDir providers.
-    std::list<std::string> blacklist_;
+    std::unordered_set<std::string> blacklist_;
 
     /// Lock for the blacklist.
     mutable std::mutex blacklistLock_;
 
     /// Lock for concurrent server access.
     mutable std::mutex browseLock_;
+
+    /// Keep-alive SOAP connections by control url, browseLock_ held.
+    mutable std::map<std::string, std::unique_ptr<SoapClient>> soapClients_;
+
+    /// Background album art downloads.
+    std::unique_ptr<ArtFetcher> artFetcher_;
+
+    /// Bounded pool for device description downloads, one per device.
+    std::unique_ptr<SingleFlightPool> discovery_;
+
+    /// Known device descriptions by device uri.
+    mutable std::map<std::string, DeviceDescription> descriptions_;
+
+    /// Lock for descriptions_.
+    mutable std::mutex descriptionLock_;
+
+    /// Devices expire when their advertisement runs out.
+    std::thread expiryTask_;
+    /// Advertisement deadline by device uri.
+    std::map<std::string, std::chrono::steady_clock::time_point> deadlines_;
+    /// Lock for deadlines_ and expiryExit_.
+    std::mutex expiryLock_;
+    std::condition_variable expiryCv_;
+    /// Set on destruction.
+    bool expiryExit_ = false;
+
+    /// Signal handler id of the network monitor.
+    gulong networkHandler_ = 0;
 };
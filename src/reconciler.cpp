@@ -0,0 +1,297 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "reconciler.h"
+#include "device.h"
+#include "mediaitem.h"
+#include "mediaparser.h"
+#include "dbconnector/mediadb.h"
+#include "cache/cachemanager.h"
+#include "cache/thumbnailcollector.h"
+#include "cache/thumbnailquota.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <list>
+#include <cerrno>
+#include <unordered_set>
+#include <sys/stat.h>
+
+std::unique_ptr<Reconciler> Reconciler::instance_;
+
+Reconciler *Reconciler::instance()
+{
+    static std::once_flag once;
+    std::call_once(once, [] { instance_.reset(new Reconciler()); });
+    return instance_.get();
+}
+
+Reconciler::Reconciler()
+{
+    LOG_DEBUG("Reconciler ctor!");
+    task_ = std::thread(&Reconciler::loop, this);
+}
+
+Reconciler::~Reconciler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exit_ = true;
+    }
+    cv_.notify_all();
+    if (task_.joinable())
+        task_.join();
+    LOG_DEBUG("Reconciler dtor!");
+}
+
+void Reconciler::schedule(const std::string &uri)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = std::find_if(jobs_.begin(), jobs_.end(),
+            [&uri] (const Job &job) { return job.uri == uri; });
+        if (iter != jobs_.end())
+            jobs_.erase(iter);
+        jobs_.push_back({uri, std::chrono::steady_clock::now() +
+            std::chrono::seconds(RECONCILE_DELAY)});
+    }
+    cv_.notify_all();
+}
+
+void Reconciler::onDbResponse(void *ctx, bool ok, const pbnjson::JValue &results,
+                              const std::string &next)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // late response of a search we already gave up on
+        if (reinterpret_cast<uintptr_t>(ctx) != request_)
+            return;
+        responded_ = true;
+        responseOk_ = ok;
+        responseResults_ = results;
+        responseNext_ = next;
+    }
+    cv_.notify_all();
+}
+
+void Reconciler::loop()
+{
+    while (true) {
+        std::string uri;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return exit_ || !jobs_.empty(); });
+            if (exit_)
+                break;
+            // jobs are queued with the same delay, the first is due first
+            auto due = jobs_.front().due;
+            if (cv_.wait_until(lock, due, [this] { return exit_; }))
+                break;
+            if (jobs_.empty() || jobs_.front().due > std::chrono::steady_clock::now())
+                continue;
+            uri = jobs_.front().uri;
+            jobs_.pop_front();
+        }
+        reconcile(uri);
+    }
+}
+
+bool Reconciler::deviceIdle(const std::string &uri) const
+{
+    auto device = Device::device(uri);
+    return device && device->available() && device->state() == Device::State::Idle &&
+        !device->mountpoint().empty();
+}
+
+bool Reconciler::deviceMounted(const std::string &uri) const
+{
+    auto device = Device::device(uri);
+    if (!device)
+        return false;
+    auto mountpoint = std::filesystem::path(device->mountpoint());
+    if (mountpoint.empty())
+        return false;
+    if (mountpoint == mountpoint.root_path())
+        return true;
+
+    struct stat st, parent;
+    if (stat(mountpoint.c_str(), &st) < 0 ||
+        stat(mountpoint.parent_path().c_str(), &parent) < 0)
+        return false;
+    return st.st_dev != parent.st_dev;
+}
+
+bool Reconciler::fetch(int type, const std::string &uri, std::string &page,
+                       pbnjson::JValue &results)
+{
+    uintptr_t request;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        request = ++request_;
+        responded_ = false;
+    }
+
+    auto mdb = MediaDb::instance();
+    if (!mdb->searchDeviceItems(static_cast<MediaItem::Type>(type), uri, page,
+            reinterpret_cast<void *>(request)))
+        return false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cv_.wait_for(lock, std::chrono::seconds(RECONCILE_DB_TIMEOUT),
+            [this] { return exit_ || responded_; }) || exit_ || !responseOk_) {
+        // ignore the response if it still arrives
+        ++request_;
+        return false;
+    }
+
+    results = responseResults_;
+    page = responseNext_;
+    return true;
+}
+
+void Reconciler::reconcile(const std::string &uri)
+{
+    if (!deviceIdle(uri) || !deviceMounted(uri)) {
+        LOG_DEBUG("Device '%s' not idle, skip reconciliation", uri.c_str());
+        return;
+    }
+
+    auto device = Device::device(uri);
+    std::string uuid = device->uuid();
+    auto cacheMgr = CacheManager::instance();
+    auto cache = cacheMgr->peekCache(uuid);
+    if (!cache) {
+        LOG_DEBUG("No cache file for '%s', skip reconciliation", uri.c_str());
+        return;
+    }
+    const auto &cached = cache->getRemainingCache();
+
+    auto mdb = MediaDb::instance();
+    auto quota = ThumbnailQuota::instance();
+    auto filePathKey = MediaItem::metaToString(MediaItem::CommonType::FILEPATH);
+    auto thumbnailKey = MediaItem::metaToString(MediaItem::Meta::Thumbnail);
+    auto dirtyKey = MediaItem::metaToString(MediaItem::CommonType::DIRTY);
+
+    Report report;
+    std::unordered_set<std::string> rowPaths;
+    std::unordered_set<std::string> liveIds;
+
+    LOG_INFO(0, "Reconciliation of '%s' started", uri.c_str());
+    for (auto type = MediaItem::Type::Audio; type < MediaItem::Type::EOL; ++type) {
+        std::string page;
+        do {
+            pbnjson::JValue results;
+            if (!fetch(static_cast<int>(type), uri, page, results) || !deviceIdle(uri)) {
+                LOG_WARNING(0, "Reconciliation of '%s' abandoned", uri.c_str());
+                return;
+            }
+
+            std::list<std::string> gone;
+            std::list<std::string> gonePaths;
+            std::list<std::string> goneThumbnails;
+            int present = 0;
+            for (ssize_t i = 0; results.isArray() && i < results.arraySize(); ++i) {
+                auto row = results[i];
+                report.rowsChecked++;
+                auto rowUri = row[MediaItem::metaToString(MediaItem::CommonType::URI)].asString();
+                auto path = row[filePathKey].asString();
+                auto thumbnail = row.hasKey(thumbnailKey) ? row[thumbnailKey].asString() : "";
+
+                // the device cleanup takes care of dirty rows
+                if (row.hasKey(dirtyKey) && row[dirtyKey].asBool()) {
+                    rowPaths.insert(path);
+                    continue;
+                }
+
+                struct stat st;
+                if (!path.empty() && stat(path.c_str(), &st) < 0 && errno == ENOENT) {
+                    gone.push_back(rowUri);
+                    gonePaths.push_back(path);
+                    if (!thumbnail.empty())
+                        goneThumbnails.push_back(thumbnail);
+                    continue;
+                }
+
+                present++;
+                rowPaths.insert(path);
+                if (thumbnail.empty())
+                    continue;
+
+                auto name = std::filesystem::path(thumbnail).filename().string();
+                liveIds.insert(name.substr(0, name.find('.')));
+                // evicted thumbnails are generated again on access
+                std::error_code err;
+                if (!std::filesystem::exists(thumbnail, err) && !err &&
+                    !quota->evicted(thumbnail)) {
+                    MediaParser::regenerateThumbnail(rowUri);
+                    report.thumbnailsRegenerated++;
+                }
+            }
+
+            if (!gone.empty()) {
+                // a vanished mount looks like all files have been
+                // removed, better keep the rows than lose the device
+                if (!deviceIdle(uri) || !deviceMounted(uri)) {
+                    LOG_WARNING(0, "Reconciliation of '%s' abandoned, %zu files missing",
+                        uri.c_str(), gone.size());
+                    return;
+                }
+                if (!present) {
+                    // a whole batch of missing files is suspicious, keep
+                    // its rows and cache entries until the next pass
+                    LOG_WARNING(0, "Reconciliation of '%s' skips a batch, %zu files missing",
+                        uri.c_str(), gone.size());
+                    rowPaths.insert(gonePaths.begin(), gonePaths.end());
+                    for (const auto &thumbnail : goneThumbnails) {
+                        auto name = std::filesystem::path(thumbnail).filename().string();
+                        liveIds.insert(name.substr(0, name.find('.')));
+                    }
+                } else if (mdb->deleteItems(type, gone)) {
+                    report.rowsRemoved += gone.size();
+                    for (const auto &thumbnail : goneThumbnails) {
+                        std::error_code err;
+                        std::filesystem::remove(thumbnail, err);
+                        quota->remove(thumbnail);
+                    }
+                }
+            }
+
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds(RECONCILE_BATCH_INTERVAL));
+        } while (!page.empty());
+    }
+
+    // cached items without a row would be skipped by every later scan
+    std::unordered_set<std::string> stale;
+    for (const auto &[path, item] : cached) {
+        if (rowPaths.find(path) == rowPaths.end())
+            stale.insert(path);
+        else {
+            const auto &thumb = std::get<2>(item);
+            liveIds.insert(thumb.substr(0, thumb.find('.')));
+        }
+    }
+    if (!stale.empty() && deviceIdle(uri))
+        report.cacheEntriesRemoved = cacheMgr->pruneCache(uuid, stale);
+
+    if (deviceIdle(uri))
+        ThumbnailCollector::instance()->collect(uuid, std::move(liveIds));
+
+    LOG_INFO(0, "Reconciliation of '%s' done, %d rows checked, %d rows removed, "
+        "%d thumbnails regenerated, %d cache entries removed", uri.c_str(),
+        report.rowsChecked, report.rowsRemoved, report.thumbnailsRegenerated,
+        report.cacheEntriesRemoved);
+}
@@ -0,0 +1,158 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+#include <pbnjson.hpp>
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+
+/// Delay between the device cleanup and the reconciliation in seconds.
+#define RECONCILE_DELAY 60
+/// Number of db rows requested per batch.
+#define RECONCILE_BATCH_SIZE 100
+/// Pause between two batches in milliseconds.
+#define RECONCILE_BATCH_INTERVAL 200
+/// Time to wait for a db response in seconds.
+#define RECONCILE_DB_TIMEOUT 10
+
+/**
+ * \brief Background consistency check of cache, db and thumbnails.
+ *
+ * Some time after a device has been cleaned up the db rows of the
+ * device are compared with the cache file and the files on the device
+ * in throttled batches:
+ *
+ * - Rows of files that are gone are deleted together with their
+ *   thumbnail.
+ * - Missing thumbnails of existing rows are generated again.
+ * - Cache entries without a db row are removed from the cache file,
+ *   the next scan extracts them again instead of skipping them.
+ * - Thumbnail files referenced neither from the cache nor from the db
+ *   are collected.
+ *
+ * Dirty flagged rows are left to the device cleanup. The check is
+ * abandoned as soon as the device starts scanning again, is no longer
+ * mounted or all files of a batch are missing.
+ */
+class Reconciler
+{
+public:
+    /**
+     * \brief Get singleton object of Reconciler.
+     *
+     * \return The singleton.
+     */
+    static Reconciler *instance();
+
+    virtual ~Reconciler();
+
+    /**
+     * \brief Queue the reconciliation of a device.
+     *
+     * A pending request for the same device is postponed.
+     *
+     * \param[in] uri The device uri.
+     */
+    void schedule(const std::string &uri);
+
+    /**
+     * \brief Hand over a db search response.
+     *
+     * \param[in] ctx Context given to the search request.
+     * \param[in] ok If the search has been successful.
+     * \param[in] results The found rows.
+     * \param[in] next Page key of further rows, empty if none.
+     */
+    void onDbResponse(void *ctx, bool ok, const pbnjson::JValue &results,
+                      const std::string &next);
+
+private:
+    /// Get message id.
+    LOG_MSGID;
+
+    /// Singleton.
+    Reconciler();
+
+    /// One reconciliation request.
+    struct Job {
+        std::string uri;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    /// What a reconciliation changed.
+    struct Report {
+        int rowsChecked = 0;
+        int rowsRemoved = 0;
+        int thumbnailsRegenerated = 0;
+        int cacheEntriesRemoved = 0;
+    };
+
+    /// Reconciler thread main loop.
+    void loop();
+
+    /// Reconcile one device.
+    void reconcile(const std::string &uri);
+
+    /// Check if the device can be reconciled.
+    bool deviceIdle(const std::string &uri) const;
+
+    /// Check if the mountpoint of the device still is a mounted
+    /// filesystem and not an empty directory of the parent one.
+    bool deviceMounted(const std::string &uri) const;
+
+    /**
+     * \brief Search one batch of db rows and wait for the response.
+     *
+     * \param[in] type Media type of the rows.
+     * \param[in] uri The device uri.
+     * \param[in,out] page Page key of the batch, the key of the next
+     *                batch on return.
+     * \param[out] results The found rows.
+     * \return True if the response arrived.
+     */
+    bool fetch(int type, const std::string &uri, std::string &page,
+               pbnjson::JValue &results);
+
+    /// Singleton instance object.
+    static std::unique_ptr<Reconciler> instance_;
+
+    /// Reconciler thread.
+    std::thread task_;
+    /// Protects all members below.
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    /// Pending jobs, ordered by due time.
+    std::deque<Job> jobs_;
+    /// Set on destruction.
+    bool exit_ = false;
+
+    /// Sequence number of the outstanding db search.
+    uintptr_t request_ = 0;
+    /// Response of the outstanding db search.
+    bool responded_ = false;
+    bool responseOk_ = false;
+    pbnjson::JValue responseResults_;
+    std::string responseNext_;
+};
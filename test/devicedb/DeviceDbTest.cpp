@@ -0,0 +1,272 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "devicedb.h"
+#include "device.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Number of refresh events sent through the device database.
+#define REFRESH_EVENTS 1000
+/// Number of devices the refresh events are spread over.
+#define REFRESH_DEVICES 4
+
+/// Device database on top of the recording db connector stub.
+class TestDeviceDb : public DeviceDb
+{
+public:
+    using DeviceDb::deviceModified;
+    using DeviceDb::flush;
+
+    /// Answer a recorded request like the db service.
+    void respond(const DbConnector::Request &request, bool ok)
+    {
+        LSMessage msg = { request.token,
+            ok ? "{\"returnValue\":true}" : "{\"returnValue\":false}" };
+        handleLunaResponse(&msg);
+    }
+};
+
+class DeviceDbTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        DbConnector::setReady(true);
+        Device::devices_.clear();
+        db_ = std::make_unique<TestDeviceDb>();
+    }
+
+    void TearDown() override
+    {
+        db_.reset();
+        Device::devices_.clear();
+    }
+
+    /// Create a device that is known to Device::device().
+    std::shared_ptr<Device> addDevice(const std::string &uri)
+    {
+        auto device = std::make_shared<Device>(uri, 10, true, uri + "-uuid");
+        device->setMeta(Device::Meta::Name, uri + "-name");
+        device->setMeta(Device::Meta::Description, uri + "-description");
+        Device::devices_[uri] = device;
+        return device;
+    }
+
+    /// Write a device and confirm the write.
+    void writeConfirmed(std::shared_ptr<Device> device)
+    {
+        db_->deviceModified(device);
+        ASSERT_FALSE(db_->mergePuts_.empty());
+        db_->respond(db_->mergePuts_.back(), true);
+    }
+
+    /// Advance the last seen time of a device.
+    static void refresh(std::shared_ptr<Device> device, int seconds)
+    {
+        device->setLastSeen(device->lastSeen() + std::chrono::seconds(seconds));
+    }
+
+    /// Check if a write carries all device properties.
+    static bool isComplete(const pbnjson::JValue &props)
+    {
+        return props.hasKey("uuid") && props.hasKey("name") &&
+            props.hasKey("description") && props.hasKey("available") &&
+            props.hasKey("uri") && props.hasKey("alive") && props.hasKey("lastSeen");
+    }
+
+    std::unique_ptr<TestDeviceDb> db_;
+};
+
+TEST_F(DeviceDbTest, FirstWriteIsComplete)
+{
+    auto device = addDevice("msc://a");
+    db_->deviceModified(device);
+
+    ASSERT_EQ(db_->mergePuts_.size(), 1u);
+    EXPECT_TRUE(isComplete(db_->mergePuts_[0].params));
+    EXPECT_EQ(db_->mergePuts_[0].params["name"].asString(), "msc://a-name");
+}
+
+TEST_F(DeviceDbTest, WritesStayCompleteUntilConfirmed)
+{
+    auto device = addDevice("msc://a");
+    db_->deviceModified(device);
+    device->setMeta(Device::Meta::Name, "renamed");
+    db_->deviceModified(device);
+
+    ASSERT_EQ(db_->mergePuts_.size(), 2u);
+    EXPECT_TRUE(isComplete(db_->mergePuts_[1].params));
+
+    // the first write is confirmed, only the name differs from it
+    db_->respond(db_->mergePuts_[0], true);
+    device->setMeta(Device::Meta::Name, "renamed again");
+    db_->deviceModified(device);
+
+    ASSERT_EQ(db_->mergePuts_.size(), 3u);
+    auto props = db_->mergePuts_[2].params;
+    EXPECT_FALSE(isComplete(props));
+    EXPECT_EQ(props["name"].asString(), "renamed again");
+    EXPECT_FALSE(props.hasKey("uuid"));
+    EXPECT_FALSE(props.hasKey("description"));
+    EXPECT_TRUE(props.hasKey("lastSeen"));
+}
+
+TEST_F(DeviceDbTest, UnchangedDeviceIsNotWritten)
+{
+    auto device = addDevice("msc://a");
+    writeConfirmed(device);
+
+    db_->deviceModified(device);
+    db_->flush();
+
+    EXPECT_EQ(db_->mergePuts_.size(), 1u);
+    EXPECT_TRUE(db_->batches_.empty());
+}
+
+TEST_F(DeviceDbTest, NotReadyWritesCompleteRows)
+{
+    auto device = addDevice("msc://a");
+    writeConfirmed(device);
+
+    // queued writes might be replayed in any order
+    DbConnector::setReady(false);
+    device->setMeta(Device::Meta::Name, "renamed");
+    db_->deviceModified(device);
+
+    ASSERT_EQ(db_->mergePuts_.size(), 2u);
+    EXPECT_TRUE(isComplete(db_->mergePuts_[1].params));
+}
+
+TEST_F(DeviceDbTest, FailedWriteIsRetriedComplete)
+{
+    auto device = addDevice("msc://a");
+    writeConfirmed(device);
+    device->setMeta(Device::Meta::Name, "renamed");
+    db_->deviceModified(device);
+    ASSERT_EQ(db_->mergePuts_.size(), 2u);
+    EXPECT_FALSE(isComplete(db_->mergePuts_[1].params));
+
+    db_->respond(db_->mergePuts_[1], false);
+    db_->flush();
+
+    ASSERT_EQ(db_->mergePuts_.size(), 3u);
+    EXPECT_TRUE(isComplete(db_->mergePuts_[2].params));
+    EXPECT_EQ(db_->mergePuts_[2].params["name"].asString(), "renamed");
+
+    // the retry succeeded, nothing left to write
+    db_->respond(db_->mergePuts_[2], true);
+    db_->flush();
+    EXPECT_EQ(db_->mergePuts_.size(), 3u);
+    EXPECT_TRUE(db_->batches_.empty());
+}
+
+TEST_F(DeviceDbTest, RefreshesAreBatched)
+{
+    std::vector<std::shared_ptr<Device>> devices;
+    for (int i = 0; i < REFRESH_DEVICES; ++i) {
+        devices.push_back(addDevice("msc://" + std::to_string(i)));
+        writeConfirmed(devices.back());
+    }
+    ASSERT_EQ(db_->mergePuts_.size(), size_t(REFRESH_DEVICES));
+
+    for (int i = 0; i < REFRESH_EVENTS; ++i) {
+        auto device = devices[i % REFRESH_DEVICES];
+        refresh(device, 1);
+        device->setAlive(i);
+        db_->deviceModified(device);
+    }
+
+    // no immediate write for alive and lastSeen changes
+    EXPECT_EQ(db_->mergePuts_.size(), size_t(REFRESH_DEVICES));
+    EXPECT_TRUE(db_->batches_.empty());
+
+    db_->flush();
+    ASSERT_EQ(db_->batches_.size(), 1u);
+    auto operations = db_->batches_[0].params;
+    ASSERT_EQ(operations.arraySize(), REFRESH_DEVICES);
+    for (ssize_t i = 0; i < operations.arraySize(); ++i) {
+        auto params = operations[i]["params"];
+        auto uri = params["query"]["where"][0]["val"].asString();
+        auto device = Device::device(uri);
+        ASSERT_TRUE(device);
+        EXPECT_EQ(params["props"]["alive"].asNumber<int>(), device->alive());
+        EXPECT_EQ(params["props"]["lastSeen"].asNumber<int64_t>(),
+            int64_t(device->lastSeen().time_since_epoch().count()));
+        EXPECT_FALSE(params["props"].hasKey("name"));
+    }
+
+    // nothing pending after the flush
+    db_->flush();
+    EXPECT_EQ(db_->batches_.size(), 1u);
+    EXPECT_EQ(db_->mergePuts_.size(), size_t(REFRESH_DEVICES));
+}
+
+TEST_F(DeviceDbTest, ConfirmedRefreshIsPersisted)
+{
+    auto device = addDevice("msc://a");
+    writeConfirmed(device);
+    refresh(device, 1);
+    db_->deviceModified(device);
+    db_->flush();
+    ASSERT_EQ(db_->batches_.size(), 1u);
+    db_->respond(db_->batches_[0], true);
+
+    // the db has the refresh, the same values are not written again
+    db_->deviceModified(device);
+    db_->flush();
+    EXPECT_EQ(db_->batches_.size(), 1u);
+    EXPECT_EQ(db_->mergePuts_.size(), 1u);
+}
+
+TEST_F(DeviceDbTest, UnconfirmedRefreshIsNotPersisted)
+{
+    auto device = addDevice("msc://a");
+    writeConfirmed(device);
+    refresh(device, 1);
+    db_->deviceModified(device);
+    db_->flush();
+    ASSERT_EQ(db_->batches_.size(), 1u);
+
+    // still differs from the confirmed snapshot
+    db_->deviceModified(device);
+    db_->flush();
+    EXPECT_EQ(db_->batches_.size(), 2u);
+    EXPECT_EQ(db_->mergePuts_.size(), 1u);
+}
+
+TEST_F(DeviceDbTest, FailedRefreshIsRetriedComplete)
+{
+    auto device = addDevice("msc://a");
+    writeConfirmed(device);
+    refresh(device, 1);
+    db_->deviceModified(device);
+    db_->flush();
+    ASSERT_EQ(db_->batches_.size(), 1u);
+
+    db_->respond(db_->batches_[0], false);
+    db_->flush();
+
+    EXPECT_EQ(db_->batches_.size(), 1u);
+    ASSERT_EQ(db_->mergePuts_.size(), 2u);
+    EXPECT_TRUE(isComplete(db_->mergePuts_[1].params));
+}
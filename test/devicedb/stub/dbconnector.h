@@ -0,0 +1,144 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "logging.h"
+#include <pbnjson.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+/// Luna message carrying a db service response.
+struct LSMessage {
+    unsigned long token;
+    std::string payload;
+};
+
+typedef unsigned long LSMessageToken;
+
+inline LSMessageToken LSMessageGetResponseToken(LSMessage *msg)
+{
+    return msg->token;
+}
+
+inline const char *LSMessageGetPayload(LSMessage *msg)
+{
+    return msg->payload.c_str();
+}
+
+enum SessionHdlType {
+    HDL_DEFAULT = 0,
+    HDL_LUNA_CONN,
+    HDL_MAX
+};
+
+/**
+ * \brief Db connector stub for the device database tests.
+ *
+ * Records the write requests instead of sending them, the test
+ * answers them through handleLunaResponse().
+ */
+class DbConnector
+{
+public:
+    /// A recorded write request.
+    struct Request {
+        LSMessageToken token;
+        std::string method;
+        pbnjson::JValue params;
+        void *object;
+    };
+
+    static bool isReady() { return ready_; }
+
+    /// Set the db service ready state.
+    static void setReady(bool ready) { ready_ = ready; }
+
+    /// Recorded mergePut requests.
+    std::vector<Request> mergePuts_;
+    /// Recorded batch requests.
+    std::vector<Request> batches_;
+
+protected:
+    /// Session data attached to each luna request
+    struct SessionData {
+        /// A method name to identify the action.
+        std::string dbServiceMethod;
+        /// Some arbitrary object.
+        void *object;
+    };
+
+    DbConnector(const char *serviceName, bool async = false) :
+        kindId_(std::string(serviceName) + ":1")
+    {
+    }
+
+    virtual ~DbConnector() {}
+
+    virtual bool handleLunaResponse(LSMessage *msg) = 0;
+
+    virtual bool handleLunaResponseMetaData(LSMessage *msg) = 0;
+
+    virtual bool mergePut(const std::string &uri, bool precise,
+        pbnjson::JValue &props, void *obj = nullptr, const std::string &kind_name = "",
+        bool atomic = false)
+    {
+        mergePuts_.push_back({++token_, "mergePut", props, obj});
+        sessions_[token_] = {"mergePut", obj};
+        return true;
+    }
+
+    virtual bool find(const std::string &uri, bool precise = true,
+        void *obj = nullptr, const std::string &kind_name = "", bool atomic = false)
+    {
+        return true;
+    }
+
+    virtual bool batch(pbnjson::JValue &operations, const std::string &dbMethod,
+        void *obj = nullptr, bool atomic = false)
+    {
+        batches_.push_back({++token_, dbMethod, operations, obj});
+        sessions_[token_] = {dbMethod, obj};
+        return true;
+    }
+
+    virtual void ensureKind(const std::string &kind_name = "") {}
+
+    virtual void completeWrite(const std::string &method, void *obj) {}
+
+    bool sessionDataFromToken(LSMessageToken token, SessionData *sd,
+        SessionHdlType hdlType = HDL_DEFAULT)
+    {
+        auto iter = sessions_.find(token);
+        if (iter == sessions_.end())
+            return false;
+        *sd = iter->second;
+        sessions_.erase(iter);
+        return true;
+    }
+
+    std::string kindId_;
+    pbnjson::JArray kindIndexes_;
+
+private:
+    static inline bool ready_ = true;
+    LSMessageToken token_ = 0;
+    std::map<LSMessageToken, SessionData> sessions_;
+};
@@ -0,0 +1,87 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+/// Device stub for the device database tests.
+class Device
+{
+public:
+    enum class Meta {
+        Name,
+        Description,
+        EOL
+    };
+
+    /// Devices found by Device::device().
+    static inline std::map<std::string, std::shared_ptr<Device>> devices_;
+
+    static std::shared_ptr<Device> device(const std::string &uri)
+    {
+        auto iter = devices_.find(uri);
+        return iter == devices_.end() ? nullptr : iter->second;
+    }
+
+    Device(const std::string &uri, int alive = -1, bool avail = true,
+        std::string uuid = "") :
+        uri_(uri), uuid_(uuid), available_(avail), alive_(alive)
+    {
+    }
+
+    const std::string &uri() const { return uri_; }
+    const std::string &uuid() const { return uuid_; }
+    int alive() const { return alive_; }
+    bool available(bool check = false) { return available_; }
+
+    const std::string &meta(Meta type) const
+    {
+        return type == Meta::Name ? name_ : description_;
+    }
+
+    bool setMeta(Meta type, const std::string value)
+    {
+        (type == Meta::Name ? name_ : description_) = value;
+        return true;
+    }
+
+    const std::chrono::system_clock::time_point &lastSeen() const
+    {
+        return lastSeen_;
+    }
+
+    /// Test controls.
+    void setAlive(int alive) { alive_ = alive; }
+    void setAvailable(bool available) { available_ = available; }
+    void setLastSeen(std::chrono::system_clock::time_point lastSeen)
+    {
+        lastSeen_ = lastSeen;
+    }
+
+private:
+    std::string uri_;
+    std::string uuid_;
+    std::string name_;
+    std::string description_;
+    bool available_;
+    int alive_;
+    std::chrono::system_clock::time_point lastSeen_;
+};
@@ -0,0 +1,39 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#pragma once
+
+#include "device.h"
+
+#include <memory>
+#include <string>
+
+/// Plugin stub for the device database tests.
+class Plugin
+{
+public:
+    bool injectDevice(const std::string &uri, int alive, bool avail = true,
+        std::string uuid = "")
+    {
+        return false;
+    }
+
+    std::shared_ptr<Device> device(const std::string &uri) const
+    {
+        return Device::device(uri);
+    }
+};
@@ -0,0 +1,341 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "httpconnection.h"
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * \brief Scripted HTTP server on the loopback interface.
+ *
+ * Answers every request with the next queued response, connections
+ * are served one after the other.
+ */
+class LoopbackServer
+{
+public:
+    LoopbackServer()
+    {
+        listen_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(listen_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ||
+            listen(listen_, 4) ||
+            getsockname(listen_, reinterpret_cast<sockaddr *>(&addr), &len))
+            ADD_FAILURE() << "Failed to set up the loopback server";
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread(&LoopbackServer::run, this);
+    }
+
+    ~LoopbackServer()
+    {
+        shutdown(listen_, SHUT_RDWR);
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (client_ >= 0)
+                shutdown(client_, SHUT_RDWR);
+        }
+        thread_.join();
+        close(listen_);
+    }
+
+    guint16 port() const
+    {
+        return port_;
+    }
+
+    /// Queue a response, the connection is closed after it if asked.
+    void respond(const std::string &response, bool closeAfter = false)
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        responses_.push_back({response, closeAfter});
+    }
+
+    /// Number of accepted connections.
+    int connections() const
+    {
+        return connections_;
+    }
+
+private:
+    struct Response {
+        std::string data;
+        bool closeAfter;
+    };
+
+    void run()
+    {
+        while (true) {
+            int fd = accept(listen_, nullptr, nullptr);
+            if (fd < 0)
+                return;
+            connections_++;
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                client_ = fd;
+            }
+            serve(fd);
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                client_ = -1;
+            }
+            close(fd);
+        }
+    }
+
+    void serve(int fd)
+    {
+        std::string pending;
+        char buf[1024];
+        while (true) {
+            // the test requests have no body
+            auto end = pending.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                auto n = recv(fd, buf, sizeof(buf), 0);
+                if (n <= 0)
+                    return;
+                pending.append(buf, n);
+                continue;
+            }
+            pending.erase(0, end + 4);
+
+            Response response;
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                if (responses_.empty())
+                    return;
+                response = responses_.front();
+                responses_.pop_front();
+            }
+            if (send(fd, response.data.data(), response.data.size(), MSG_NOSIGNAL) < 0 ||
+                response.closeAfter)
+                return;
+        }
+    }
+
+    int listen_ = -1;
+    int client_ = -1;
+    guint16 port_ = 0;
+    std::atomic<int> connections_{0};
+    std::deque<Response> responses_;
+    std::mutex lock_;
+    std::thread thread_;
+};
+
+static std::string request(const std::string &method = "GET")
+{
+    return method + " /art.jpg HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+}
+
+TEST(HttpConnectionTest, ParseUrl)
+{
+    std::string host, path;
+    guint16 port = 0;
+    ASSERT_TRUE(HttpConnection::parseUrl("http://[fe80::1]:8200/a/b?c=d", host, port, path));
+    EXPECT_EQ(host, "fe80::1");
+    EXPECT_EQ(port, 8200);
+    EXPECT_EQ(path, "/a/b?c=d");
+    ASSERT_TRUE(HttpConnection::parseUrl("http://server", host, port, path));
+    EXPECT_EQ(port, 80);
+    EXPECT_EQ(path, "/");
+    EXPECT_FALSE(HttpConnection::parseUrl("https://server/", host, port, path));
+}
+
+TEST(HttpConnectionTest, ContentLengthKeepsConnection)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nfirst");
+    server.respond("HTTP/1.1 200 OK\r\ncontent-length: 6\r\nETag: \"x\"\r\n\r\nsecond");
+
+    HttpConnection conn("127.0.0.1", server.port());
+    // both requests are written before the responses are read
+    ASSERT_TRUE(conn.send(request() + request()));
+    HttpConnection::Response resp;
+    ASSERT_TRUE(conn.receive(resp));
+    EXPECT_EQ(resp.status, 200);
+    EXPECT_EQ(resp.body, "first");
+    EXPECT_TRUE(resp.keepAlive);
+    ASSERT_TRUE(conn.receive(resp));
+    EXPECT_EQ(resp.body, "second");
+    EXPECT_EQ(resp.headers["etag"], "\"x\"");
+    EXPECT_TRUE(conn.connected());
+    EXPECT_EQ(server.connections(), 1);
+}
+
+TEST(HttpConnectionTest, ChunkedBody)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "4\r\nWiki\r\n5;name=value\r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n"
+        "0\r\nX-Trailer: ignored\r\n\r\n");
+    server.respond("HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nnext");
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request() + request()));
+    HttpConnection::Response resp;
+    ASSERT_TRUE(conn.receive(resp));
+    EXPECT_EQ(resp.body, "Wikipedia in\r\n\r\nchunks.");
+    EXPECT_TRUE(conn.connected());
+
+    // the trailer has been consumed completely
+    ASSERT_TRUE(conn.receive(resp));
+    EXPECT_EQ(resp.body, "next");
+}
+
+TEST(HttpConnectionTest, ConnectionClose)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 4\r\n\r\ndone",
+        true);
+    server.respond("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nagain");
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request()));
+    HttpConnection::Response resp;
+    ASSERT_TRUE(conn.receive(resp));
+    EXPECT_EQ(resp.body, "done");
+    EXPECT_FALSE(resp.keepAlive);
+    EXPECT_FALSE(conn.connected());
+
+    // the next request opens a new connection
+    ASSERT_TRUE(conn.send(request()));
+    ASSERT_TRUE(conn.receive(resp));
+    EXPECT_EQ(resp.body, "again");
+    EXPECT_EQ(server.connections(), 2);
+}
+
+TEST(HttpConnectionTest, BodyUntilClose)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.0 200 OK\r\n\r\nuntil the end", true);
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request()));
+    HttpConnection::Response resp;
+    ASSERT_TRUE(conn.receive(resp));
+    EXPECT_EQ(resp.body, "until the end");
+    EXPECT_FALSE(resp.keepAlive);
+    EXPECT_FALSE(conn.connected());
+}
+
+TEST(HttpConnectionTest, NoBody)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.1 200 OK\r\nContent-Length: 1000\r\n\r\n");
+    server.respond("HTTP/1.1 304 Not Modified\r\nContent-Length: 1000\r\n\r\n");
+    server.respond("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request("HEAD") + request() + request()));
+    HttpConnection::Response resp;
+    ASSERT_TRUE(conn.receive(resp, true));
+    EXPECT_TRUE(resp.body.empty());
+    ASSERT_TRUE(conn.receive(resp));
+    EXPECT_EQ(resp.status, 304);
+    EXPECT_TRUE(resp.body.empty());
+    ASSERT_TRUE(conn.receive(resp));
+    EXPECT_EQ(resp.body, "ok");
+}
+
+TEST(HttpConnectionTest, OversizeContentLength)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.1 200 OK\r\nContent-Length: 1000000000000\r\n\r\n0123456789");
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request()));
+    HttpConnection::Response resp;
+    EXPECT_FALSE(conn.receive(resp, false, 16));
+    EXPECT_TRUE(resp.body.empty());
+    EXPECT_FALSE(conn.connected());
+}
+
+TEST(HttpConnectionTest, OversizeChunked)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "8\r\n01234567\r\n8\r\n89abcdef\r\n8\r\nghijklmn\r\n0\r\n\r\n");
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request()));
+    HttpConnection::Response resp;
+    EXPECT_FALSE(conn.receive(resp, false, 16));
+    EXPECT_LE(resp.body.size(), 16u);
+    EXPECT_FALSE(conn.connected());
+}
+
+TEST(HttpConnectionTest, OversizeChunkSize)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "ffffffffffffffff\r\n0123\r\n");
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request()));
+    HttpConnection::Response resp;
+    EXPECT_FALSE(conn.receive(resp));
+    EXPECT_FALSE(conn.connected());
+}
+
+TEST(HttpConnectionTest, OversizeBodyUntilClose)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.0 200 OK\r\n\r\n" + std::string(100, 'x'), true);
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request()));
+    HttpConnection::Response resp;
+    EXPECT_FALSE(conn.receive(resp, false, 16));
+    EXPECT_FALSE(conn.connected());
+}
+
+TEST(HttpConnectionTest, TruncatedResponse)
+{
+    LoopbackServer server;
+    server.respond("HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\nshort", true);
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request()));
+    HttpConnection::Response resp;
+    EXPECT_FALSE(conn.receive(resp));
+    EXPECT_FALSE(conn.connected());
+}
+
+TEST(HttpConnectionTest, NoHttpResponse)
+{
+    LoopbackServer server;
+    server.respond("SSH-2.0-OpenSSH\r\n\r\n");
+
+    HttpConnection conn("127.0.0.1", server.port());
+    ASSERT_TRUE(conn.send(request()));
+    HttpConnection::Response resp;
+    EXPECT_FALSE(conn.receive(resp));
+    EXPECT_FALSE(conn.connected());
+}
@@ -0,0 +1,172 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "singleflightpool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Pushes of one burst, like the announcements of a busy network.
+#define BURST_PUSHES 1000
+/// Devices announcing in the burst.
+#define BURST_KEYS 10
+/// Threads announcing in parallel.
+#define BURST_THREADS 4
+
+/**
+ * \brief Holds jobs until released and counts their runs.
+ */
+class Latch
+{
+public:
+    /// Block until released.
+    void wait(const std::string &key)
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        ++waiting_;
+        cond_.notify_all();
+        cond_.wait(lock, [this] { return open_; });
+        ++runs_[key];
+    }
+
+    /// Wait for the given number of blocked jobs.
+    bool waitFor(int jobs)
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        return cond_.wait_for(lock, std::chrono::seconds(5),
+            [this, jobs] { return waiting_ >= jobs; });
+    }
+
+    /// Release the blocked and all future jobs.
+    void open()
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        open_ = true;
+        cond_.notify_all();
+    }
+
+    /// Runs by key.
+    std::map<std::string, int> runs()
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        return runs_;
+    }
+
+private:
+    std::mutex lock_;
+    std::condition_variable cond_;
+    bool open_ = false;
+    int waiting_ = 0;
+    std::map<std::string, int> runs_;
+};
+
+TEST(SingleFlightPoolTest, BurstRunsOncePerKey)
+{
+    Latch latch;
+    std::atomic<int> accepted(0);
+    {
+        SingleFlightPool pool(BURST_KEYS);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < BURST_THREADS; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = t; i < BURST_PUSHES; i += BURST_THREADS) {
+                    auto key = "device-" + std::to_string(i % BURST_KEYS);
+                    if (pool.push(key, [&latch, key] { latch.wait(key); }))
+                        ++accepted;
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+
+        // all jobs are still blocked, every other push has been dropped
+        EXPECT_TRUE(latch.waitFor(BURST_KEYS));
+        latch.open();
+    }
+
+    EXPECT_EQ(BURST_KEYS, accepted);
+    auto runs = latch.runs();
+    ASSERT_EQ(size_t(BURST_KEYS), runs.size());
+    for (auto &run : runs)
+        EXPECT_EQ(1, run.second) << run.first;
+}
+
+TEST(SingleFlightPoolTest, QueuedKeyIsDropped)
+{
+    Latch latch;
+    {
+        // one thread, the second key waits in the queue
+        SingleFlightPool pool(1);
+        EXPECT_TRUE(pool.push("a", [&latch] { latch.wait("a"); }));
+        EXPECT_TRUE(latch.waitFor(1));
+        EXPECT_TRUE(pool.push("b", [&latch] { latch.wait("b"); }));
+        EXPECT_FALSE(pool.push("a", [&latch] { latch.wait("a"); }));
+        EXPECT_FALSE(pool.push("b", [&latch] { latch.wait("b"); }));
+        latch.open();
+    }
+
+    auto runs = latch.runs();
+    EXPECT_EQ(1, runs["a"]);
+    EXPECT_EQ(1, runs["b"]);
+}
+
+TEST(SingleFlightPoolTest, FinishedKeyRunsAgain)
+{
+    std::mutex lock;
+    std::condition_variable cond;
+    int runs = 0;
+
+    SingleFlightPool pool(2);
+    for (int i = 1; i <= 3; ++i) {
+        // the key is released after the job, wait for that
+        bool pushed = false;
+        for (int tries = 0; !pushed && tries < 1000; ++tries) {
+            pushed = pool.push("device", [&] {
+                std::lock_guard<std::mutex> guard(lock);
+                ++runs;
+                cond.notify_all();
+            });
+            if (!pushed)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_TRUE(pushed);
+        std::unique_lock<std::mutex> guard(lock);
+        ASSERT_TRUE(cond.wait_for(guard, std::chrono::seconds(5),
+            [&] { return runs == i; }));
+    }
+}
+
+TEST(SingleFlightPoolTest, DestructorWaitsForJobs)
+{
+    std::atomic<int> runs(0);
+    {
+        SingleFlightPool pool(1);
+        for (int i = 0; i < BURST_KEYS; ++i) {
+            EXPECT_TRUE(pool.push(std::to_string(i), [&runs] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                ++runs;
+            }));
+        }
+    }
+    EXPECT_EQ(BURST_KEYS, runs);
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "tagreader.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <unistd.h>
+
+/**
+ * \brief Fuzz target of the native tag reader.
+ *
+ * The input is written to a temporary file which is read like a media
+ * file, once as MPEG audio with ID3 tags and once as Ogg Vorbis.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    FILE *fp = tmpfile();
+    if (!fp)
+        return 0;
+    if (size && fwrite(data, 1, size, fp) != size) {
+        fclose(fp);
+        return 0;
+    }
+    fflush(fp);
+
+    {
+        TagReader reader(fileno(fp));
+        TagReader::Tags tags;
+        TagReader::StreamInfo info;
+        if (reader.readId3(tags))
+            reader.readMpeg(info);
+        // the picture points into the reader
+        volatile uint8_t sum = 0;
+        for (size_t i = 0; tags.picture && i < tags.pictureSize; ++i)
+            sum += tags.picture[i];
+    }
+    {
+        TagReader reader(fileno(fp));
+        TagReader::Tags tags;
+        TagReader::StreamInfo info;
+        reader.readVorbis(tags, info);
+    }
+
+    fclose(fp);
+    return 0;
+}
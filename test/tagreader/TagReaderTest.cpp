@@ -0,0 +1,197 @@
+// Copyright (c) 2021 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+#include "tagreader.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+/// Rounds of random mutations of every corpus file.
+#define MUTATION_ROUNDS 2000
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/// Read a file of the seed corpus.
+static std::string corpusFile(const std::string &name)
+{
+    std::ifstream in(std::string(TAGREADER_CORPUS_DIR) + "/" + name, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static const char *corpus[] = {
+    "id3v24-xing.mp3",
+    "id3v23-unsync-cbr.mp3",
+    "id3v22.mp3",
+    "id3v1-vbri.mp3",
+    "vorbis.ogg"
+};
+
+/// A corpus file opened for the reader.
+class TagReaderTest : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        if (fp_)
+            fclose(fp_);
+    }
+
+    int open(const std::string &name)
+    {
+        auto data = corpusFile(name);
+        EXPECT_FALSE(data.empty()) << name;
+        fp_ = tmpfile();
+        fwrite(data.data(), 1, data.size(), fp_);
+        fflush(fp_);
+        return fileno(fp_);
+    }
+
+    FILE *fp_ = nullptr;
+};
+
+TEST_F(TagReaderTest, Id3v24WithXingHeader)
+{
+    TagReader reader(open("id3v24-xing.mp3"));
+    TagReader::Tags tags;
+    ASSERT_TRUE(reader.readId3(tags));
+    EXPECT_EQ(tags.title, "Title \xc3\xa4");
+    EXPECT_EQ(tags.artist, "Artist");
+    EXPECT_EQ(tags.album, "Album");
+    EXPECT_EQ(tags.albumArtist, "Album Artist");
+    EXPECT_EQ(tags.genre, "Rock");
+    EXPECT_EQ(tags.date, "2020-01-02");
+    EXPECT_EQ(tags.year, "2020");
+    EXPECT_EQ(tags.track, "1/2");
+    EXPECT_EQ(tags.pictureMime, "image/jpeg");
+    ASSERT_TRUE(tags.picture);
+    EXPECT_EQ(tags.pictureSize, 45u);
+    EXPECT_EQ(tags.picture[0], 0xff);
+    EXPECT_EQ(tags.picture[1], 0xd8);
+
+    TagReader::StreamInfo info;
+    ASSERT_TRUE(reader.readMpeg(info));
+    EXPECT_EQ(info.sampleRate, 44100);
+    EXPECT_EQ(info.channels, 2);
+    // 100 frames of 1152 samples without the LAME delay and padding
+    EXPECT_EQ(info.duration, 2);
+    EXPECT_GT(info.bitRate, 0);
+}
+
+TEST_F(TagReaderTest, UnsynchronisedId3v23WithConstantBitrate)
+{
+    TagReader reader(open("id3v23-unsync-cbr.mp3"));
+    TagReader::Tags tags;
+    ASSERT_TRUE(reader.readId3(tags));
+    EXPECT_EQ(tags.title, "Unsync \xc3\xbf Title");
+    EXPECT_EQ(tags.artist, "Artist");
+    EXPECT_EQ(tags.date, "1999");
+    EXPECT_EQ(tags.genre, "Rock");
+    // missing fields come from ID3v1
+    EXPECT_EQ(tags.album, "V1 Album");
+    EXPECT_FALSE(tags.picture);
+
+    TagReader::StreamInfo info;
+    ASSERT_TRUE(reader.readMpeg(info));
+    EXPECT_EQ(info.bitRate, 128);
+    EXPECT_EQ(info.sampleRate, 44100);
+}
+
+TEST_F(TagReaderTest, Id3v22)
+{
+    TagReader reader(open("id3v22.mp3"));
+    TagReader::Tags tags;
+    ASSERT_TRUE(reader.readId3(tags));
+    EXPECT_EQ(tags.title, "Old Title");
+    EXPECT_EQ(tags.artist, "Old Artist");
+    EXPECT_EQ(tags.genre, "Smooth");
+    EXPECT_EQ(tags.pictureMime, "jpg");
+    EXPECT_TRUE(tags.picture);
+}
+
+TEST_F(TagReaderTest, Id3v1WithVbriHeader)
+{
+    TagReader reader(open("id3v1-vbri.mp3"));
+    TagReader::Tags tags;
+    ASSERT_TRUE(reader.readId3(tags));
+    EXPECT_EQ(tags.title, "Only V1");
+    EXPECT_EQ(tags.artist, "Someone");
+    EXPECT_EQ(tags.year, "2001");
+    EXPECT_TRUE(tags.genre.empty());
+    EXPECT_EQ(reader.audioOffset(), 0);
+
+    TagReader::StreamInfo info;
+    ASSERT_TRUE(reader.readMpeg(info));
+    EXPECT_EQ(info.duration, 1);
+}
+
+TEST_F(TagReaderTest, VorbisComments)
+{
+    TagReader reader(open("vorbis.ogg"));
+    TagReader::Tags tags;
+    TagReader::StreamInfo info;
+    ASSERT_TRUE(reader.readVorbis(tags, info));
+    EXPECT_EQ(tags.title, "Vorbis Title");
+    EXPECT_EQ(tags.artist, "One Two");
+    EXPECT_EQ(tags.album, "Ogg Album");
+    EXPECT_EQ(tags.genre, "Jazz");
+    EXPECT_EQ(tags.date, "2015");
+    EXPECT_EQ(tags.track, "3");
+    EXPECT_EQ(info.sampleRate, 44100);
+    EXPECT_EQ(info.channels, 2);
+    EXPECT_EQ(info.duration, 10);
+}
+
+TEST_F(TagReaderTest, VorbisIsNoMpeg)
+{
+    TagReader reader(open("id3v24-xing.mp3"));
+    TagReader::Tags tags;
+    TagReader::StreamInfo info;
+    EXPECT_FALSE(reader.readVorbis(tags, info));
+}
+
+// files cut off anywhere, like a medium removed during the scan
+TEST(TagReaderFuzzTest, TruncatedCorpus)
+{
+    for (auto name : corpus) {
+        auto data = corpusFile(name);
+        ASSERT_FALSE(data.empty()) << name;
+        for (size_t size = 0; size <= data.size(); ++size)
+            LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(data.data()), size);
+    }
+}
+
+// replay of the fuzz target with random byte changes of the corpus
+TEST(TagReaderFuzzTest, MutatedCorpus)
+{
+    std::mt19937 random(1);
+    for (auto name : corpus) {
+        auto seed = corpusFile(name);
+        ASSERT_FALSE(seed.empty()) << name;
+        for (int round = 0; round < MUTATION_ROUNDS; ++round) {
+            auto data = seed;
+            int changes = 1 + random() % 8;
+            for (int i = 0; i < changes; ++i)
+                data[random() % data.size()] = static_cast<char>(random());
+            LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+        }
+    }
+}